@@ -0,0 +1,79 @@
+#pragma once
+// Shared helpers for the microbenchmarks in bench/.
+// Include from exactly one translation unit per benchmark binary: it replaces
+// the global operator new/delete to count heap allocations.
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+namespace bench {
+
+inline std::atomic<uint64_t> g_allocs{0};
+
+inline uint64_t allocs() { return g_allocs.load(std::memory_order_relaxed); }
+
+// Resident set size of the process in KiB (Linux /proc/self/statm), 0 if unavailable.
+inline long rss_kb() {
+    long pages = 0, resident = 0;
+    FILE* f = std::fopen("/proc/self/statm", "r");
+    if (!f) return 0;
+    if (std::fscanf(f, "%ld %ld", &pages, &resident) != 2) resident = 0;
+    std::fclose(f);
+    return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+// Prevent the optimizer from discarding a computed value.
+template <typename T>
+inline void keep(T const& v) { asm volatile("" : : "g"(&v) : "memory"); }
+
+inline double now_ns() {
+    using namespace std::chrono;
+    return static_cast<double>(
+        duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count());
+}
+
+/**
+ * One representative celima/data uplink per DeviceType (1..8) plus one
+ * unknown type that goes through the DefaultProcessor.
+ */
+inline const std::vector<std::string>& sample_payloads() {
+    static const std::vector<std::string> p = {
+        R"({"devEUI":"a840410000000001","deviceName":"ph1-l1","deviceType":1,"lineID":1,"alarms":0,"cantidadProductos":1200,"tiempoProduccion_ds":5400,"paradas":3,"tiempoParadas_s":45})",
+        R"({"devEUI":"a840410000000002","deviceName":"ph2-l2","deviceType":2,"lineID":2,"alarms":0,"cantidadProductos":900,"tiempoProduccion_ds":5100,"paradas":1,"tiempoParadas_s":12})",
+        R"({"devEUI":"a840410000000003","deviceName":"es-l1","deviceType":3,"lineID":1,"alarms":1,"arranques":42,"tiempoOperacion_s":3600})",
+        R"({"devEUI":"a840410000000004","deviceName":"ss-l1","deviceType":4,"lineID":1,"alarms":0,"cantidadProductos":800,"tiempoProduccion_ds":4000,"paradas":2,"tiempoParadas_s":20})",
+        R"({"devEUI":"a840410000000005","deviceName":"esm-l3","deviceType":5,"lineID":3,"alarms":0,"cantidadProductos":700,"tiempoProduccion_ds":3900,"paradas":0,"tiempoParadas_s":0})",
+        R"({"devEUI":"a840410000000006","deviceName":"eh-l1","deviceType":6,"lineID":1,"alarms":0,"status":1,"timer1Hz":7200,"cantidadGrades":310,"paradas":4,"tiempoParadas_s":60,"fallaHorno":0,"tiempoFalla_s":0,"metricaMCF":900,"metricaMCF_acum":1200,"metricaFOR":850,"metricaFOR_acum":1100})",
+        R"({"devEUI":"a840410000000007","deviceName":"sh-l1","deviceType":7,"lineID":1,"alarms":0,"checksum":1234,"bancalinos0":10,"bancalinos1":11,"bancalinosComb1":12,"bancalinosComb2":13,"bancalinosTotal":46,"cambioBarrera":2,"cambioBarreraTotal":20,"cambioSentido":3,"cambioSentidoTotal":30,"cantidad":500,"cantidad_total":5000,"paradas_1":1,"paradas_2":2,"timer1Hz":3600})",
+        R"({"devEUI":"a840410000000008","deviceName":"cal-l1","deviceType":8,"lineID":1,"boxesQ1":10,"boxesQ2":5,"boxesQ6":2,"totalBroken":3})",
+        R"({"devEUI":"a840410000000009","deviceName":"other","deviceType":42,"lineID":1,"alarms":0,"cantidad":7})",
+    };
+    return p;
+}
+
+} // namespace bench
+
+// noinline keeps GCC from pairing the inlined free() with new at call sites
+// (-Wmismatched-new-delete false positive).
+[[gnu::noinline]] void* operator new(std::size_t n) {
+    bench::g_allocs.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(n ? n : 1)) return p;
+    throw std::bad_alloc();
+}
+[[gnu::noinline]] void operator delete(void* p) noexcept { std::free(p); }
+[[gnu::noinline]] void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+// Over-aligned types (e.g. LineTable slots) allocate through these.
+[[gnu::noinline]] void* operator new(std::size_t n, std::align_val_t al) {
+    bench::g_allocs.fetch_add(1, std::memory_order_relaxed);
+    const std::size_t a = static_cast<std::size_t>(al);
+    if (void* p = std::aligned_alloc(a, (n + a - 1) / a * a)) return p;
+    throw std::bad_alloc();
+}
+[[gnu::noinline]] void operator delete(void* p, std::align_val_t) noexcept { std::free(p); }
+[[gnu::noinline]] void operator delete(void* p, std::size_t, std::align_val_t) noexcept { std::free(p); }
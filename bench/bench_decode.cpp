@@ -0,0 +1,83 @@
+// celima/data decoding: nlohmann DOM + keyed lookups vs. decode_uplink().
+//
+// Both paths read every known field (CELIMA_UPLINK_FIELDS) as int, which is
+// what the processors do between them.
+//
+// Usage: bench_decode [corpus.jsonl]   (one payload per line; defaults to
+//                                       the built-in samples)
+#include "bench_common.hpp"
+#include "JsonUtils.hpp"
+#include "Uplink.hpp"
+#include <cstdio>
+#include <fstream>
+
+static constexpr int ROUNDS = 200000;
+
+static void report(const char* name, uint64_t allocs, double ns, std::size_t bytes, int n) {
+    std::printf("%-26s %8.2f allocs/msg %9.1f ns/msg %8.1f MB/s\n", name,
+                static_cast<double>(allocs) / n, ns / n, bytes / (ns / 1e9) / 1e6);
+}
+
+int main(int argc, char** argv) {
+    std::vector<std::string> corpus;
+    if (argc > 1) {
+        std::ifstream in(argv[1]);
+        for (std::string line; std::getline(in, line);)
+            if (!line.empty()) corpus.push_back(line);
+    } else {
+        corpus = bench::sample_payloads();
+    }
+    if (corpus.empty()) {
+        std::fprintf(stderr, "empty corpus\n");
+        return 1;
+    }
+    std::printf("%zu payload(s), %d messages per path\n", corpus.size(), ROUNDS);
+
+    std::size_t bytes = 0;
+    for (int i = 0; i < ROUNDS; ++i) bytes += corpus[i % corpus.size()].size();
+
+    {
+        long sum = 0;
+        std::string err;
+        uint64_t a0 = bench::allocs();
+        double t0 = bench::now_ns();
+        for (int i = 0; i < ROUNDS; ++i) {
+            auto j = jsonu::parse(corpus[i % corpus.size()], err);
+            if (!j) continue;
+            for (std::size_t f = 0; f < UF_COUNT; ++f)
+                sum += jsonu::get_opt<int>(*j, upFieldName(static_cast<UF>(f))).value_or(0);
+        }
+        report("DOM (jsonu::parse)", bench::allocs() - a0, bench::now_ns() - t0, bytes, ROUNDS);
+        bench::keep(sum);
+    }
+    {
+        long sum = 0;
+        std::string err;
+        uint64_t a0 = bench::allocs();
+        double t0 = bench::now_ns();
+        for (int i = 0; i < ROUNDS; ++i) {
+            jsonu::ArenaScope arena;   // as DefaultProcessor does per message
+            auto j = jsonu::parse(corpus[i % corpus.size()], err);
+            if (!j) continue;
+            for (std::size_t f = 0; f < UF_COUNT; ++f)
+                sum += jsonu::get_opt<int>(*j, upFieldName(static_cast<UF>(f))).value_or(0);
+        }
+        report("DOM in ArenaScope", bench::allocs() - a0, bench::now_ns() - t0, bytes, ROUNDS);
+        bench::keep(sum);
+    }
+    {
+        long sum = 0;
+        std::string err;
+        Uplink up;
+        uint64_t a0 = bench::allocs();
+        double t0 = bench::now_ns();
+        for (int i = 0; i < ROUNDS; ++i) {
+            if (!decode_uplink(corpus[i % corpus.size()], up, err)) continue;
+            for (std::size_t f = 0; f < UF_COUNT; ++f)
+                sum += up.get_opt(static_cast<UF>(f)).value_or(0);
+        }
+        report("decode_uplink", bench::allocs() - a0, bench::now_ns() - t0, bytes, ROUNDS);
+        bench::keep(sum);
+    }
+    return 0;
+}
@@ -0,0 +1,50 @@
+// Processor dispatch: per-message factory allocation vs. the ProcessorTable.
+//
+// Before: handle_celima_data() called createProcessor()/createDefaultProcessor()
+//         for every uplink (one heap allocation + virtual construction).
+// After:  ProcessorTable is built once and get() is an array lookup.
+#include "bench_common.hpp"
+#include "MessageProcessor.hpp"
+#include "JsonUtils.hpp"
+#include <cstdio>
+
+static constexpr int ITERS = 1000000;
+
+static void report(const char* name, uint64_t allocs, double ns, int n) {
+    std::printf("%-28s %8.2f allocs/msg %10.1f ns/msg\n", name,
+                static_cast<double>(allocs) / n, ns / n);
+}
+
+int main() {
+    // Resolve device types the same way handle_celima_data does.
+    std::vector<int> types;
+    for (const auto& s : bench::sample_payloads()) {
+        std::string err;
+        auto j = jsonu::parse(s, err);
+        types.push_back(j ? j->value("deviceType", 0) : 0);
+    }
+
+    // --- Dispatch only ---
+    {
+        uint64_t a0 = bench::allocs();
+        double t0 = bench::now_ns();
+        for (int i = 0; i < ITERS; ++i) {
+            auto dt = deviceTypeFromInt(types[i % types.size()]);
+            std::unique_ptr<IMessageProcessor> proc = dt ? createProcessor(*dt)
+                                                         : createDefaultProcessor();
+            bench::keep(proc);
+        }
+        report("factory per message", bench::allocs() - a0, bench::now_ns() - t0, ITERS);
+    }
+    {
+        ProcessorTable table;
+        uint64_t a0 = bench::allocs();
+        double t0 = bench::now_ns();
+        for (int i = 0; i < ITERS; ++i) {
+            IMessageProcessor& proc = table.get(types[i % types.size()]);
+            bench::keep(proc);
+        }
+        report("ProcessorTable::get", bench::allocs() - a0, bench::now_ns() - t0, ITERS);
+    }
+    return 0;
+}
@@ -0,0 +1,273 @@
+// End to end: load generator -> loopback broker -> MqttApp -> loopback broker.
+//
+// Runs the real MqttApp (Paho, IngestPipeline, processors) against the
+// in-process broker from loopback_broker.hpp, so no Mosquitto is needed. A
+// load generator publishes synthetic uplinks for all eight device types on
+// four lines at QoS 1 and a fixed rate; the broker observes the app's ISA-95
+// publications. Every uplink yields exactly one <prefix><line>/<device>/production
+// publication, in order per (device, line), which is how the k-th
+// publication on a topic is matched to the k-th uplink of its stream.
+//
+// Reports, per offered rate: achieved rate, end-to-end latency (generator
+// send -> app publication reaching the broker; includes the app's QoS 1
+// subscription and publish round trips), the generator's PUBACK round trip,
+// and the app's ingest counters. Results are also written as JSON.
+//
+//   bench_e2e [seconds per rate] [json out] [rate ...]
+//   defaults: 2, bin/bench/e2e.json, 1000 10000 50000
+#include "bench_common.hpp"
+#include "loopback_broker.hpp"
+#include "MqttApp.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+
+static const char* PREFIX = "bench/";
+static constexpr int LINES = 4;
+static constexpr int TYPES = 8;
+static constexpr int STREAMS = LINES * TYPES;
+
+// Topic segment of each processor's production publication, by DeviceType.
+static const char* DEVICE_TOPIC[TYPES + 1] = {
+    "", "prensa_hidraulica1", "prensa_hidraulica2", "entrada_secador", "salida_secador",
+    "esmalte", "entrada_horno", "salida_horno", "calidad",
+};
+
+// Synthetic uplink for stream (type, line) with counters at step n.
+static std::string make_uplink(int type, int line, uint64_t n) {
+    char buf[640];
+    const unsigned long long k = n;
+    int len = std::snprintf(buf, sizeof(buf),
+                            R"({"devEUI":"a8404100%02x%02x0000","deviceName":"gen-%d-%d","deviceType":%d,"lineID":%d)",
+                            type, line, type, line, type, line);
+    switch (type) {
+        case 3:
+            len += std::snprintf(buf + len, sizeof(buf) - len,
+                                 R"(,"alarms":0,"arranques":%llu,"tiempoOperacion_s":%llu})", k / 4, 60 * k);
+            break;
+        case 6:
+            len += std::snprintf(buf + len, sizeof(buf) - len,
+                                 R"(,"alarms":0,"status":1,"timer1Hz":%llu,"cantidadGrades":%llu,"paradas":%llu,)"
+                                 R"("tiempoParadas_s":%llu,"fallaHorno":0,"tiempoFalla_s":0,"metricaMCF":900,)"
+                                 R"("metricaMCF_acum":%llu,"metricaFOR":850,"metricaFOR_acum":%llu})",
+                                 60 * k, 10 * k, k / 6, 5 * k, 30 * k, 28 * k);
+            break;
+        case 7:
+            len += std::snprintf(buf + len, sizeof(buf) - len,
+                                 R"(,"alarms":0,"checksum":%llu,"bancalinos0":%llu,"bancalinos1":%llu,)"
+                                 R"("bancalinosComb1":%llu,"bancalinosComb2":%llu,"bancalinosTotal":%llu,)"
+                                 R"("cambioBarrera":%llu,"cambioBarreraTotal":%llu,"cambioSentido":%llu,)"
+                                 R"("cambioSentidoTotal":%llu,"cantidad":%llu,"cantidad_total":%llu,)"
+                                 R"("paradas_1":%llu,"paradas_2":%llu,"timer1Hz":%llu})",
+                                 k % 65536, k, k + 1, k / 2, k / 3, 2 * k + 1 + k / 2 + k / 3, k / 10, k / 10,
+                                 k / 8, k / 8, 16 * k, 16 * k, k / 11, k / 14, 60 * k);
+            break;
+        case 8:
+            len += std::snprintf(buf + len, sizeof(buf) - len,
+                                 R"(,"boxesQ1":%llu,"boxesQ2":%llu,"boxesQ6":%llu,"totalBroken":%llu})",
+                                 3 * k, k, k / 5, k / 4);
+            break;
+        default:   // PH_1, PH_2, Salida_secador, Esmalte
+            len += std::snprintf(buf + len, sizeof(buf) - len,
+                                 R"(,"alarms":0,"cantidadProductos":%llu,"tiempoProduccion_ds":%llu,)"
+                                 R"("paradas":%llu,"tiempoParadas_s":%llu})",
+                                 40 * k, 600 * k, k / 8, 15 * (k / 8));
+            break;
+    }
+    return std::string(buf, static_cast<std::size_t>(len));
+}
+
+// Send times per stream, indexed by sequence number; observer reads them.
+struct Tracker {
+    std::vector<std::unique_ptr<std::atomic<int64_t>[]>> sent_ns;
+    std::vector<uint64_t> received;           // observer thread only
+    std::size_t per_stream = 0;
+
+    std::mutex mu;
+    std::vector<double> e2e_us;
+    uint64_t delivered = 0;
+    uint64_t unmatched = 0;
+
+    explicit Tracker(std::size_t cap) : received(STREAMS, 0), per_stream(cap) {
+        for (int i = 0; i < STREAMS; ++i) sent_ns.emplace_back(new std::atomic<int64_t>[cap]());
+    }
+
+    void on_publish(std::string_view topic) {
+        const double now = bench::now_ns();
+        // <PREFIX><line>/<device>/production
+        if (topic.size() < 11 || topic.substr(topic.size() - 11) != "/production") return;
+        topic.remove_prefix(std::strlen(PREFIX));
+        const auto slash = topic.find('/');
+        const int line = std::atoi(std::string(topic.substr(0, slash)).c_str());
+        std::string_view dev = topic.substr(slash + 1);
+        dev = dev.substr(0, dev.find('/'));
+        int type = 1;
+        while (type <= TYPES && dev != DEVICE_TOPIC[type]) ++type;
+
+        std::lock_guard<std::mutex> lk(mu);
+        if (line < 1 || line > LINES || type > TYPES) {
+            ++unmatched;
+            return;
+        }
+        const int s = (type - 1) * LINES + (line - 1);
+        const uint64_t k = received[s]++;
+        if (k >= per_stream) {
+            ++unmatched;
+            return;
+        }
+        const int64_t sent = sent_ns[s][k].load(std::memory_order_acquire);
+        if (sent == 0) {
+            ++unmatched;
+            return;
+        }
+        e2e_us.push_back((now - static_cast<double>(sent)) / 1e3);
+        ++delivered;
+    }
+};
+
+struct Result {
+    unsigned offered = 0;
+    double achieved = 0;
+    uint64_t sent = 0;
+    uint64_t delivered = 0;
+    double e2e_p50 = 0, e2e_p99 = 0, e2e_max = 0;
+    double ack_p50 = 0, ack_p99 = 0;
+    IngestStats ingest;
+};
+
+static double pct(std::vector<double>& v, double p) {
+    if (v.empty()) return 0;
+    const std::size_t i = std::min(v.size() - 1, static_cast<std::size_t>(p * static_cast<double>(v.size())));
+    std::nth_element(v.begin(), v.begin() + static_cast<std::ptrdiff_t>(i), v.end());
+    return v[i];
+}
+
+static Result run_rate(unsigned rate, double seconds, loopback::Client& gen, Tracker& tr,
+                       std::vector<uint64_t>& seq, MqttApp& app) {
+    using namespace std::chrono;
+    Result r;
+    r.offered = rate;
+    const uint64_t total = static_cast<uint64_t>(rate * seconds);
+    {
+        std::lock_guard<std::mutex> lk(tr.mu);
+        tr.e2e_us.clear();
+        tr.delivered = 0;
+    }
+    gen.take_ack_rtt_us();
+
+    // Paced in 1 ms ticks: at each tick, catch up to rate * elapsed.
+    const auto t0 = steady_clock::now();
+    auto tick = t0;
+    uint64_t i = 0;
+    while (i < total) {
+        const double elapsed = duration<double>(steady_clock::now() - t0).count();
+        const uint64_t due = std::min(total, static_cast<uint64_t>(elapsed * rate) + 1);
+        for (; i < due; ++i) {
+            const int s = static_cast<int>(i % STREAMS);
+            const uint64_t k = seq[s]++;
+            if (k >= tr.per_stream) continue;
+            const std::string payload = make_uplink(s / LINES + 1, s % LINES + 1, k + 1);
+            tr.sent_ns[s][k].store(static_cast<int64_t>(bench::now_ns()), std::memory_order_release);
+            gen.publish("celima/data", payload, 1);
+            ++r.sent;
+        }
+        tick += milliseconds(1);
+        std::this_thread::sleep_until(tick);
+    }
+    r.achieved = static_cast<double>(r.sent) / duration<double>(steady_clock::now() - t0).count();
+
+    // Let the pipeline and the app's publishes drain.
+    gen.drain(std::chrono::seconds(5));
+    const auto deadline = steady_clock::now() + std::chrono::seconds(5);
+    for (;;) {
+        {
+            std::lock_guard<std::mutex> lk(tr.mu);
+            if (tr.delivered >= r.sent) break;
+        }
+        if (steady_clock::now() > deadline) break;
+        std::this_thread::sleep_for(milliseconds(5));
+    }
+
+    std::vector<double> ack = gen.take_ack_rtt_us();
+    std::lock_guard<std::mutex> lk(tr.mu);
+    r.delivered = tr.delivered;
+    r.e2e_p50 = pct(tr.e2e_us, 0.50);
+    r.e2e_p99 = pct(tr.e2e_us, 0.99);
+    r.e2e_max = tr.e2e_us.empty() ? 0 : *std::max_element(tr.e2e_us.begin(), tr.e2e_us.end());
+    r.ack_p50 = pct(ack, 0.50);
+    r.ack_p99 = pct(ack, 0.99);
+    r.ingest = app.ingest_stats();
+    return r;
+}
+
+static void write_json(const std::string& path, double seconds, const std::vector<Result>& rs) {
+    FILE* f = std::fopen(path.c_str(), "w");
+    if (!f) {
+        std::fprintf(stderr, "cannot write %s\n", path.c_str());
+        return;
+    }
+    std::fprintf(f, "{\"seconds_per_rate\":%.1f,\"runs\":[", seconds);
+    for (std::size_t i = 0; i < rs.size(); ++i) {
+        const Result& r = rs[i];
+        std::fprintf(f,
+                     "%s\n  {\"offered_msgs_per_s\":%u,\"achieved_msgs_per_s\":%.0f,\"sent\":%llu,"
+                     "\"delivered\":%llu,\"e2e_p50_us\":%.1f,\"e2e_p99_us\":%.1f,\"e2e_max_us\":%.1f,"
+                     "\"puback_p50_us\":%.1f,\"puback_p99_us\":%.1f,\"ingest_max_depth\":%zu,"
+                     "\"ingest_dropped\":%llu}",
+                     i ? "," : "", r.offered, r.achieved, static_cast<unsigned long long>(r.sent),
+                     static_cast<unsigned long long>(r.delivered), r.e2e_p50, r.e2e_p99, r.e2e_max,
+                     r.ack_p50, r.ack_p99, r.ingest.max_depth,
+                     static_cast<unsigned long long>(r.ingest.dropped_oldest + r.ingest.dropped_newest));
+    }
+    std::fprintf(f, "\n]}\n");
+    std::fclose(f);
+}
+
+int main(int argc, char** argv) {
+    const double seconds   = argc > 1 ? std::atof(argv[1]) : 2.0;
+    const std::string json = argc > 2 ? argv[2] : "bin/bench/e2e.json";
+    std::vector<unsigned> rates;
+    for (int i = 3; i < argc; ++i) rates.push_back(static_cast<unsigned>(std::atoi(argv[i])));
+    if (rates.empty()) rates = {1000, 10000, 50000};
+
+    std::size_t total = 0;
+    for (unsigned r : rates) total += static_cast<std::size_t>(r * seconds);
+    Tracker tr(total / STREAMS + 2);
+
+    loopback::Broker broker([&](std::string_view topic, std::string_view, int) { tr.on_publish(topic); });
+    std::string err;
+    if (!broker.start(err)) {
+        std::fprintf(stderr, "%s\n", err.c_str());
+        return 1;
+    }
+
+    IngestOptions ingest;
+    ingest.workers = 2;
+    MqttApp app(broker.uri(), "bench-e2e-app", PREFIX, ingest);
+    app.start();
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));   // SUBSCRIBE goes out async
+
+    loopback::Client gen(256);
+    if (!gen.connect(broker.port(), "bench-e2e-gen", err)) {
+        std::fprintf(stderr, "%s\n", err.c_str());
+        return 1;
+    }
+
+    std::vector<uint64_t> seq(STREAMS, 0);
+    std::vector<Result> results;
+    for (unsigned rate : rates) results.push_back(run_rate(rate, seconds, gen, tr, seq, app));
+
+    gen.disconnect();
+    app.stop();
+    broker.stop();
+
+    std::printf("%-9s %10s %9s %9s %10s %10s %10s %10s %10s %6s\n", "offered", "achieved", "sent",
+                "delivered", "e2e p50us", "e2e p99us", "e2e max", "ack p50us", "ack p99us", "depth");
+    for (const auto& r : results)
+        std::printf("%-9u %10.0f %9llu %9llu %10.1f %10.1f %10.1f %10.1f %10.1f %6zu\n", r.offered, r.achieved,
+                    static_cast<unsigned long long>(r.sent), static_cast<unsigned long long>(r.delivered),
+                    r.e2e_p50, r.e2e_p99, r.e2e_max, r.ack_p50, r.ack_p99, r.ingest.max_depth);
+    write_json(json, seconds, results);
+    std::printf("results written to %s\n", json.c_str());
+    return 0;
+}
@@ -0,0 +1,107 @@
+// DOM path (DefaultProcessor): nlohmann::json on the global heap vs.
+// jsonu::arena_json in a per-message ArenaScope.
+//
+// Each message is parsed, copied into an output document, two small
+// publications are built and everything is serialized (dump() on the heap,
+// jsonu::write into a reused buffer for the arena), which is what the
+// DefaultProcessor does per uplink. Reports allocations and time per message
+// and how much the resident set grew over the run; the last row runs the
+// real DefaultProcessor through a reused PublicationSink.
+//
+// Usage: bench_json_arena [corpus.jsonl]   (defaults to the built-in samples)
+#include "bench_common.hpp"
+#include "JsonUtils.hpp"
+#include "MessageProcessor.hpp"
+#include <cstdio>
+#include <fstream>
+#include <thread>
+
+static constexpr int ROUNDS = 400000;
+
+template <typename Json, typename String, typename Serialize>
+static std::size_t default_path(const std::string& payload, Serialize serialize) {
+    Json msg = Json::parse(payload, nullptr, false);
+    if (msg.is_discarded()) return 0;
+    Json out;
+    out["source"] = "celima/data";
+    out["observed"] = msg;
+    if (auto dev = jsonu::get_opt<String>(msg, "devEUI")) out["devEUI"] = *dev;
+    if (auto dt = jsonu::get_opt<int>(msg, "deviceType")) out["deviceType"] = *dt;
+    Json p1;
+    p1["quantity"] = jsonu::get_opt<int>(msg, "cantidad").value_or(0);
+    p1["ts"] = 1767225600;
+    Json p2;
+    p2["alarms"] = jsonu::get_opt<int>(msg, "alarms").value_or(0);
+    p2["ts"] = 1767225600;
+    return serialize(out) + serialize(p1) + serialize(p2);
+}
+
+// Runs `one(i)` ROUNDS times on a fresh thread (fresh arena) and prints a row.
+template <typename F>
+static void run(const char* name, F one) {
+    std::thread([&] {
+        for (int i = 0; i < 1000; ++i) one(i);   // warm-up: arena blocks, sink buffers
+        const long rss0 = bench::rss_kb();
+        const uint64_t a0 = bench::allocs();
+        const double t0 = bench::now_ns();
+        std::size_t bytes = 0;
+        for (int i = 0; i < ROUNDS; ++i) bytes += one(i);
+        const double ns = bench::now_ns() - t0;
+        const uint64_t allocs = bench::allocs() - a0;
+        bench::keep(bytes);
+        std::printf("%-28s %8.2f allocs/msg %8.1f ns/msg %+8ld KiB RSS %8zu KiB arena\n", name,
+                    static_cast<double>(allocs) / ROUNDS, ns / ROUNDS, bench::rss_kb() - rss0,
+                    jsonu::Arena::local().capacity() / 1024);
+    }).join();
+}
+
+int main(int argc, char** argv) {
+    std::vector<std::string> corpus;
+    if (argc > 1) {
+        std::ifstream in(argv[1]);
+        for (std::string line; std::getline(in, line);)
+            if (!line.empty()) corpus.push_back(line);
+    } else {
+        corpus = bench::sample_payloads();
+    }
+    if (corpus.empty()) {
+        std::fprintf(stderr, "empty corpus\n");
+        return 1;
+    }
+    std::printf("%zu payload(s), %d messages per path, RSS at start %ld KiB\n", corpus.size(), ROUNDS,
+                bench::rss_kb());
+
+    run("nlohmann::json (heap)", [&](int i) {
+        return default_path<nlohmann::json, std::string>(corpus[i % corpus.size()],
+                                                         [](const nlohmann::json& j) { return j.dump().size(); });
+    });
+    std::string buf;
+    run("arena_json + ArenaScope", [&](int i) {
+        jsonu::ArenaScope arena;
+        return default_path<jsonu::arena_json, jsonu::arena_string>(
+            corpus[i % corpus.size()], [&](const jsonu::arena_json& j) {
+                buf.clear();
+                jsonw::Writer w(buf);
+                jsonu::write(w, j);
+                return buf.size();
+            });
+    });
+
+    std::vector<Uplink> ups;
+    for (const auto& p : corpus) {
+        std::string err;
+        Uplink up;
+        if (decode_uplink(p, up, err)) ups.push_back(up);
+    }
+    ProcessorTable table;
+    IMessageProcessor& proc = table.get(0);   // DefaultProcessor
+    const auto now = std::chrono::system_clock::now();
+    PublicationSink out;
+    run("DefaultProcessor::process", [&](int i) {
+        out.clear();
+        proc.process(ups[i % ups.size()], make_message_context(now, 1), "pfx/", out);
+        return out.size();
+    });
+    std::printf("RSS at end %ld KiB\n", bench::rss_kb());
+    return 0;
+}
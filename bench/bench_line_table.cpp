@@ -0,0 +1,104 @@
+// Line-state lookup: LineTable against the std::unordered_map it replaced.
+//
+// Each op looks up one line's state and bumps a counter in it, the access a
+// processor makes per uplink. Line ids come from a fixed pseudo-random
+// sequence: dense plant ids (1..5, 1..60) take LineTable's direct path,
+// scattered ids its open-addressing path. The sharded runs do the same on
+// several threads at once, each with its own container as IngestPipeline
+// shards do, so allocator neighbours show up as false sharing.
+#include "bench_common.hpp"
+#include "LineTable.hpp"
+#include <cstdio>
+#include <random>
+#include <thread>
+#include <unordered_map>
+
+static constexpr int OPS = 4000000;
+
+// Shaped like the largest processor state (Salida_horno: 14 counters).
+struct State {
+    bool     initialized = false;
+    int      shift = -1;
+    uint16_t last[14] = {};
+    uint32_t total[14] = {};
+};
+
+struct MapStates {
+    std::unordered_map<int, State> m;
+    State& get(int line) { return m[line]; }
+};
+
+struct TableStates {
+    LineTable<State> t;
+    State& get(int line) { return *t.try_emplace(line).first; }
+};
+
+static std::vector<int> sequence(std::vector<int> ids, unsigned seed) {
+    std::mt19937 rng(seed);
+    std::vector<int> seq(1 << 16);
+    for (int& k : seq) k = ids[rng() % ids.size()];
+    return seq;
+}
+
+// ns per op on one thread, over OPS lookups along `seq`.
+template <typename States>
+static double run_one(const std::vector<int>& seq) {
+    States states;
+    for (int k : seq) states.get(k);   // warm: every line inserted
+    const std::size_t mask = seq.size() - 1;
+    const double t0 = bench::now_ns();
+    for (int i = 0; i < OPS; ++i) {
+        State& st = states.get(seq[i & mask]);
+        st.total[i % 14] += 1;
+        st.last[i % 14] = static_cast<uint16_t>(i);
+    }
+    const double ns = bench::now_ns() - t0;
+    bench::keep(states);
+    return ns / OPS;
+}
+
+template <typename States>
+static double run(const std::vector<int>& ids, unsigned threads) {
+    if (threads == 1) return run_one<States>(sequence(ids, 1));
+    std::vector<double> ns(threads);
+    std::vector<std::thread> ts;
+    for (unsigned t = 0; t < threads; ++t)
+        ts.emplace_back([&, t] { ns[t] = run_one<States>(sequence(ids, t + 1)); });
+    for (auto& th : ts) th.join();
+    double worst = 0;
+    for (double v : ns) worst = std::max(worst, v);
+    return worst;
+}
+
+static void compare(const char* name, const std::vector<int>& ids, unsigned threads = 1) {
+    const uint64_t a0 = bench::allocs();
+    const double map_ns = run<MapStates>(ids, threads);
+    const uint64_t a1 = bench::allocs();
+    const double table_ns = run<TableStates>(ids, threads);
+    const uint64_t a2 = bench::allocs();
+    std::printf("%-26s %10.2f %10.2f %8.2fx %10llu %10llu\n", name, map_ns, table_ns, map_ns / table_ns,
+                static_cast<unsigned long long>(a1 - a0), static_cast<unsigned long long>(a2 - a1));
+}
+
+int main() {
+    auto range = [](int lo, int hi) {
+        std::vector<int> v;
+        for (int i = lo; i <= hi; ++i) v.push_back(i);
+        return v;
+    };
+    std::vector<int> scattered;
+    std::mt19937 rng(42);
+    for (int i = 0; i < 200; ++i) scattered.push_back(1000 + static_cast<int>(rng() % 1000000));
+
+    const unsigned shards = std::max(2u, std::min(8u, std::thread::hardware_concurrency()));
+    char sharded[64];
+    std::snprintf(sharded, sizeof sharded, "lines 1..60, %u shards", shards);
+
+    std::printf("%-26s %10s %10s %9s %10s %10s\n", "case", "map ns/op", "table ns", "speedup",
+                "map alloc", "table alloc");
+    compare("lines 1..5", range(1, 5));
+    compare("lines 1..60", range(1, 60));
+    compare("200 scattered ids", scattered);
+    compare(sharded, range(1, 60), shards);
+    return 0;
+}
@@ -0,0 +1,161 @@
+// Per-processor throughput, latency and allocations over a recorded corpus.
+//
+// Loads celima/data uplinks (JSON lines, or a journal directory written with
+// JOURNAL_DIR) and drives ProcessorTable -> process() for each DeviceType in a
+// tight loop, no broker involved. Prints a table and writes the same numbers
+// as JSON so runs can be diffed for regressions.
+//
+//   bench_processors [corpus] [json out]
+//   defaults: bench/corpus/celima_data.jsonl, bin/bench/processors.json
+#include "bench_common.hpp"
+#include "DeviceTypes.hpp"
+#include "Journal.hpp"
+#include "MessageProcessor.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <thread>
+
+static constexpr int ITERS = 200000;
+
+struct Sample {
+    Uplink up;
+    int line;
+};
+
+struct Result {
+    std::string name;
+    std::size_t corpus = 0;
+    double msgs_per_s = 0;
+    double p50_ns = 0;
+    double p99_ns = 0;
+    double allocs_per_msg = 0;
+    double pubs_per_msg = 0;
+};
+
+static bool load_corpus(const std::string& path, std::map<int, std::vector<Sample>>& by_type,
+                        std::size_t& invalid) {
+    auto add = [&](std::string_view payload) {
+        std::string err;
+        Sample s;
+        if (!decode_uplink(payload, s.up, err)) {
+            ++invalid;
+            return;
+        }
+        s.line = s.up.value(UF::lineID, 0);
+        by_type[s.up.value(UF::deviceType, 0)].push_back(std::move(s));
+    };
+
+    if (std::filesystem::is_directory(path)) {
+        std::string err;
+        if (!Journal::read(path, [&](auto, std::string_view p) { add(p); }, err)) {
+            std::fprintf(stderr, "%s\n", err.c_str());
+            return false;
+        }
+        return true;
+    }
+    std::ifstream in(path);
+    if (!in) {
+        std::fprintf(stderr, "cannot open corpus %s\n", path.c_str());
+        return false;
+    }
+    for (std::string l; std::getline(in, l);)
+        if (!l.empty()) add(l);
+    return true;
+}
+
+// One fresh thread per processor: line state is thread_local, so every run
+// starts from empty state and does not see the others' lines.
+static Result run(const std::string& name, int type, const std::vector<Sample>& corpus) {
+    Result r;
+    r.name = name;
+    r.corpus = corpus.size();
+    std::thread([&] {
+        ProcessorTable table;
+        IMessageProcessor& proc = table.get(type);
+        const auto now = std::chrono::system_clock::now();
+        PublicationSink out;   // reused, as each MqttApp worker does
+        auto one = [&](int i) {
+            const Sample& s = corpus[i % corpus.size()];
+            out.clear();
+            proc.process(s.up, make_message_context(now, s.line), "pfx/", out);
+            bench::keep(out);
+            return out.size();
+        };
+
+        // Warm-up: fill line state and caches.
+        for (std::size_t i = 0; i < corpus.size(); ++i) one(static_cast<int>(i));
+
+        // Throughput and allocations, untimed per message.
+        std::size_t pubs = 0;
+        uint64_t a0 = bench::allocs();
+        double t0 = bench::now_ns();
+        for (int i = 0; i < ITERS; ++i) pubs += one(i);
+        const double ns = bench::now_ns() - t0;
+        r.allocs_per_msg = static_cast<double>(bench::allocs() - a0) / ITERS;
+        r.msgs_per_s = ITERS / (ns * 1e-9);
+        r.pubs_per_msg = static_cast<double>(pubs) / ITERS;
+
+        // Latency distribution, each message timed on its own.
+        std::vector<double> lat(ITERS);
+        for (int i = 0; i < ITERS; ++i) {
+            double s = bench::now_ns();
+            one(i);
+            lat[i] = bench::now_ns() - s;
+        }
+        std::sort(lat.begin(), lat.end());
+        r.p50_ns = lat[ITERS / 2];
+        r.p99_ns = lat[ITERS * 99 / 100];
+    }).join();
+    return r;
+}
+
+static void write_json(const std::string& path, const std::string& corpus, const std::vector<Result>& rs) {
+    FILE* f = std::fopen(path.c_str(), "w");
+    if (!f) {
+        std::fprintf(stderr, "cannot write %s\n", path.c_str());
+        return;
+    }
+    std::fprintf(f, "{\"corpus\":\"%s\",\"iterations\":%d,\"processors\":[", corpus.c_str(), ITERS);
+    for (std::size_t i = 0; i < rs.size(); ++i) {
+        const Result& r = rs[i];
+        std::fprintf(f,
+                     "%s\n  {\"name\":\"%s\",\"corpus_messages\":%zu,\"msgs_per_s\":%.0f,"
+                     "\"p50_ns\":%.0f,\"p99_ns\":%.0f,\"allocs_per_msg\":%.2f,\"pubs_per_msg\":%.2f}",
+                     i ? "," : "", r.name.c_str(), r.corpus, r.msgs_per_s, r.p50_ns, r.p99_ns,
+                     r.allocs_per_msg, r.pubs_per_msg);
+    }
+    std::fprintf(f, "\n]}\n");
+    std::fclose(f);
+}
+
+int main(int argc, char** argv) {
+    const std::string corpus = argc > 1 ? argv[1] : "bench/corpus/celima_data.jsonl";
+    const std::string json   = argc > 2 ? argv[2] : "bin/bench/processors.json";
+
+    std::map<int, std::vector<Sample>> by_type;
+    std::size_t invalid = 0;
+    if (!load_corpus(corpus, by_type, invalid)) return 1;
+
+    std::vector<Result> results;
+    for (int t = 1; t <= 8; ++t) {
+        const auto dt = deviceTypeFromInt(t);
+        auto it = by_type.find(t);
+        if (it == by_type.end()) {
+            std::fprintf(stderr, "corpus has no %s uplinks\n", deviceTypeName(*dt));
+            continue;
+        }
+        results.push_back(run(deviceTypeName(*dt), t, it->second));
+    }
+
+    std::printf("corpus %s: %zu invalid\n", corpus.c_str(), invalid);
+    std::printf("%-18s %8s %12s %9s %9s %11s\n", "processor", "corpus", "msgs/s", "p50 ns", "p99 ns", "allocs/msg");
+    for (const auto& r : results)
+        std::printf("%-18s %8zu %12.0f %9.0f %9.0f %11.2f\n", r.name.c_str(), r.corpus, r.msgs_per_s,
+                    r.p50_ns, r.p99_ns, r.allocs_per_msg);
+    write_json(json, corpus, results);
+    std::printf("results written to %s\n", json.c_str());
+    return 0;
+}
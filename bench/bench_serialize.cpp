@@ -0,0 +1,141 @@
+// Publication serialization: nlohmann DOM + dump() vs. jsonw schema writer.
+//
+// Before: every processor filled a json object (one map node per key) and
+//         make_pub() called dump() into a fresh string.
+// After:  a plain struct is written through a compile-time schema into the
+//         thread's reusable scratch buffer; only the final payload string is
+//         allocated (by make_pub).
+// Payload shape: prensa_hidraulica*/production (19 keys).
+#include "bench_common.hpp"
+#include "JsonWriter.hpp"
+#include <nlohmann/json.hpp>
+#include <cstdio>
+
+static constexpr int ITERS = 500000;
+
+struct ProdOut {
+    bool        bit15_corruption_cantidadProductos;
+    bool        bit15_corruption_paradas;
+    bool        bit15_corruption_tiempoParadas;
+    uint32_t    cantidadPisadas_min;
+    uint32_t    cantidadPisadas_turno;
+    uint16_t    cantidadProductos_instantaneo;
+    int         cantidadProductos_raw;
+    uint32_t    cantidadProductos_turno;
+    int         maquina_id;
+    uint16_t    paradas_instantaneo;
+    int         paradas_raw;
+    uint32_t    paradas_turno;
+    uint16_t    tiempoParadas_instantaneo;
+    int         tiempoParadas_raw;
+    uint32_t    tiempoParadas_turno_s;
+    uint16_t    tiempoProduccion_ds_instantaneo;
+    uint32_t    tiempoProduccion_turno_s;
+    std::string timestamp_device;
+    int         turno;
+};
+
+static constexpr auto PROD_SCHEMA = jsonw::schema(
+    JSONW_FIELD(ProdOut, bit15_corruption_cantidadProductos),
+    JSONW_FIELD(ProdOut, bit15_corruption_paradas),
+    JSONW_FIELD(ProdOut, bit15_corruption_tiempoParadas),
+    JSONW_FIELD(ProdOut, cantidadPisadas_min),
+    JSONW_FIELD(ProdOut, cantidadPisadas_turno),
+    JSONW_FIELD(ProdOut, cantidadProductos_instantaneo),
+    JSONW_FIELD(ProdOut, cantidadProductos_raw),
+    JSONW_FIELD(ProdOut, cantidadProductos_turno),
+    JSONW_FIELD(ProdOut, maquina_id),
+    JSONW_FIELD(ProdOut, paradas_instantaneo),
+    JSONW_FIELD(ProdOut, paradas_raw),
+    JSONW_FIELD(ProdOut, paradas_turno),
+    JSONW_FIELD(ProdOut, tiempoParadas_instantaneo),
+    JSONW_FIELD(ProdOut, tiempoParadas_raw),
+    JSONW_FIELD(ProdOut, tiempoParadas_turno_s),
+    JSONW_FIELD(ProdOut, tiempoProduccion_ds_instantaneo),
+    JSONW_FIELD(ProdOut, tiempoProduccion_turno_s),
+    JSONW_FIELD(ProdOut, timestamp_device),
+    JSONW_FIELD(ProdOut, turno));
+static_assert(PROD_SCHEMA.valid(), "keys must be sorted");
+
+static ProdOut sample(int i) {
+    ProdOut p{};
+    p.bit15_corruption_paradas        = (i & 7) == 0;
+    p.cantidadPisadas_min             = 14;
+    p.cantidadPisadas_turno           = 4000u + i % 1000;
+    p.cantidadProductos_instantaneo   = static_cast<uint16_t>(1200 + i % 100);
+    p.cantidadProductos_raw           = 1200 + i % 100;
+    p.cantidadProductos_turno         = 12000u + i % 3000;
+    p.maquina_id                      = 1;
+    p.paradas_instantaneo             = 3;
+    p.paradas_raw                     = 3;
+    p.paradas_turno                   = 7;
+    p.tiempoParadas_instantaneo       = 45;
+    p.tiempoParadas_raw               = 45;
+    p.tiempoParadas_turno_s           = 310;
+    p.tiempoProduccion_ds_instantaneo = 5400;
+    p.tiempoProduccion_turno_s        = 17000;
+    p.timestamp_device                = "2025-01-01T10:00:00.000Z";
+    p.turno                           = 1;
+    return p;
+}
+
+static nlohmann::json to_dom(const ProdOut& p) {
+    nlohmann::json j;
+    j["bit15_corruption_cantidadProductos"] = p.bit15_corruption_cantidadProductos;
+    j["bit15_corruption_paradas"]           = p.bit15_corruption_paradas;
+    j["bit15_corruption_tiempoParadas"]     = p.bit15_corruption_tiempoParadas;
+    j["cantidadPisadas_min"]                = p.cantidadPisadas_min;
+    j["cantidadPisadas_turno"]              = p.cantidadPisadas_turno;
+    j["cantidadProductos_instantaneo"]      = p.cantidadProductos_instantaneo;
+    j["cantidadProductos_raw"]              = p.cantidadProductos_raw;
+    j["cantidadProductos_turno"]            = p.cantidadProductos_turno;
+    j["maquina_id"]                         = p.maquina_id;
+    j["paradas_instantaneo"]                = p.paradas_instantaneo;
+    j["paradas_raw"]                        = p.paradas_raw;
+    j["paradas_turno"]                      = p.paradas_turno;
+    j["tiempoParadas_instantaneo"]          = p.tiempoParadas_instantaneo;
+    j["tiempoParadas_raw"]                  = p.tiempoParadas_raw;
+    j["tiempoParadas_turno_s"]              = p.tiempoParadas_turno_s;
+    j["tiempoProduccion_ds_instantaneo"]    = p.tiempoProduccion_ds_instantaneo;
+    j["tiempoProduccion_turno_s"]           = p.tiempoProduccion_turno_s;
+    j["timestamp_device"]                   = p.timestamp_device;
+    j["turno"]                              = p.turno;
+    return j;
+}
+
+static void report(const char* name, uint64_t allocs, double ns, int n) {
+    std::printf("%-28s %8.2f allocs/msg %10.1f ns/msg\n", name,
+                static_cast<double>(allocs) / n, ns / n);
+}
+
+int main() {
+    std::vector<ProdOut> inputs;
+    for (int i = 0; i < 64; ++i) inputs.push_back(sample(i));
+
+    for (const auto& p : inputs) {
+        if (to_dom(p).dump() != jsonw::serialize(p, PROD_SCHEMA)) {
+            std::fprintf(stderr, "output mismatch\n");
+            return 1;
+        }
+    }
+
+    {
+        uint64_t a0 = bench::allocs();
+        double t0 = bench::now_ns();
+        for (int i = 0; i < ITERS; ++i) {
+            std::string s = to_dom(inputs[i % inputs.size()]).dump();
+            bench::keep(s);
+        }
+        report("json + dump()", bench::allocs() - a0, bench::now_ns() - t0, ITERS);
+    }
+    {
+        uint64_t a0 = bench::allocs();
+        double t0 = bench::now_ns();
+        for (int i = 0; i < ITERS; ++i) {
+            std::string s(jsonw::serialize(inputs[i % inputs.size()], PROD_SCHEMA));
+            bench::keep(s);
+        }
+        report("jsonw::serialize + copy", bench::allocs() - a0, bench::now_ns() - t0, ITERS);
+    }
+    return 0;
+}
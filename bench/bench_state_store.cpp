@@ -0,0 +1,62 @@
+// Persistent line state: full processor path with and without the mmap store.
+//
+// With STATE_FILE set every processed uplink also copies its line state into
+// the mapped file and checksums it. This measures that overhead end to end
+// and checks that it stays syscall- and allocation-free per message.
+#include "bench_common.hpp"
+#include "MessageProcessor.hpp"
+#include "StateStore.hpp"
+#include <cstdio>
+#include <thread>
+#include <unistd.h>
+
+static constexpr int ITERS = 500000;
+
+// Runs on a fresh thread: line state is thread_local, so each run starts empty.
+static void run(const char* name, const std::vector<Uplink>& ups, const std::vector<int>& lines) {
+    std::thread([&] {
+        ProcessorTable table;
+        const auto now = std::chrono::system_clock::now();
+        PublicationSink pubs;
+        uint64_t a0 = bench::allocs();
+        double t0 = bench::now_ns();
+        for (int i = 0; i < ITERS; ++i) {
+            const std::size_t k = i % ups.size();
+            auto ctx = make_message_context(now, lines[k]);
+            pubs.clear();
+            table.get(ups[k].value(UF::deviceType, 0)).process(ups[k], ctx, "pfx/", pubs);
+            bench::keep(pubs);
+        }
+        const double ns = bench::now_ns() - t0;
+        std::printf("%-28s %8.2f allocs/msg %8.1f ns/msg\n", name,
+                    static_cast<double>(bench::allocs() - a0) / ITERS, ns / ITERS);
+    }).join();
+}
+
+int main() {
+    std::vector<Uplink> ups;
+    std::vector<int> lines;
+    for (const auto& s : bench::sample_payloads()) {
+        std::string err;
+        Uplink up;
+        if (!decode_uplink(s, up, err)) continue;
+        ups.push_back(up);
+        lines.push_back(up.value(UF::lineID, 0));
+    }
+
+    run("in memory", ups, lines);
+
+    char path[] = "/tmp/bench_state_XXXXXX";
+    const int fd = mkstemp(path);
+    if (fd < 0) return 1;
+    close(fd);
+    std::string err;
+    if (!pstore::open(path, 1024, err)) {
+        std::fprintf(stderr, "%s\n", err.c_str());
+        return 1;
+    }
+    run("mmap state file", ups, lines);
+    pstore::close();
+    unlink(path);
+    return 0;
+}
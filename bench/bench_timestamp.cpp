@@ -0,0 +1,75 @@
+// ISO-8601 timestamps: ostringstream + put_time vs. the cached formatter.
+//
+// Before: iso8601_utc_now() built an ostringstream and called gmtime_r and
+//         put_time on every call, two or three times per message.
+// After:  iso8601_utc() caches the "YYYY-MM-DDTHH:MM:SS" prefix per second
+//         and writes the milliseconds into a fixed buffer; processors take
+//         one per message.
+#include "bench_common.hpp"
+#include "TimeUtils.hpp"
+#include <cstdio>
+#include <iomanip>
+#include <sstream>
+
+static constexpr int ITERS = 1000000;
+
+// The previous implementation, kept here as the reference.
+static std::string legacy_iso8601(std::chrono::system_clock::time_point now) {
+    using namespace std::chrono;
+    const auto ms = duration_cast<milliseconds>(now.time_since_epoch()) % 1000;
+    const std::time_t t = system_clock::to_time_t(now);
+    std::tm utc{};
+    gmtime_r(&t, &utc);
+    std::ostringstream oss;
+    oss << std::put_time(&utc, "%Y-%m-%dT%H:%M:%S")
+        << '.' << std::setfill('0') << std::setw(3) << ms.count() << 'Z';
+    return oss.str();
+}
+
+static void report(const char* name, uint64_t allocs, double ns, int n) {
+    std::printf("%-28s %8.2f allocs/call %8.1f ns/call\n", name,
+                static_cast<double>(allocs) / n, ns / n);
+}
+
+int main() {
+    using namespace std::chrono;
+
+    // Same text for a spread of instants (second and day boundaries included).
+    const auto base = system_clock::now();
+    for (int i = 0; i < 200000; ++i) {
+        const auto tp = base + milliseconds(static_cast<int64_t>(i) * 7919);
+        if (legacy_iso8601(tp) != iso8601_utc(tp).view()) {
+            std::fprintf(stderr, "format mismatch at step %d\n", i);
+            return 1;
+        }
+    }
+
+    {
+        uint64_t a0 = bench::allocs();
+        double t0 = bench::now_ns();
+        for (int i = 0; i < ITERS; ++i) {
+            std::string s = legacy_iso8601(system_clock::now());
+            bench::keep(s);
+        }
+        report("ostringstream + put_time", bench::allocs() - a0, bench::now_ns() - t0, ITERS);
+    }
+    {
+        uint64_t a0 = bench::allocs();
+        double t0 = bench::now_ns();
+        for (int i = 0; i < ITERS; ++i) {
+            std::string s = iso8601_utc_now();
+            bench::keep(s);
+        }
+        report("iso8601_utc_now (string)", bench::allocs() - a0, bench::now_ns() - t0, ITERS);
+    }
+    {
+        uint64_t a0 = bench::allocs();
+        double t0 = bench::now_ns();
+        for (int i = 0; i < ITERS; ++i) {
+            IsoTimestamp ts = iso8601_utc();
+            bench::keep(ts);
+        }
+        report("iso8601_utc (fixed buffer)", bench::allocs() - a0, bench::now_ns() - t0, ITERS);
+    }
+    return 0;
+}
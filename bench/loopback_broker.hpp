@@ -0,0 +1,536 @@
+#pragma once
+// Minimal in-process MQTT 3.1.1 broker and client for end-to-end benchmarks.
+//
+// Enough of the protocol to run MqttApp (Paho) against it on 127.0.0.1:
+// CONNECT, SUBSCRIBE/UNSUBSCRIBE with + and # filters, PUBLISH at QoS 0/1
+// with PUBACK, PINGREQ and DISCONNECT. No retained messages, wills,
+// persistent sessions, retransmission or QoS 2 (a QoS 2 PUBLISH closes the
+// connection). One thread per connection.
+//
+// The broker can call an observer for every PUBLISH it receives, on the
+// publisher's connection thread, which is where the benchmarks take their
+// end-to-end timestamps.
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace loopback {
+
+enum : uint8_t {
+    CONNECT = 1, CONNACK, PUBLISH, PUBACK, PUBREC, PUBREL, PUBCOMP,
+    SUBSCRIBE, SUBACK, UNSUBSCRIBE, UNSUBACK, PINGREQ, PINGRESP, DISCONNECT
+};
+
+namespace wire {
+
+inline void put_u16(std::string& out, uint16_t v) {
+    out.push_back(static_cast<char>(v >> 8));
+    out.push_back(static_cast<char>(v & 0xff));
+}
+
+inline void put_str(std::string& out, std::string_view s) {
+    put_u16(out, static_cast<uint16_t>(s.size()));
+    out.append(s);
+}
+
+inline uint16_t get_u16(const char* p) {
+    return static_cast<uint16_t>((static_cast<uint8_t>(p[0]) << 8) | static_cast<uint8_t>(p[1]));
+}
+
+/** Fixed header + body as one packet. */
+inline std::string packet(uint8_t type, uint8_t flags, std::string_view body) {
+    std::string out;
+    out.reserve(body.size() + 5);
+    out.push_back(static_cast<char>((type << 4) | flags));
+    std::size_t n = body.size();
+    do {
+        uint8_t b = n & 0x7f;
+        n >>= 7;
+        if (n) b |= 0x80;
+        out.push_back(static_cast<char>(b));
+    } while (n);
+    out.append(body);
+    return out;
+}
+
+inline std::string publish(std::string_view topic, std::string_view payload, int qos, uint16_t id) {
+    std::string body;
+    body.reserve(topic.size() + payload.size() + 4);
+    put_str(body, topic);
+    if (qos > 0) put_u16(body, id);
+    body.append(payload);
+    return packet(PUBLISH, static_cast<uint8_t>(qos << 1), body);
+}
+
+inline std::string ack(uint8_t type, uint16_t id) {
+    std::string body;
+    put_u16(body, id);
+    return packet(type, 0, body);
+}
+
+inline bool send_all(int fd, std::string_view data) {
+    while (!data.empty()) {
+        const ssize_t n = ::send(fd, data.data(), data.size(), MSG_NOSIGNAL);
+        if (n <= 0) {
+            if (n < 0 && errno == EINTR) continue;
+            return false;
+        }
+        data.remove_prefix(static_cast<std::size_t>(n));
+    }
+    return true;
+}
+
+/** Buffered packet reader over a socket. */
+class Reader {
+public:
+    explicit Reader(int fd) : fd_(fd) { buf_.resize(64 << 10); }
+
+    /** Next packet; false on EOF, error or a malformed header. */
+    bool next(uint8_t& header, std::string_view& body) {
+        for (;;) {
+            if (std::size_t used = 0; parse(header, body, used)) {
+                start_ += used;
+                return true;
+            }
+            if (start_ > 0) {
+                std::memmove(buf_.data(), buf_.data() + start_, end_ - start_);
+                end_ -= start_;
+                start_ = 0;
+            }
+            if (end_ == buf_.size()) buf_.resize(buf_.size() * 2);
+            const ssize_t n = ::recv(fd_, buf_.data() + end_, buf_.size() - end_, 0);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return false;
+            end_ += static_cast<std::size_t>(n);
+        }
+    }
+
+private:
+    int fd_;
+    std::string buf_;
+    std::size_t start_ = 0, end_ = 0;
+
+    bool parse(uint8_t& header, std::string_view& body, std::size_t& used) const {
+        const std::size_t avail = end_ - start_;
+        const char* p = buf_.data() + start_;
+        if (avail < 2) return false;
+        std::size_t len = 0, i = 1;
+        for (int shift = 0;; shift += 7, ++i) {
+            if (i >= avail) return false;
+            if (i > 4) return false;   // corrupt length; caller sees EOF eventually
+            const uint8_t b = static_cast<uint8_t>(p[i]);
+            len |= static_cast<std::size_t>(b & 0x7f) << shift;
+            if (!(b & 0x80)) break;
+        }
+        ++i;
+        if (avail < i + len) return false;
+        header = static_cast<uint8_t>(p[0]);
+        body = std::string_view(p + i, len);
+        used = i + len;
+        return true;
+    }
+};
+
+inline int tcp_nodelay(int fd) {
+    int one = 1;
+    ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return fd;
+}
+
+} // namespace wire
+
+/** MQTT topic filter match with + and #. */
+inline bool topic_matches(std::string_view filter, std::string_view topic) {
+    for (;;) {
+        const auto fs = filter.find('/');
+        const auto ts = topic.find('/');
+        const std::string_view f = filter.substr(0, fs);
+        if (f == "#") return true;
+        if (f != "+" && f != topic.substr(0, ts)) return false;
+        if (ts == std::string_view::npos)
+            return fs == std::string_view::npos || filter.substr(fs + 1) == "#";
+        if (fs == std::string_view::npos) return false;
+        filter.remove_prefix(fs + 1);
+        topic.remove_prefix(ts + 1);
+    }
+}
+
+struct BrokerStats {
+    uint64_t connections  = 0;
+    uint64_t publishes_in = 0;
+    uint64_t deliveries   = 0;   // PUBLISH packets sent to subscribers
+    uint64_t pubacks_in   = 0;
+};
+
+class Broker {
+public:
+    using Observer = std::function<void(std::string_view topic, std::string_view payload, int qos)>;
+
+    explicit Broker(Observer observer = {}) : observer_(std::move(observer)) {}
+    ~Broker() { stop(); }
+
+    Broker(const Broker&) = delete;
+    Broker& operator=(const Broker&) = delete;
+
+    /** Listen on 127.0.0.1:`port` (0 = any free port) and start accepting. */
+    bool start(std::string& err, uint16_t port = 0) {
+        listen_fd_ = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        int one = 1;
+        ::setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = htons(port);
+        socklen_t len = sizeof(addr);
+        if (listen_fd_ < 0 || ::bind(listen_fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+            ::listen(listen_fd_, 16) != 0 ||
+            ::getsockname(listen_fd_, reinterpret_cast<sockaddr*>(&addr), &len) != 0) {
+            err = std::string("listen: ") + std::strerror(errno);
+            if (listen_fd_ >= 0) ::close(listen_fd_);
+            listen_fd_ = -1;
+            return false;
+        }
+        port_ = ntohs(addr.sin_port);
+        accept_thread_ = std::thread(&Broker::accept_loop, this);
+        return true;
+    }
+
+    void stop() {
+        if (listen_fd_ < 0) return;
+        ::shutdown(listen_fd_, SHUT_RDWR);
+        if (accept_thread_.joinable()) accept_thread_.join();
+        ::close(listen_fd_);
+        listen_fd_ = -1;
+
+        std::list<std::shared_ptr<Session>> sessions;
+        {
+            std::lock_guard<std::mutex> lk(mu_);
+            sessions.swap(sessions_);
+        }
+        for (auto& s : sessions) ::shutdown(s->fd, SHUT_RDWR);
+        for (auto& s : sessions) {
+            if (s->thread.joinable()) s->thread.join();
+            ::close(s->fd);
+        }
+    }
+
+    uint16_t port() const { return port_; }
+    std::string uri() const { return "tcp://127.0.0.1:" + std::to_string(port_); }
+
+    BrokerStats stats() const {
+        BrokerStats s;
+        s.connections  = connections_.load(std::memory_order_relaxed);
+        s.publishes_in = publishes_in_.load(std::memory_order_relaxed);
+        s.deliveries   = deliveries_.load(std::memory_order_relaxed);
+        s.pubacks_in   = pubacks_in_.load(std::memory_order_relaxed);
+        return s;
+    }
+
+private:
+    struct Session {
+        int fd = -1;
+        std::thread thread;
+        std::mutex write_mu;                          // one writer at a time on fd
+        uint16_t next_id = 0;                         // under write_mu
+        std::vector<std::pair<std::string, int>> subs; // under Broker::mu_
+        bool open = true;                             // under Broker::mu_
+    };
+
+    Observer observer_;
+    int listen_fd_ = -1;
+    uint16_t port_ = 0;
+    std::thread accept_thread_;
+
+    mutable std::mutex mu_;
+    std::list<std::shared_ptr<Session>> sessions_;
+
+    std::atomic<uint64_t> connections_{0};
+    std::atomic<uint64_t> publishes_in_{0};
+    std::atomic<uint64_t> deliveries_{0};
+    std::atomic<uint64_t> pubacks_in_{0};
+
+    void accept_loop() {
+        for (;;) {
+            const int fd = ::accept4(listen_fd_, nullptr, nullptr, SOCK_CLOEXEC);
+            if (fd < 0) {
+                if (errno == EINTR || errno == ECONNABORTED) continue;
+                return;
+            }
+            auto s = std::make_shared<Session>();
+            s->fd = wire::tcp_nodelay(fd);
+            connections_.fetch_add(1, std::memory_order_relaxed);
+            std::lock_guard<std::mutex> lk(mu_);
+            sessions_.push_back(s);
+            s->thread = std::thread(&Broker::serve, this, s.get());
+        }
+    }
+
+    static void write(Session& s, std::string_view pkt) {
+        std::lock_guard<std::mutex> lk(s.write_mu);
+        wire::send_all(s.fd, pkt);
+    }
+
+    void serve(Session* self) {
+        wire::Reader in(self->fd);
+        uint8_t header;
+        std::string_view body;
+        bool connected = false;
+        while (in.next(header, body)) {
+            const uint8_t type = header >> 4;
+            if (!connected && type != CONNECT) break;
+            if (type == CONNECT) {
+                // protocol name, level: 3 (3.1) and 4 (3.1.1) are accepted
+                if (body.size() < 10) break;
+                const uint16_t nlen = wire::get_u16(body.data());
+                if (body.size() < 2u + nlen + 4) break;
+                const uint8_t level = static_cast<uint8_t>(body[2 + nlen]);
+                const bool ok = level == 3 || level == 4;
+                const char connack[4] = {static_cast<char>(CONNACK << 4), 2, 0, ok ? char(0) : char(1)};
+                write(*self, std::string_view(connack, 4));
+                if (!ok) break;
+                connected = true;
+            } else if (type == PUBLISH) {
+                const int qos = (header >> 1) & 3;
+                if (qos > 1 || body.size() < 2) break;
+                const uint16_t tlen = wire::get_u16(body.data());
+                const std::size_t off = 2u + tlen + (qos ? 2 : 0);
+                if (body.size() < off) break;
+                const std::string_view topic = body.substr(2, tlen);
+                const std::string_view payload = body.substr(off);
+                publishes_in_.fetch_add(1, std::memory_order_relaxed);
+                if (observer_) observer_(topic, payload, qos);
+                if (qos == 1) write(*self, wire::ack(PUBACK, wire::get_u16(body.data() + 2 + tlen)));
+                route(topic, payload, qos);
+            } else if (type == PUBACK) {
+                pubacks_in_.fetch_add(1, std::memory_order_relaxed);
+            } else if (type == SUBSCRIBE || type == UNSUBSCRIBE) {
+                if (body.size() < 2) break;
+                const uint16_t id = wire::get_u16(body.data());
+                std::string codes;
+                std::size_t p = 2;
+                std::lock_guard<std::mutex> lk(mu_);
+                while (p + 2 <= body.size()) {
+                    const uint16_t flen = wire::get_u16(body.data() + p);
+                    std::string filter(body.substr(p + 2, flen));
+                    p += 2u + flen;
+                    std::erase_if(self->subs, [&](const auto& e) { return e.first == filter; });
+                    if (type == SUBSCRIBE) {
+                        const int q = p < body.size() ? std::min(static_cast<int>(body[p]) & 3, 1) : 0;
+                        ++p;
+                        self->subs.emplace_back(std::move(filter), q);
+                        codes.push_back(static_cast<char>(q));
+                    }
+                }
+                std::string ack_body;
+                wire::put_u16(ack_body, id);
+                ack_body += codes;
+                write(*self, wire::packet(type == SUBSCRIBE ? SUBACK : UNSUBACK, 0, ack_body));
+            } else if (type == PINGREQ) {
+                const char resp[2] = {static_cast<char>(PINGRESP << 4), 0};
+                write(*self, std::string_view(resp, 2));
+            } else if (type == DISCONNECT) {
+                break;
+            }
+        }
+        std::lock_guard<std::mutex> lk(mu_);
+        self->open = false;
+        self->subs.clear();
+        ::shutdown(self->fd, SHUT_RDWR);
+    }
+
+    void route(std::string_view topic, std::string_view payload, int qos) {
+        std::vector<std::pair<Session*, int>> targets;
+        {
+            std::lock_guard<std::mutex> lk(mu_);
+            for (auto& s : sessions_) {
+                if (!s->open) continue;
+                int q = -1;
+                for (const auto& [filter, sq] : s->subs)
+                    if (topic_matches(filter, topic)) q = std::max(q, std::min(sq, qos));
+                if (q >= 0) targets.emplace_back(s.get(), q);
+            }
+        }
+        // Sessions are only destroyed in stop(), after every serve() returned.
+        for (auto [s, q] : targets) {
+            std::lock_guard<std::mutex> lk(s->write_mu);
+            const uint16_t id = q ? (++s->next_id ? s->next_id : ++s->next_id) : 0;
+            wire::send_all(s->fd, wire::publish(topic, payload, q, id));
+            deliveries_.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+};
+
+/**
+ * Blocking MQTT client for load generation. publish() at QoS 1 keeps at most
+ * `window` messages unacknowledged and records each PUBACK round trip.
+ */
+class Client {
+public:
+    using Handler = std::function<void(std::string_view topic, std::string_view payload)>;
+
+    explicit Client(unsigned window = 64) : window_(window ? window : 1) {
+        sent_at_.resize(65536);
+    }
+    ~Client() { disconnect(); }
+
+    Client(const Client&) = delete;
+    Client& operator=(const Client&) = delete;
+
+    /** Called on the reader thread for every PUBLISH from the broker. */
+    void on_message(Handler h) { handler_ = std::move(h); }
+
+    bool connect(uint16_t port, const std::string& client_id, std::string& err) {
+        fd_ = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = htons(port);
+        if (fd_ < 0 || ::connect(fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+            err = std::string("connect: ") + std::strerror(errno);
+            return false;
+        }
+        wire::tcp_nodelay(fd_);
+
+        std::string body;
+        wire::put_str(body, "MQTT");
+        body.push_back(4);      // 3.1.1
+        body.push_back(0x02);   // clean session
+        wire::put_u16(body, 60);
+        wire::put_str(body, client_id);
+        wire::send_all(fd_, wire::packet(CONNECT, 0, body));
+
+        wire::Reader in(fd_);
+        uint8_t header;
+        std::string_view resp;
+        if (!in.next(header, resp) || (header >> 4) != CONNACK || resp.size() < 2 || resp[1] != 0) {
+            err = "CONNECT refused";
+            return false;
+        }
+        reader_ = std::thread(&Client::read_loop, this);
+        return true;
+    }
+
+    void disconnect() {
+        if (fd_ < 0) return;
+        const char pkt[2] = {static_cast<char>(DISCONNECT << 4), 0};
+        send(std::string_view(pkt, 2));
+        ::shutdown(fd_, SHUT_RDWR);
+        if (reader_.joinable()) reader_.join();
+        ::close(fd_);
+        fd_ = -1;
+    }
+
+    /** SUBSCRIBE and wait for the SUBACK. */
+    void subscribe(std::string_view filter, int qos) {
+        std::string body;
+        wire::put_u16(body, 1);
+        wire::put_str(body, filter);
+        body.push_back(static_cast<char>(qos));
+        std::unique_lock<std::mutex> lk(mu_);
+        const uint64_t before = subacks_;
+        lk.unlock();
+        send(wire::packet(SUBSCRIBE, 2, body));
+        lk.lock();
+        cv_.wait(lk, [&] { return subacks_ > before || closed_; });
+    }
+
+    /** Blocks while `window` QoS 1 messages are unacknowledged. */
+    void publish(std::string_view topic, std::string_view payload, int qos) {
+        uint16_t id = 0;
+        if (qos > 0) {
+            std::unique_lock<std::mutex> lk(mu_);
+            cv_.wait(lk, [&] { return inflight_ < window_ || closed_; });
+            if (closed_) return;
+            ++inflight_;
+            id = ++next_id_ ? next_id_ : ++next_id_;
+            sent_at_[id] = std::chrono::steady_clock::now();
+        }
+        send(wire::publish(topic, payload, qos, id));
+    }
+
+    /** Wait until every QoS 1 publish has been acknowledged (or `timeout`). */
+    bool drain(std::chrono::milliseconds timeout) {
+        std::unique_lock<std::mutex> lk(mu_);
+        return cv_.wait_for(lk, timeout, [&] { return inflight_ == 0 || closed_; });
+    }
+
+    /** PUBACK round trips (microseconds) since the last call. */
+    std::vector<double> take_ack_rtt_us() {
+        std::lock_guard<std::mutex> lk(mu_);
+        std::vector<double> out;
+        out.swap(ack_rtt_us_);
+        return out;
+    }
+
+private:
+    unsigned window_;
+    int fd_ = -1;
+    std::thread reader_;
+    Handler handler_;
+    std::mutex send_mu_;
+
+    std::mutex mu_;
+    std::condition_variable cv_;
+    unsigned inflight_ = 0;
+    uint16_t next_id_ = 0;
+    uint64_t subacks_ = 0;
+    bool closed_ = false;
+    std::vector<std::chrono::steady_clock::time_point> sent_at_;   // by packet id
+    std::vector<double> ack_rtt_us_;
+
+    void send(std::string_view pkt) {
+        std::lock_guard<std::mutex> lk(send_mu_);
+        wire::send_all(fd_, pkt);
+    }
+
+    void read_loop() {
+        wire::Reader in(fd_);
+        uint8_t header;
+        std::string_view body;
+        while (in.next(header, body)) {
+            const uint8_t type = header >> 4;
+            if (type == PUBACK && body.size() >= 2) {
+                const auto now = std::chrono::steady_clock::now();
+                std::lock_guard<std::mutex> lk(mu_);
+                const uint16_t id = wire::get_u16(body.data());
+                ack_rtt_us_.push_back(std::chrono::duration<double, std::micro>(now - sent_at_[id]).count());
+                if (inflight_ > 0) --inflight_;
+                cv_.notify_all();
+            } else if (type == SUBACK) {
+                std::lock_guard<std::mutex> lk(mu_);
+                ++subacks_;
+                cv_.notify_all();
+            } else if (type == PUBLISH && body.size() >= 2) {
+                const int qos = (header >> 1) & 3;
+                const uint16_t tlen = wire::get_u16(body.data());
+                const std::size_t off = 2u + tlen + (qos ? 2 : 0);
+                if (body.size() < off) break;
+                if (handler_) handler_(body.substr(2, tlen), body.substr(off));
+                if (qos == 1) send(wire::ack(PUBACK, wire::get_u16(body.data() + 2 + tlen)));
+            }
+        }
+        std::lock_guard<std::mutex> lk(mu_);
+        closed_ = true;
+        cv_.notify_all();
+    }
+};
+
+} // namespace loopback
@@ -0,0 +1,250 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include "DataQuality.hpp"
+#include "JsonWriter.hpp"
+#include "Metrics.hpp"
+
+/**
+ * counters: compile-time description of the PLC counter fields a processor
+ * turns into per-shift totals, and the state/update code generated from it.
+ *
+ * A processor lists its fields once, as a constexpr array of Field:
+ *
+ *   constexpr counters::Field PRENSA_FIELDS[] = {
+ *       {.name = "cantidadProductos",   .key = "acc_pisadas",
+ *        .clean = counters::Clean::Mask15, .wrap = counters::Wrap::Mod15},
+ *       {.name = "tiempoProduccion_ds", .key = "acc_prod_time_s", .scale = 0.1},
+ *       ...
+ *   };
+ *
+ * and keeps a counters::Bank<PRENSA_FIELDS> in its line state. Per message
+ * it passes the raw uplink values, in field order, to read() (clean + bit 15
+ * check), then to reset() on a new shift or update() otherwise.
+ *
+ * Bank is a packed SoA block (last readings, integer totals, scaled totals)
+ * and trivially copyable, so it persists in a pstore slot as is. update()
+ * runs the same steps for every field with per-field constants (mask, cap,
+ * wrap, limit) instead of per-field code, so the compiler can unroll and
+ * vectorize it.
+ */
+namespace counters {
+
+/** How a raw uplink value becomes a reading. */
+enum class Clean : uint8_t {
+    Raw16,    // low 16 bits
+    Mask15,   // low 15 bits; bit 15 is a bank/corruption flag (Readings::corrupt, bit15_corruption)
+    Low15,    // low 15 bits; bit 15 is dropped without being reported
+    Bcd,      // low 16 bits capped at 9999 (BCD-converted PLC register)
+};
+
+/** Counter modulus: the delta of a reading lower than the last one wraps. */
+enum class Wrap : uint8_t { Mod16, Mod15 };
+
+struct Field {
+    std::string_view name;          // uplink field (data-quality report)
+    std::string_view key;           // shift_summary key of the total
+    Clean    clean = Clean::Raw16;
+    Wrap     wrap  = Wrap::Mod16;
+    /** 0: every delta counts. Otherwise deltas above it are dropped as
+     *  noise (safe_delta_u16) and every delta is classified for dq. */
+    uint16_t max_reasonable = 0;
+    /** 0: integer total (uint32). Otherwise a double total += delta * scale. */
+    double   scale = 0;
+    /** Optional second shift_summary key for the same total. */
+    std::string_view alias = {};
+};
+
+namespace detail {
+
+constexpr bool is_scaled(const Field& f) { return f.scale != 0; }
+constexpr bool is_checked(const Field& f) { return f.max_reasonable != 0; }
+
+template <const auto& F>
+constexpr std::size_t count_if(bool (*pred)(const Field&)) {
+    std::size_t n = 0;
+    for (const Field& f : F) n += pred(f);
+    return n;
+}
+
+/** One constant per field, for the branch-free update loop. */
+template <typename T, const auto& F, typename Fn>
+constexpr std::array<T, std::size(F)> per_field(Fn fn) {
+    std::array<T, std::size(F)> a{};
+    for (std::size_t i = 0; i < std::size(F); ++i) a[i] = fn(F[i]);
+    return a;
+}
+
+} // namespace detail
+
+template <const auto& F>
+class Bank {
+public:
+    static constexpr std::size_t N = std::size(F);
+    static_assert(N > 0 && N <= 32, "1..32 counter fields");
+
+    static constexpr std::size_t SCALED  = detail::count_if<F>(detail::is_scaled);
+    static constexpr std::size_t CHECKED = detail::count_if<F>(detail::is_checked);
+
+    /** Uplink names of the checked fields, in field order (dq report). */
+    static constexpr std::array<std::string_view, CHECKED> CHECKED_NAMES = [] {
+        std::array<std::string_view, CHECKED> a{};
+        for (std::size_t i = 0, k = 0; i < N; ++i)
+            if (detail::is_checked(F[i])) a[k++] = F[i].name;
+        return a;
+    }();
+    static_assert(CHECKED <= dq::MAX_FIELDS, "too many checked fields for dq");
+
+    /** Cleaned readings of one message and its bit 15 flags (Mask15 fields). */
+    struct Readings {
+        std::array<uint16_t, N> v{};
+        uint32_t corrupt = 0;   // bit i: field i had bit 15 set
+
+        bool corrupted(std::size_t i) const { return (corrupt >> i) & 1u; }
+    };
+
+    std::array<uint16_t, N>     last{};
+    std::array<uint32_t, N>     total{};     // integer totals (unused for scaled fields)
+    std::array<double, SCALED>  scaled{};    // totals of scaled fields, by SLOT
+
+    static Readings read(const std::array<int, N>& raw) {
+        Readings r;
+        for (std::size_t i = 0; i < N; ++i) {
+            r.v[i] = std::min<uint16_t>(static_cast<uint16_t>(raw[i]) & MASK[i], CAP[i]);
+            r.corrupt |= static_cast<uint32_t>(FLAG15[i] & (raw[i] >> 15) & 1) << i;
+        }
+        if (r.corrupt) metrics::registry().bit15_corruption.add(std::popcount(r.corrupt));
+        return r;
+    }
+
+    /** First message of a shift: totals start at zero from these readings. */
+    void reset(const Readings& r) {
+        *this = Bank{};
+        last = r.v;
+    }
+
+    /**
+     * Accumulate the deltas from the last readings and return them (0 where
+     * dropped). Checked fields are classified into `quality` when given.
+     */
+    std::array<uint16_t, N> update(const Readings& r, dq::LineCounters* quality) {
+        std::array<uint16_t, N> raw_d, d;
+        for (std::size_t i = 0; i < N; ++i) {
+            raw_d[i] = static_cast<uint16_t>(r.v[i] - last[i]) & WRAP[i];
+            d[i] = raw_d[i] <= LIMIT[i] ? raw_d[i] : 0;
+            total[i] += d[i];
+        }
+        for (std::size_t i = 0; i < N; ++i)
+            if (F[i].scale != 0) scaled[SLOT[i]] += d[i] * F[i].scale;
+
+        if constexpr (CHECKED > 0) {
+            for (std::size_t i = 0, k = 0; i < N; ++i) {
+                if (!detail::is_checked(F[i])) continue;
+                dq::Delta outcome = dq::Delta::Counted;
+                if (raw_d[i] == 0)
+                    outcome = dq::Delta::Zero;
+                else if (raw_d[i] > LIMIT[i])
+                    outcome = dq::Delta::Rejected;
+                else if (r.v[i] < last[i])
+                    outcome = dq::Delta::Rollover;
+                if (outcome == dq::Delta::Rejected) metrics::registry().safe_delta_rejected.add();
+                if (quality) quality->field(k)->add(outcome);
+                ++k;
+            }
+        }
+        last = r.v;
+        return d;
+    }
+
+    /** Add the totals of another device's bank (line aggregation); `last` is kept. */
+    void merge(const Bank& o) {
+        for (std::size_t i = 0; i < N; ++i) total[i] += o.total[i];
+        for (std::size_t k = 0; k < SCALED; ++k) scaled[k] += o.scaled[k];
+    }
+
+    /** Total of an integer field. */
+    uint32_t count(std::size_t i) const { return total[i]; }
+    /** Total of a scaled field. */
+    double value(std::size_t i) const { return scaled[SLOT[i]]; }
+
+    /** The totals as a JSON object, keys (and aliases) in byte order. */
+    std::string summary() const {
+        std::string out;
+        jsonw::Writer w(out);
+        w.raw('{');
+        for (std::size_t j = 0; j < KEYS.size(); ++j) {
+            const std::size_t i = KEYS[j].field;
+            w.raw(j ? std::string_view(",\"") : std::string_view("\""));
+            w.raw(KEYS[j].key);
+            w.raw(std::string_view("\":"));
+            if (F[i].scale != 0)
+                w.value(scaled[SLOT[i]]);
+            else
+                w.value(total[i]);
+        }
+        w.raw('}');
+        return out;
+    }
+
+private:
+    static constexpr auto MASK = detail::per_field<uint16_t, F>([](const Field& f) {
+        return static_cast<uint16_t>(f.clean == Clean::Mask15 || f.clean == Clean::Low15 ? 0x7FFF : 0xFFFF);
+    });
+    static constexpr auto CAP = detail::per_field<uint16_t, F>([](const Field& f) {
+        return static_cast<uint16_t>(f.clean == Clean::Bcd ? 9999 : 0xFFFF);
+    });
+    static constexpr auto FLAG15 = detail::per_field<int, F>([](const Field& f) {
+        return f.clean == Clean::Mask15 ? 1 : 0;
+    });
+    static constexpr auto WRAP = detail::per_field<uint16_t, F>([](const Field& f) {
+        return static_cast<uint16_t>(f.wrap == Wrap::Mod15 ? 0x7FFF : 0xFFFF);
+    });
+    static constexpr auto LIMIT = detail::per_field<uint16_t, F>([](const Field& f) {
+        return static_cast<uint16_t>(f.max_reasonable ? f.max_reasonable : 0xFFFF);
+    });
+    static constexpr std::array<std::size_t, N> SLOT = [] {
+        std::array<std::size_t, N> a{};
+        for (std::size_t i = 0, k = 0; i < N; ++i) a[i] = detail::is_scaled(F[i]) ? k++ : 0;
+        return a;
+    }();
+
+    struct Key {
+        std::string_view key;
+        std::size_t field;
+    };
+    static constexpr std::size_t KEY_COUNT = [] {
+        std::size_t n = N;
+        for (const Field& f : F) n += !f.alias.empty();
+        return n;
+    }();
+    static constexpr std::array<Key, KEY_COUNT> KEYS = [] {
+        std::array<Key, KEY_COUNT> a{};
+        std::size_t k = 0;
+        for (std::size_t i = 0; i < N; ++i) {
+            a[k++] = {F[i].key, i};
+            if (!F[i].alias.empty()) a[k++] = {F[i].alias, i};
+        }
+        std::sort(a.begin(), a.end(), [](const Key& x, const Key& y) { return x.key < y.key; });
+        return a;
+    }();
+
+    static_assert([] {
+        for (const Field& f : F)
+            if (f.wrap == Wrap::Mod15 && f.clean != Clean::Mask15 && f.clean != Clean::Low15)
+                return false;   // 15-bit modulus needs 15-bit readings
+        for (std::size_t j = 0; j < KEYS.size(); ++j) {
+            for (char c : KEYS[j].key)
+                if (static_cast<unsigned char>(c) < 0x20 || c == '"' || c == '\\') return false;
+            if (j > 0 && !(KEYS[j - 1].key < KEYS[j].key)) return false;   // unique
+        }
+        return true;
+    }(), "invalid counter field description");
+};
+
+} // namespace counters
@@ -0,0 +1,67 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+
+/**
+ * Data-quality counters for the PLC counter deltas (safe_delta_u16).
+ *
+ * Every delta a processor takes from a 16-bit counter is classified as
+ * counted, zero (counter did not move), rollover (wrapped past 65535 and
+ * counted) or rejected (implausible jump, dropped). The counts are kept per
+ * (device type, line, field) so noise can be told apart from lost
+ * production.
+ *
+ * Storage follows the processor state: each worker shard owns its lines'
+ * blocks (one cache-line aligned LineCounters per line, in a per-shard
+ * array), written by that shard only, without atomic read-modify-write.
+ * render() sums every shard's blocks from any thread.
+ */
+namespace dq {
+
+enum class Delta : uint8_t { Counted, Zero, Rollover, Rejected };
+
+constexpr std::size_t MAX_FIELDS = 8;
+
+/** Outcomes of one delta-checked field; single writer (the owning shard). */
+struct FieldCounters {
+    std::array<std::atomic<uint32_t>, 4> n{};   // by Delta
+
+    void add(Delta d) {
+        auto& c = n[static_cast<std::size_t>(d)];
+        c.store(c.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+};
+
+struct alignas(64) LineCounters {
+    std::array<FieldCounters, MAX_FIELDS> fields;
+
+    FieldCounters* field(std::size_t i) { return &fields[i]; }
+};
+
+/** Null-tolerant add, for callers without counters. */
+inline void count(FieldCounters* f, Delta d) {
+    if (f) f->add(d);
+}
+
+/**
+ * Counters of (kind, line) on the calling shard, created on first use.
+ * `fields` names the delta fields of `kind` by index (at most MAX_FIELDS;
+ * must outlive the process, e.g. a static array); the first call for a
+ * kind registers them.
+ */
+LineCounters& line(int kind, int line, std::span<const std::string_view> fields);
+
+/**
+ * JSON report summed over all shards, totals since start:
+ *
+ *   {"devices":{"Entrada_horno":{"1":{"grades":{"counted":..,"rejected":..,
+ *    "rollover":..,"zero":..},...}}},"ts":".."}
+ */
+std::string render();
+
+} // namespace dq
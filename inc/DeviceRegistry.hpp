@@ -0,0 +1,44 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include "Uplink.hpp"
+
+/**
+ * devices: registry of the physical devices (LoRaWAN devEUI) seen in
+ * uplinks, so line state can be kept per device rather than per line.
+ *
+ * Each EUI-64 is interned once into a small dense Id, stable for the life
+ * of the process (not across restarts: persist the EUI, see eui()). The
+ * registry is shared by all worker shards; every thread keeps its own
+ * open-addressing index over the EUIs it has met, so a lookup after the
+ * first is one hash probe without locking.
+ */
+namespace devices {
+
+using Id = uint32_t;
+
+/** Uplinks without a (valid) devEUI: the line's legacy, line-keyed state. */
+constexpr Id NONE = 0;
+
+/** EUI-64 from its 16 hex digit form (either case); nullopt otherwise. */
+std::optional<uint64_t> parse_eui(std::string_view s);
+
+/** 16 lowercase hex digits. */
+std::string eui_hex(uint64_t eui);
+
+/** Id of `eui`, assigned on first sight. Thread-safe. */
+Id intern(uint64_t eui);
+
+/** The EUI an Id was interned from; 0 for NONE. */
+uint64_t eui(Id id);
+
+/** Id of the uplink's devEUI, NONE if it has none. */
+Id of(const Uplink& up);
+
+/** Devices interned so far. */
+std::size_t count();
+
+} // namespace devices
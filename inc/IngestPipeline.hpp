@@ -0,0 +1,136 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <cstdint>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include "IngestQueue.hpp"
+#include "Shift.hpp"
+
+/**
+ * One raw MQTT message handed from the Paho callback thread to a worker.
+ * deviceType/lineID are the routing key (route_uplink(): the values the
+ * processors decode, 0 if absent), so one line's state lives on one shard.
+ * received is stamped by the callback, before any queueing delay.
+ *
+ * Kind::ShiftChange items are control items posted with post(): they carry
+ * shift_change instead of a payload, and received is the boundary instant.
+ */
+struct IngestItem {
+    enum class Kind : uint8_t { Message, ShiftChange };
+
+    std::string topic;
+    std::string payload;
+    int deviceType = 0;
+    int lineID     = 0;
+    std::chrono::system_clock::time_point received{};
+    Kind kind = Kind::Message;
+    ShiftChange shift_change{};
+};
+
+/**
+ * Pipeline configuration.
+ *  - capacity: bounded queue size per shard (rounded up to a power of two)
+ *  - workers:  number of worker shards; 0 = process inline on the caller
+ *  - overflow: what submit() does when a shard queue is full
+ */
+struct IngestOptions {
+    std::size_t    capacity = 4096;
+    unsigned       workers  = 1;
+    OverflowPolicy overflow = OverflowPolicy::Block;
+};
+
+struct IngestStats {
+    uint64_t    enqueued       = 0;
+    uint64_t    processed      = 0;
+    uint64_t    dropped_oldest = 0;
+    uint64_t    dropped_newest = 0;
+    std::size_t depth          = 0;   // sum over shards
+    std::size_t max_depth      = 0;   // deepest single shard seen
+    std::vector<std::size_t> shard_depth;
+};
+
+/**
+ * IngestPipeline: decouples the MQTT callback thread from message processing.
+ *
+ * Each worker is a shard with its own bounded lock-free queue. submit() routes
+ * an item to shard hash(deviceType, lineID) % workers, so all messages of one
+ * line are handled by the same thread, in arrival order. Processor state is
+ * thread_local, which makes every shard the sole owner of its lines' state.
+ * stop() lets the workers drain what is already queued.
+ *
+ * post() hands a control item to every shard out of band (never dropped,
+ * never blocks): a shard runs it right before the first message received at
+ * or after the item's `received` instant, or as soon as it is idle. Inline
+ * mode (workers = 0) has no idle point and runs it before the next message,
+ * however late that is; MqttApp, whose shift boundaries must fire on time,
+ * therefore never runs inline.
+ */
+class IngestPipeline {
+public:
+    using Handler = std::function<void(IngestItem&)>;
+
+    IngestPipeline(IngestOptions opts, Handler handler);
+    ~IngestPipeline();
+
+    IngestPipeline(const IngestPipeline&) = delete;
+    IngestPipeline& operator=(const IngestPipeline&) = delete;
+
+    void start();
+    void stop();
+
+    // Returns false if the item was not queued (DropNewest on a full queue,
+    // or the pipeline is stopped).
+    bool submit(IngestItem&& item);
+
+    // Run `item` once on every shard (see above). False if stopped.
+    bool post(const IngestItem& item);
+
+    IngestStats stats() const;
+    const IngestOptions& options() const { return opts_; }
+
+    static unsigned shard_for(int deviceType, int lineID, unsigned shards);
+
+private:
+    // Control items waiting for a shard, in post order.
+    struct ControlQueue {
+        std::mutex mu;
+        std::vector<IngestItem> items;
+        std::atomic<bool> pending{false};
+    };
+
+    struct Shard {
+        explicit Shard(std::size_t capacity) : queue(capacity) {}
+        BoundedMpmcQueue<IngestItem> queue;
+        alignas(CACHE_LINE) std::atomic<uint32_t> items_signal{0};
+        std::atomic<std::size_t> max_depth{0};
+        ControlQueue control;
+        std::thread thread;
+    };
+
+    IngestOptions opts_;
+    Handler handler_;
+    std::vector<std::unique_ptr<Shard>> shards_;
+    std::atomic<bool> running_{false};
+    ControlQueue inline_control_;   // workers = 0
+
+    // Wake-up counter for producers blocked on a full shard (C++20 atomic wait).
+    alignas(CACHE_LINE) std::atomic<uint32_t> space_signal_{0};
+    std::atomic<uint32_t> blocked_producers_{0};
+
+    // Counters
+    std::atomic<uint64_t> enqueued_{0};
+    std::atomic<uint64_t> processed_{0};
+    std::atomic<uint64_t> dropped_oldest_{0};
+    std::atomic<uint64_t> dropped_newest_{0};
+
+    void worker_loop(Shard& shard);
+    void run_handler(IngestItem& item);
+    void run_control(ControlQueue& cq, std::chrono::system_clock::time_point due);
+    void note_enqueued(Shard& shard);
+    void note_drop(std::atomic<uint64_t>& counter, const char* what);
+};
@@ -0,0 +1,125 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+
+/**
+ * What IngestPipeline::submit() does when the queue is full.
+ *  - Block:      the producer (Paho callback thread) waits for a free slot
+ *  - DropOldest: the oldest queued message is discarded to make room
+ *  - DropNewest: the incoming message is discarded
+ */
+enum class OverflowPolicy : int { Block = 0, DropOldest = 1, DropNewest = 2 };
+
+inline std::optional<OverflowPolicy> overflowPolicyFromString(const std::string& s) {
+    if (s == "block")       return OverflowPolicy::Block;
+    if (s == "drop-oldest") return OverflowPolicy::DropOldest;
+    if (s == "drop-newest") return OverflowPolicy::DropNewest;
+    return std::nullopt;
+}
+
+inline const char* overflowPolicyName(OverflowPolicy p) {
+    switch (p) {
+        case OverflowPolicy::Block:      return "block";
+        case OverflowPolicy::DropOldest: return "drop-oldest";
+        case OverflowPolicy::DropNewest: return "drop-newest";
+    }
+    return "unknown";
+}
+
+constexpr std::size_t CACHE_LINE = 64;
+
+/**
+ * Bounded lock-free MPMC queue (Dmitry Vyukov's sequence-per-cell ring).
+ *
+ * - Capacity is rounded up to a power of two.
+ * - try_push / try_pop never block and never allocate.
+ * - Each cell carries a sequence number; producers and consumers claim
+ *   positions with a CAS on their own cursor, so they never contend on
+ *   the same cache line except when the queue is nearly empty/full.
+ */
+template <typename T>
+class BoundedMpmcQueue {
+public:
+    explicit BoundedMpmcQueue(std::size_t capacity)
+        : mask_(round_up_pow2(capacity < 2 ? 2 : capacity) - 1)
+        , cells_(new Cell[mask_ + 1])
+    {
+        for (std::size_t i = 0; i <= mask_; ++i)
+            cells_[i].seq.store(i, std::memory_order_relaxed);
+    }
+
+    BoundedMpmcQueue(const BoundedMpmcQueue&) = delete;
+    BoundedMpmcQueue& operator=(const BoundedMpmcQueue&) = delete;
+
+    bool try_push(T&& v) {
+        Cell* cell;
+        std::size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+        for (;;) {
+            cell = &cells_[pos & mask_];
+            const std::size_t seq = cell->seq.load(std::memory_order_acquire);
+            const auto dif = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos);
+            if (dif == 0) {
+                if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            } else if (dif < 0) {
+                return false; // full
+            } else {
+                pos = enqueue_pos_.load(std::memory_order_relaxed);
+            }
+        }
+        cell->data = std::move(v);
+        cell->seq.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool try_pop(T& out) {
+        Cell* cell;
+        std::size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+        for (;;) {
+            cell = &cells_[pos & mask_];
+            const std::size_t seq = cell->seq.load(std::memory_order_acquire);
+            const auto dif = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos + 1);
+            if (dif == 0) {
+                if (dequeue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            } else if (dif < 0) {
+                return false; // empty
+            } else {
+                pos = dequeue_pos_.load(std::memory_order_relaxed);
+            }
+        }
+        out = std::move(cell->data);
+        cell->seq.store(pos + mask_ + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Approximate: exact only when no push/pop is in flight.
+    std::size_t size_approx() const {
+        const std::size_t e = enqueue_pos_.load(std::memory_order_relaxed);
+        const std::size_t d = dequeue_pos_.load(std::memory_order_relaxed);
+        return e > d ? e - d : 0;
+    }
+
+    std::size_t capacity() const { return mask_ + 1; }
+
+private:
+    struct Cell {
+        std::atomic<std::size_t> seq;
+        T data;
+    };
+
+    static std::size_t round_up_pow2(std::size_t v) {
+        std::size_t p = 1;
+        while (p < v) p <<= 1;
+        return p;
+    }
+
+    const std::size_t mask_;
+    std::unique_ptr<Cell[]> cells_;
+    alignas(CACHE_LINE) std::atomic<std::size_t> enqueue_pos_{0};
+    alignas(CACHE_LINE) std::atomic<std::size_t> dequeue_pos_{0};
+};
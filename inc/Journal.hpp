@@ -0,0 +1,119 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+
+/**
+ * Journal configuration.
+ *  - dir:           directory for the segment files; empty = journal disabled
+ *  - segment_bytes: roll to a new segment file past this size
+ *  - flush_ms:      longest a record waits in memory before write + fsync
+ *  - max_bytes:     retention: oldest segments deleted past this total; 0 = no limit
+ *  - max_age_h:     retention: segments whose last record is older are deleted; 0 = no limit
+ */
+struct JournalOptions {
+    std::string dir;
+    std::size_t segment_bytes = 64u << 20;
+    unsigned    flush_ms      = 200;
+    std::size_t max_bytes     = std::size_t{1} << 30;
+    unsigned    max_age_h     = 168;
+};
+
+struct JournalStats {
+    uint64_t records    = 0;
+    uint64_t blocks     = 0;
+    uint64_t raw_bytes  = 0;
+    uint64_t disk_bytes = 0;
+    uint64_t errors     = 0;
+    uint64_t dropped    = 0;   // records refused while the batch was full
+    uint64_t pruned     = 0;   // segments deleted by retention
+};
+
+/**
+ * Journal: append-only, segmented, compressed record of raw celima/data
+ * uplinks with their receive time, for recovery and offline replay.
+ *
+ * append() only copies the record into an in-memory batch (mutex, no I/O),
+ * so it is safe on the MQTT callback thread. A flusher thread swaps the
+ * batch out every flush_ms (or sooner when it grows large), deflates it into
+ * one block, writes it and fsyncs: one syscall pair per batch, not per
+ * message. While the flusher is stuck on a slow or failing disk the batch
+ * stops at a hard cap and further records are dropped (and counted). Records acknowledged by the broker but not yet flushed are lost
+ * on a crash; everything up to the last complete block survives.
+ *
+ * Segment files are <dir>/journal-<unix ms>-<seq>.wal; a new one is started
+ * at every open and when the current one passes segment_bytes. Each time
+ * one is started, the oldest other segments are deleted while all of them
+ * together exceed max_bytes or their last record (the next segment's start)
+ * is older than max_age_h, so replay covers that window at most. Each block is
+ *
+ *   "CJB1"  u32 raw_len  u32 comp_len  u32 crc32(comp)  u32 records  comp[comp_len]
+ *
+ * and the deflated body holds the records back to back as
+ *
+ *   i64 received_us  u32 len  payload[len]
+ *
+ * (native endianness). A torn or corrupt block ends its segment.
+ */
+class Journal {
+public:
+    explicit Journal(JournalOptions opts);
+    ~Journal();
+
+    Journal(const Journal&) = delete;
+    Journal& operator=(const Journal&) = delete;
+
+    /** Create the directory and the first segment, start the flusher. */
+    bool start(std::string& err);
+    /** Flush what is buffered and stop. */
+    void stop();
+
+    void append(std::chrono::system_clock::time_point received, std::string_view payload);
+
+    JournalStats stats() const;
+
+    using Visitor = std::function<void(std::chrono::system_clock::time_point received,
+                                       std::string_view payload)>;
+
+    /**
+     * Feed every record under `dir` to `visit`, oldest segment first.
+     * Returns false (with `err`) if the directory cannot be read; damaged
+     * blocks are skipped with a warning.
+     */
+    static bool read(const std::string& dir, const Visitor& visit, std::string& err);
+
+private:
+    JournalOptions opts_;
+
+    std::mutex mu_;
+    std::condition_variable cv_;
+    std::string batch_;          // encoded records not yet flushed
+    uint32_t    batch_records_ = 0;
+    bool        running_ = false;
+    std::thread thread_;
+
+    // Flusher-owned
+    int         fd_ = -1;
+    std::string segment_path_;
+    std::size_t segment_size_ = 0;
+    uint32_t    segment_seq_ = 0;
+
+    std::atomic<uint64_t> records_{0};
+    std::atomic<uint64_t> blocks_{0};
+    std::atomic<uint64_t> raw_bytes_{0};
+    std::atomic<uint64_t> disk_bytes_{0};
+    std::atomic<uint64_t> errors_{0};
+    std::atomic<uint64_t> dropped_{0};
+    std::atomic<uint64_t> pruned_{0};
+
+    void run();
+    bool open_segment(std::string& err);
+    void prune();
+    void write_block(const std::string& raw, uint32_t records);
+};
@@ -1,19 +1,118 @@
 #pragma once
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
 #include <string>
 #include <optional>
+#include <string_view>
+#include <vector>
 #include <nlohmann/json.hpp>
+#include "JsonWriter.hpp"
 
 namespace jsonu {
 
 using json = nlohmann::json;
 
-std::optional<json> parse(const std::string& s, std::string& err);
+/**
+ * Per-thread monotonic arena for the DOM path (DefaultProcessor).
+ *
+ * nlohmann::json allocates every object, array and string separately;
+ * building and dropping a few DOMs per message through the global
+ * allocator fragments the heap of a long-running process. arena_json
+ * takes those nodes from the calling thread's Arena instead: allocation
+ * is a pointer bump, deallocation a no-op, and the memory is rewound in
+ * one step when the outermost ArenaScope on the thread ends. Blocks are
+ * kept across messages, so a steady message mix stops allocating.
+ *
+ * Outside any ArenaScope the allocator falls back to the global heap, so
+ * arena_json stays usable (just not pooled) anywhere. An arena_json built
+ * inside a scope must be destroyed before the scope ends and must not
+ * leave its thread.
+ */
+class Arena {
+public:
+    static constexpr std::size_t BLOCK = 64 * 1024;
 
+    /** The calling thread's arena. */
+    static Arena& local();
+
+    void* allocate(std::size_t n, std::size_t align);
+    void deallocate(void* p) noexcept;
+
+    /** Bytes held in blocks (the thread's high-water mark, oversized blocks excepted). */
+    std::size_t capacity() const;
+
+private:
+    friend class ArenaScope;
+
+    struct Block {
+        std::unique_ptr<std::byte[]> mem;
+        std::size_t size = 0;
+    };
+    std::vector<Block> blocks_;
+    std::size_t cur_ = 0;    // block being filled
+    std::size_t used_ = 0;   // bytes used in blocks_[cur_]
+    int depth_ = 0;          // open ArenaScopes
+
+    bool owns(const void* p) const noexcept;
+    void reset();
+};
+
+/** Marks one message's DOM work; the outermost scope rewinds the arena when it ends. */
+class ArenaScope {
+public:
+    ArenaScope() : arena_(Arena::local()) { ++arena_.depth_; }
+    ~ArenaScope() {
+        if (--arena_.depth_ == 0) arena_.reset();
+    }
+    ArenaScope(const ArenaScope&) = delete;
+    ArenaScope& operator=(const ArenaScope&) = delete;
+
+private:
+    Arena& arena_;
+};
+
+/** Stateless allocator over Arena::local(), for arena_json. */
 template <typename T>
-std::optional<T> get_opt(const json& j, const char* key) {
+struct ArenaAllocator {
+    using value_type = T;
+
+    ArenaAllocator() noexcept = default;
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U>&) noexcept {}
+
+    T* allocate(std::size_t n) {
+        return static_cast<T*>(Arena::local().allocate(n * sizeof(T), alignof(T)));
+    }
+    void deallocate(T* p, std::size_t) noexcept { Arena::local().deallocate(p); }
+
+    template <typename U>
+    bool operator==(const ArenaAllocator<U>&) const noexcept { return true; }
+    template <typename U>
+    bool operator!=(const ArenaAllocator<U>&) const noexcept { return false; }
+};
+
+using arena_string = std::basic_string<char, std::char_traits<char>, ArenaAllocator<char>>;
+
+/** nlohmann::json with its objects, arrays and strings in the thread's Arena. */
+using arena_json = nlohmann::basic_json<std::map, std::vector, arena_string, bool, std::int64_t,
+                                        std::uint64_t, double, ArenaAllocator>;
+
+/** Parse into an arena_json; open an ArenaScope around it and its use to pool the nodes. */
+std::optional<arena_json> parse(std::string_view s, std::string& err);
+
+/**
+ * Append `j` as compact JSON, byte-identical to j.dump(), without dump()'s
+ * per-call buffers (it allocates an indent string and an output adapter).
+ */
+void write(jsonw::Writer& w, const arena_json& j);
+
+template <typename T, typename Json>
+std::optional<T> get_opt(const Json& j, const char* key) {
     if (!j.contains(key)) return std::nullopt;
     try {
-        return j.at(key).get<T>();
+        return j.at(key).template get<T>();
     } catch (...) {
         return std::nullopt;
     }
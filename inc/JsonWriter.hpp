@@ -0,0 +1,120 @@
+#pragma once
+#include <charconv>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+
+/**
+ * jsonw: direct-to-buffer JSON serialization for fixed output schemas.
+ *
+ * A schema is a compile-time list of (key, member pointer) pairs over a
+ * plain struct whose members are named after their JSON keys:
+ *
+ *   struct Out { int alarms; std::string ts; };
+ *   constexpr auto OUT_SCHEMA = jsonw::schema(JSONW_FIELD(Out, alarms),
+ *                                             JSONW_FIELD(Out, ts));
+ *   static_assert(OUT_SCHEMA.valid());
+ *
+ * Output is byte-identical to nlohmann::json::dump() of the same object:
+ * compact, keys in std::map (byte) order, integers in decimal, doubles in
+ * nlohmann's shortest round-trip format, strings escaped the same way.
+ * valid() checks the key order at compile time, so a schema cannot drift
+ * from what dump() would have produced.
+ */
+namespace jsonw {
+
+/** Appends JSON tokens to a caller-owned buffer. */
+class Writer {
+public:
+    explicit Writer(std::string& out) : out_(out) {}
+
+    void raw(char c) { out_.push_back(c); }
+    void raw(std::string_view s) { out_.append(s.data(), s.size()); }
+
+    void value(bool b) { raw(b ? std::string_view("true") : std::string_view("false")); }
+    void value(double v);                // non-finite values are written as null
+    void value(std::string_view s);      // s must be valid UTF-8
+    void value(const std::string& s) { value(std::string_view(s)); }
+    void value(const char* s) { value(std::string_view(s)); }
+
+    template <typename T,
+              typename = std::enable_if_t<std::is_integral_v<T> && !std::is_same_v<T, bool>>>
+    void value(T v) {
+        char tmp[24];
+        auto r = std::to_chars(tmp, tmp + sizeof(tmp), v);
+        out_.append(tmp, static_cast<std::size_t>(r.ptr - tmp));
+    }
+
+private:
+    std::string& out_;
+};
+
+template <typename T, typename M>
+struct Member {
+    std::string_view key;
+    M T::*ptr;
+};
+
+template <typename T, typename... Ms>
+struct Schema {
+    static_assert(sizeof...(Ms) > 0, "empty schema");
+
+    std::tuple<Member<T, Ms>...> members;
+
+    /** Keys strictly increasing in byte order, none needing escapes. */
+    constexpr bool valid() const {
+        return std::apply([](const auto&... m) {
+            const std::string_view keys[] = {m.key...};
+            for (std::size_t i = 0; i < sizeof...(Ms); ++i) {
+                for (char c : keys[i])
+                    if (static_cast<unsigned char>(c) < 0x20 || c == '"' || c == '\\')
+                        return false;
+                if (i > 0 && !(keys[i - 1] < keys[i]))
+                    return false;
+            }
+            return true;
+        }, members);
+    }
+};
+
+template <typename T, typename... Ms>
+constexpr Schema<T, Ms...> schema(Member<T, Ms>... m) {
+    return Schema<T, Ms...>{{m...}};
+}
+
+#define JSONW_FIELD(T, name) ::jsonw::Member<T, decltype(T::name)>{#name, &T::name}
+
+template <typename T, typename... Ms>
+void write(Writer& w, const T& obj, const Schema<T, Ms...>& s) {
+    w.raw('{');
+    std::apply([&](const auto&... m) {
+        bool first = true;
+        ((w.raw(first ? std::string_view("\"") : std::string_view(",\"")),
+          first = false,
+          w.raw(m.key), w.raw(std::string_view("\":")),
+          w.value(obj.*(m.ptr))), ...);
+    }, s.members);
+    w.raw('}');
+}
+
+namespace detail {
+std::string& scratch();
+} // namespace detail
+
+/**
+ * Serialize into the calling thread's reusable scratch buffer (preallocated,
+ * never shrunk). The view stays valid until the next serialize() on the
+ * same thread.
+ */
+template <typename T, typename... Ms>
+std::string_view serialize(const T& obj, const Schema<T, Ms...>& s) {
+    std::string& buf = detail::scratch();
+    buf.clear();
+    Writer w(buf);
+    write(w, obj, s);
+    return buf;
+}
+
+} // namespace jsonw
@@ -0,0 +1,120 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+/**
+ * Flat table of per-line values keyed by lineID: the storage behind the
+ * processors' line state (LineStates in MessageProcessor.cpp).
+ *
+ * lineIDs are small dense integers, so ids 0..DIRECT-1 index a flat array
+ * directly (grown on demand). Any other id goes to an open-addressing table
+ * with linear probing, kept at most half full. There is no per-line node
+ * allocation and no pointer chasing on lookup.
+ *
+ * Every slot is aligned to its own cache line(s): two lines never share
+ * one, so lines handled by different shards on different cores cannot
+ * false-share, whatever the allocator puts next to each other.
+ *
+ * Not thread-safe; one table per shard. Pointers returned by try_emplace /
+ * find stay valid until the next insertion of a new key or clear().
+ */
+template <typename T>
+class LineTable {
+public:
+    static constexpr int DIRECT = 64;
+
+    /** Value of `key`, value-initialized if new; `second` is true if inserted. */
+    std::pair<T*, bool> try_emplace(int key)
+    {
+        if (key >= 0 && key < DIRECT) {
+            const auto i = static_cast<std::size_t>(key);
+            if (i >= direct_.size())
+                direct_.resize(std::min<std::size_t>(DIRECT, std::max(i + 1, direct_.size() * 2)));
+            return claim(direct_[i], key);
+        }
+        if (sparse_used_ + 1 > sparse_.size() / 2) grow();
+        return claim(probe(sparse_, key), key);
+    }
+
+    /** Value of `key`, or nullptr. */
+    T* find(int key)
+    {
+        Slot* s = nullptr;
+        if (key >= 0 && key < DIRECT) {
+            if (static_cast<std::size_t>(key) < direct_.size()) s = &direct_[static_cast<std::size_t>(key)];
+        } else if (!sparse_.empty()) {
+            s = &probe(sparse_, key);
+        }
+        return s && s->used ? &s->value : nullptr;
+    }
+
+    /** f(int key, T& value) for every line, in no particular order. */
+    template <typename F>
+    void for_each(F&& f)
+    {
+        for (Slot& s : direct_)
+            if (s.used) f(s.key, s.value);
+        for (Slot& s : sparse_)
+            if (s.used) f(s.key, s.value);
+    }
+
+    std::size_t size() const { return size_; }
+
+    void clear()
+    {
+        direct_.clear();
+        sparse_.clear();
+        sparse_used_ = 0;
+        size_ = 0;
+    }
+
+private:
+    struct alignas(64) Slot {
+        T    value{};
+        int  key  = 0;
+        bool used = false;
+    };
+
+    static std::size_t hash(int key)
+    {
+        uint32_t h = static_cast<uint32_t>(key) * 2654435769u;   // Fibonacci hashing
+        return h ^ (h >> 16);
+    }
+
+    // The slot holding `key`, or the empty slot where it belongs.
+    static Slot& probe(std::vector<Slot>& slots, int key)
+    {
+        const std::size_t mask = slots.size() - 1;
+        for (std::size_t i = hash(key) & mask;; i = (i + 1) & mask)
+            if (!slots[i].used || slots[i].key == key) return slots[i];
+    }
+
+    std::pair<T*, bool> claim(Slot& s, int key)
+    {
+        if (s.used) return {&s.value, false};
+        s.used = true;
+        s.key  = key;
+        ++size_;
+        if (key < 0 || key >= DIRECT) ++sparse_used_;
+        return {&s.value, true};
+    }
+
+    void grow()
+    {
+        std::vector<Slot> next(sparse_.empty() ? 8 : sparse_.size() * 2);
+        for (Slot& s : sparse_) {
+            if (!s.used) continue;
+            Slot& d = probe(next, s.key);
+            d = std::move(s);
+        }
+        sparse_.swap(next);
+    }
+
+    std::vector<Slot> direct_;
+    std::vector<Slot> sparse_;    // power-of-two size
+    std::size_t sparse_used_ = 0;
+    std::size_t size_ = 0;
+};
@@ -0,0 +1,125 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <charconv>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+/**
+ * logx: asynchronous, leveled, rate-limited logger.
+ *
+ * - LOG_INFO(MQTT) << "Connected to " << uri;   (stream-like, no allocation)
+ * - Disabled levels cost one relaxed load: the line is never formatted.
+ * - Lines are formatted into a fixed record and pushed to a lock-free ring
+ *   buffer; a background thread writes them out (Warn/Error to stderr, the
+ *   rest to stdout) and flushes once per batch. When the ring is full the
+ *   line is dropped and counted, so a stalled stdout never blocks callers.
+ * - Each category has a per-second line budget; excess lines are counted
+ *   and reported as "suppressed" once the next window opens.
+ *
+ * Env (read by init_from_env):
+ *  - LOG_LEVEL       e.g. "info" or "info,data=debug,pub=warn" (default info)
+ *                    levels: debug | info | warn | error | off
+ *                    categories: mqtt, ingest, data, pub, shift, proc
+ *  - LOG_RATE_LIMIT  max lines per second per category, 0 = unlimited (default 100)
+ *
+ * Before init_from_env() (or after shutdown()) lines are written
+ * synchronously, so tools and benchmarks can log without a drain thread.
+ */
+namespace logx {
+
+enum class Level : int { Debug = 0, Info = 1, Warn = 2, Error = 3, Off = 4 };
+
+enum class Cat : int {
+    MQTT = 0,   // connection lifecycle, subscribe/publish errors
+    Ingest,     // ingest pipeline
+    Data,       // celima/* payloads
+    Pub,        // ISA-95 publications and delivery acks
+    Shift,      // shift changes and resets
+    Proc,       // device processors
+    COUNT
+};
+
+constexpr std::size_t LOG_LINE_MAX = 1024;
+
+struct Stats {
+    uint64_t written         = 0;
+    uint64_t dropped_full    = 0;  // ring buffer full
+    uint64_t suppressed_rate = 0;  // over the per-category rate limit
+};
+
+void init_from_env();
+void shutdown();
+
+void set_level(Cat c, Level lv);
+void set_level(Level lv);          // all categories
+void set_rate_limit(uint32_t lines_per_s);
+
+// Level check + rate limit. Call before formatting (the macros do).
+bool should_log(Level lv, Cat c);
+
+Stats stats();
+
+const char* levelName(Level lv);
+const char* catName(Cat c);
+
+namespace detail {
+struct Record {
+    Level lv = Level::Info;
+    uint16_t len = 0;
+    char text[LOG_LINE_MAX];
+};
+void commit(Record& rec);
+} // namespace detail
+
+/**
+ * One log line. Formats into an inline record and commits on destruction.
+ * Lines longer than LOG_LINE_MAX are truncated with "...".
+ */
+class Line {
+public:
+    Line(Level lv, Cat) { rec_.lv = lv; }
+    ~Line();
+
+    Line(const Line&) = delete;
+    Line& operator=(const Line&) = delete;
+
+    Line& operator<<(std::string_view s) { append(s.data(), s.size()); return *this; }
+    Line& operator<<(const std::string& s) { append(s.data(), s.size()); return *this; }
+    Line& operator<<(const char* s) { return *this << std::string_view(s ? s : "(null)"); }
+    Line& operator<<(char c) { append(&c, 1); return *this; }
+    Line& operator<<(bool b) { return *this << (b ? "true" : "false"); }
+    Line& operator<<(double v) { return num(v); }
+
+    template <typename T,
+              typename = std::enable_if_t<std::is_integral_v<T> && !std::is_same_v<T, bool> &&
+                                          !std::is_same_v<T, char>>>
+    Line& operator<<(T v) { return num(v); }
+
+private:
+    detail::Record rec_;
+    bool truncated_ = false;
+
+    void append(const char* p, std::size_t n);
+
+    template <typename T>
+    Line& num(T v) {
+        char tmp[32];
+        auto r = std::to_chars(tmp, tmp + sizeof(tmp), v);
+        append(tmp, static_cast<std::size_t>(r.ptr - tmp));
+        return *this;
+    }
+};
+
+} // namespace logx
+
+#define LOGX(lv, cat)                                                        \
+    if (!::logx::should_log(::logx::Level::lv, ::logx::Cat::cat)) {          \
+    } else                                                                   \
+        ::logx::Line(::logx::Level::lv, ::logx::Cat::cat)
+
+#define LOG_DEBUG(cat) LOGX(Debug, cat)
+#define LOG_INFO(cat)  LOGX(Info, cat)
+#define LOG_WARN(cat)  LOGX(Warn, cat)
+#define LOG_ERROR(cat) LOGX(Error, cat)
@@ -3,8 +3,20 @@
 #include <vector>
 #include <utility>
 #include <optional>
+#include <array>
+#include <memory>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string_view>
 #include <nlohmann/json.hpp>
+#include "DataQuality.hpp"
 #include "DeviceTypes.hpp"
+#include "Metrics.hpp"
+#include "PublicationSink.hpp"
+#include "Shift.hpp"
+#include "TimeUtils.hpp"
+#include "Uplink.hpp"
 
 const int L1_PIEZAS_PISADA = 3;
 const int L2_PIEZAS_PISADA = 3;
@@ -12,19 +24,36 @@ const int L3_PIEZAS_PISADA = 2;
 const int L4_PIEZAS_PISADA = 4;
 const int L5_PIEZAS_PISADA = 2;
 /**
- * Each processor returns a set of (topic, payload) publications.
- * All publications are QoS 1 (the app enforces it).
+ * Per-message time context, computed once when a message is picked up and
+ * shared by shift detection and every publication it produces.
+ *  - received: when the MQTT callback got the message
+ *  - shift:       1-based number of the shift `received` falls in
+ *  - shift_start: when that shift started (tells today's shift 1 from yesterday's)
+ *  - ts:          `received` formatted as ISO-8601 UTC
  */
-struct Publication {
-    std::string topic;
-    std::string payload; // JSON string
+struct MessageContext {
+    std::chrono::system_clock::time_point received;
+    int shift = 0;
+    std::time_t shift_start = 0;
+    IsoTimestamp ts;
 };
 
+/** Context for a message of `line`, received at `received` (shift from the line's schedule). */
+MessageContext make_message_context(std::chrono::system_clock::time_point received, int line);
+
+/**
+ * Processors read the flat, pre-decoded Uplink (see decode_uplink); only
+ * DefaultProcessor falls back to building a DOM from msg.raw. Time and
+ * shift come from ctx, never from the clock. Each processor appends its
+ * (topic, payload) publications to `out`, which the caller owns and clears.
+ */
 class IMessageProcessor {
 public:
     virtual ~IMessageProcessor() = default;
-    virtual std::vector<Publication> process(const nlohmann::json& msg,
-                                             const std::string& isa95_prefix) = 0;
+    virtual void process(const Uplink& msg,
+                         const MessageContext& ctx,
+                         const std::string& isa95_prefix,
+                         PublicationSink& out) = 0;
 };
 
 /**
@@ -38,26 +67,98 @@ std::unique_ptr<IMessageProcessor> createProcessor(DeviceType dt);
  */
 std::unique_ptr<IMessageProcessor> createDefaultProcessor();
 
-bool detect_global_shift_change(int currentShift);
-void reset_all_processor_states();
+/**
+ * Dispatch table of long-lived processors indexed by DeviceType.
+ * Built once at startup; get() is a bounds check and an array load, with no
+ * allocation. Processors keep their accumulators in static (per-shard) state,
+ * so one shared instance per type is enough. Unknown types map to the
+ * DefaultProcessor.
+ */
+class ProcessorTable {
+public:
+    ProcessorTable();
+
+    IMessageProcessor& get(int deviceType) const {
+        if (deviceType > 0 && deviceType < static_cast<int>(procs_.size()))
+            return *procs_[deviceType];
+        return *procs_[0];
+    }
+
+private:
+    // [0] = default, [1..8] = DeviceType values
+    std::array<std::unique_ptr<IMessageProcessor>, 9> procs_;
+};
+
+/** Final shift accumulators of one device type on one line, as a JSON object. */
+struct DeviceSnapshot {
+    int line = 0;
+    std::string_view device;   // topic segment, e.g. "prensa_hidraulica1"
+    std::string json;
+};
+
+/**
+ * Close a shift on the calling worker shard: every line the boundary applies
+ * to (ev.line, or every line without an override when ev.line = -1) that
+ * still holds state from before it has that state swapped out and returned
+ * as snapshots. A device a message already rolled over to ev.opened_shift
+ * keeps its new state; the closed shift's state it parked on rollover is
+ * what gets reported. Runs on the worker that owns the shard, like process().
+ */
+std::vector<DeviceSnapshot> close_shift(const ShiftChange& ev);
+
+/**
+ * Merges the close_shift() snapshots of all worker shards (a line's devices
+ * can live on different shards) into one <prefix><line>/shift_summary per line:
+ *
+ *   {"closed_at":"...","devices":{"<device>":{"acc_...":...},...},
+ *    "lineID":3,"next_turno":2,"turno":1}
+ *
+ * add() is called once per shard and boundary; the last shard to report
+ * appends the publications to `out`, the others append nothing.
+ */
+class ShiftSummaryCollector {
+public:
+    explicit ShiftSummaryCollector(unsigned shards);
+
+    void add(const ShiftChange& ev, std::vector<DeviceSnapshot> snaps, const std::string& isa95_prefix,
+             PublicationSink& out);
+
+private:
+    struct Pending {
+        unsigned reported = 0;
+        std::vector<DeviceSnapshot> snaps;
+    };
+
+    const unsigned shards_;
+    std::mutex mu_;
+    std::map<std::pair<std::time_t, int>, Pending> pending_;   // by (ev.at, ev.line)
+};
 
 // Delta seguro para contadores de 16 bits provenientes de PLCs
 // Evita saltos absurdos (> max_reasonable), corrige rollover, descarta ruido.
-inline uint32_t safe_delta_u16(uint16_t prev, uint16_t curr, int max_reasonable = 200)
+// Con `quality`, cada resultado se cuenta en los contadores dq de la línea.
+inline uint32_t safe_delta_u16(uint16_t prev, uint16_t curr, int max_reasonable = 200,
+                               dq::FieldCounters* quality = nullptr)
 {
     int delta = static_cast<int>(curr) - static_cast<int>(prev);
 
     // Caso normal pequeño
-    if (delta >= 0 && delta <= max_reasonable)
+    if (delta >= 0 && delta <= max_reasonable) {
+        dq::count(quality, delta == 0 ? dq::Delta::Zero : dq::Delta::Counted);
         return static_cast<uint32_t>(delta);
+    }
 
     // Caso rollover
     if (delta < 0) {
         int rolled = delta + 65536;
-        if (rolled >= 0 && rolled <= max_reasonable)
+        if (rolled >= 0 && rolled <= max_reasonable) {
+            dq::count(quality, dq::Delta::Rollover);
             return static_cast<uint32_t>(rolled);
+        }
     }
 
     // Salto anómalo → ruido → ignorar
+    metrics::registry().safe_delta_rejected.add();
+    dq::count(quality, dq::Delta::Rejected);
     return 0;
 }
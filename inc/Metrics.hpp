@@ -0,0 +1,164 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <nlohmann/json.hpp>
+
+namespace metrics {
+
+/** Monotonic event counter; add() is a relaxed atomic increment. */
+class Counter {
+public:
+    void add(uint64_t n = 1) { v_.fetch_add(n, std::memory_order_relaxed); }
+    uint64_t value() const { return v_.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint64_t> v_{0};
+};
+
+/**
+ * Latency histogram with HDR-style log-linear buckets: 16 linear
+ * sub-buckets per power of two, so any value is reported within 1/16
+ * (6.25%) of its true value, from 1 ns up to ~9 minutes (larger values land
+ * in the last bucket). record() is two relaxed atomic adds, no lock, and
+ * may run concurrently on every worker.
+ */
+class Histogram {
+public:
+    static constexpr unsigned SUB_BITS = 4;
+    static constexpr unsigned SUB      = 1u << SUB_BITS;
+    static constexpr unsigned MAX_MSB  = 38;                        // 2^39 ns ~ 9 min
+    static constexpr unsigned BUCKETS  = (MAX_MSB - SUB_BITS + 2) * SUB;
+
+    /** Bucket counts and sum at one instant; subtract two to get an interval. */
+    struct Snapshot {
+        std::array<uint64_t, BUCKETS> buckets{};
+        uint64_t count = 0;
+        uint64_t sum   = 0;   // ns
+
+        Snapshot operator-(const Snapshot& older) const;
+        /** Upper bound of the bucket holding quantile q (0..1); 0 if empty. */
+        uint64_t quantile(double q) const;
+        /** Upper bound of the highest non-empty bucket; 0 if empty. */
+        uint64_t max() const;
+    };
+
+    void record(uint64_t ns) {
+        buckets_[index(ns)].fetch_add(1, std::memory_order_relaxed);
+        sum_.fetch_add(ns, std::memory_order_relaxed);
+    }
+    void record(std::chrono::steady_clock::duration d) {
+        record(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(d).count()));
+    }
+
+    Snapshot snapshot() const;
+
+    static unsigned index(uint64_t v);
+    static uint64_t upper_bound(unsigned idx);
+
+private:
+    std::array<std::atomic<uint64_t>, BUCKETS> buckets_{};
+    std::atomic<uint64_t> sum_{0};
+};
+
+/** Records the time from construction to destruction into a histogram. */
+class Timer {
+public:
+    explicit Timer(Histogram& h) : h_(h), t0_(std::chrono::steady_clock::now()) {}
+    ~Timer() { h_.record(std::chrono::steady_clock::now() - t0_); }
+
+    Timer(const Timer&) = delete;
+    Timer& operator=(const Timer&) = delete;
+
+private:
+    Histogram& h_;
+    std::chrono::steady_clock::time_point t0_;
+};
+
+/**
+ * Process-wide pipeline metrics, updated from any thread.
+ *  - parse:     celima/data payload -> Uplink (decode_uplink)
+ *  - process:   processor run per DeviceType, serialization included;
+ *               [0] = unknown device types, [1..8] = DeviceType
+ *  - serialize: one publication payload
+ *  - publish:   handing one publication to the spool or the client,
+ *               including any wait for a publish window slot
+ */
+struct Registry {
+    Counter messages;              // celima/data uplinks handled
+    Counter invalid_json;
+    Counter bit15_corruption;      // counter fields with bit 15 set
+    Counter safe_delta_rejected;   // counter deltas dropped as implausible jumps
+    Histogram parse;
+    std::array<Histogram, 9> process;
+    Histogram serialize;
+    Histogram publish;
+};
+
+Registry& registry();
+
+/** Slot of `deviceType` in Registry::process. */
+inline Histogram& process_histogram(int deviceType) {
+    auto& p = registry().process;
+    return p[deviceType > 0 && deviceType < static_cast<int>(p.size()) ? deviceType : 0];
+}
+
+/**
+ * Periodic metrics report (interval_s = 0: no report).
+ */
+struct ReporterOptions {
+    unsigned interval_s = 60;
+};
+
+/**
+ * Reporter: every interval_s renders the registry as one JSON document and
+ * hands it to the sink (on its own thread). Counters are totals since
+ * start; histograms report the interval since the previous report:
+ *
+ *   {"counters":{...},"latency_ns":{"parse":{"count":..,"max":..,"p50":..,
+ *    "p90":..,"p99":..},"process":{"PH_1":{..},..},..},"ts":"..",...}
+ *
+ * `extend` may add further sections (e.g. pipeline and publish stats) to
+ * the document before it is serialized.
+ */
+class Reporter {
+public:
+    using Extend = std::function<void(nlohmann::json&)>;
+    using Sink   = std::function<void(const std::string& payload)>;
+
+    Reporter(ReporterOptions opts, Extend extend, Sink sink);
+    ~Reporter();
+
+    Reporter(const Reporter&) = delete;
+    Reporter& operator=(const Reporter&) = delete;
+
+    void start();
+    void stop();
+
+    /** Render a report now (advances the histogram interval). */
+    std::string render();
+
+private:
+    ReporterOptions opts_;
+    Extend extend_;
+    Sink sink_;
+
+    std::mutex mu_;
+    std::condition_variable cv_;
+    bool running_ = false;
+    std::thread thread_;
+
+    std::mutex render_mu_;
+    Histogram::Snapshot prev_parse_, prev_serialize_, prev_publish_;
+    std::array<Histogram::Snapshot, 9> prev_process_;
+
+    void run();
+};
+
+} // namespace metrics
@@ -1,9 +1,19 @@
 #pragma once
 #include <string>
+#include <string_view>
 #include <vector>
 #include <memory>
 #include <atomic>
+#include <chrono>
 #include <mqtt/async_client.h>
+#include "IngestPipeline.hpp"
+#include "Journal.hpp"
+#include "MessageProcessor.hpp"
+#include "Metrics.hpp"
+#include "PublishCoalescer.hpp"
+#include "PublishSpool.hpp"
+#include "PublishWindow.hpp"
+#include "ShiftScheduler.hpp"
 
 /**
  * MqttApp: wraps Paho C++ async_client and routes messages.
@@ -12,10 +22,42 @@
  *  - MQTT_BROKER (e.g. tcp://localhost:1883)
  *  - MQTT_CLIENT_ID (default: celima-integration-<pid>)
  *  - ISA95_PREFIX (default: enterprise/site/area/line1)
+ *  - INGEST_QUEUE_CAPACITY, INGEST_WORKERS, INGEST_OVERFLOW (see IngestOptions)
+ *  - SHIFT_BOUNDARIES, SHIFT_HOLIDAYS, SHIFT_LINE_OVERRIDES (see ShiftConfig)
+ *  - STATE_FILE, STATE_SLOTS (see StateStore.hpp)
+ *  - JOURNAL_DIR, JOURNAL_SEGMENT_MB, JOURNAL_FLUSH_MS (see JournalOptions)
+ *  - PUBLISH_COALESCE_MS, PUBLISH_COALESCE_MAX_DIRTY, PUBLISH_ALARM_MAX_STALE_S (see CoalesceOptions)
+ *  - PUBLISH_MAX_INFLIGHT, PUBLISH_MAX_BUFFERED, PUBLISH_BLOCK_MS (see PublishOptions)
+ *  - SPOOL_DIR, SPOOL_MAX_MB, SPOOL_DRAIN_RATE (see SpoolOptions)
+ *  - METRICS_INTERVAL_S (see metrics::ReporterOptions)
+ *
+ * message_arrived() journals celima/data payloads (when enabled) and enqueues them, routed by
+ * (deviceType, lineID); JSON parsing, processor dispatch and publishing run
+ * on the IngestPipeline worker shards. The ShiftScheduler posts each shift
+ * boundary to every shard; each one swaps out the closed state of its lines,
+ * and the last to finish publishes one shift_summary per line.
+ * With coalescing on, processor output goes through a PublishCoalescer;
+ * shift summaries are always published directly.
+ *
+ * Every QoS 1 publish takes a PublishWindow slot, returned by
+ * delivery_complete() or on_failure(); while Paho holds max_inflight +
+ * max_buffered of them (e.g. during a broker outage, when Paho buffers)
+ * publishers wait, throttling the pipeline.
+ *
+ * With a PublishSpool, publications made while disconnected go to disk
+ * instead of Paho's buffer and are replayed, paced, after reconnecting.
+ *
+ * Every METRICS_INTERVAL_S a metrics::Reporter publishes the stage
+ * latencies and counters, plus the ingest, coalesce, publish and spool
+ * stats, to <ISA95_PREFIX>_meta/metrics, and the per-line delta counters
+ * (see DataQuality.hpp) to <ISA95_PREFIX>_meta/data_quality.
  */
 class MqttApp : public virtual mqtt::callback, public virtual mqtt::iaction_listener {
 public:
-    MqttApp(std::string broker_uri, std::string client_id, std::string isa95_prefix);
+    MqttApp(std::string broker_uri, std::string client_id, std::string isa95_prefix,
+            IngestOptions ingest = {}, JournalOptions journal = {},
+            CoalesceOptions coalesce = {}, PublishOptions publish = {}, SpoolOptions spool = {},
+            metrics::ReporterOptions metrics = {});
     ~MqttApp();
 
     void start();
@@ -31,15 +73,35 @@ public:
     void on_success(const mqtt::token& tok) override;
     void on_failure(const mqtt::token& tok) override;
 
+    IngestStats ingest_stats() const { return pipeline_.stats(); }
+    PublishStats publish_stats() const { return window_.stats(); }
+    SpoolStats spool_stats() const { return spool_ ? spool_->stats() : SpoolStats{}; }
+
 private:
     std::string broker_;
     std::string client_id_;
     std::string isa95_prefix_;
+    PublishWindow window_;
     mqtt::async_client cli_;
     mqtt::connect_options connopts_;
     std::atomic<bool> running_{false};
+    ProcessorTable processors_;
+    IngestPipeline pipeline_;
+    std::unique_ptr<Journal> journal_;   // null when JOURNAL_DIR is unset
+    std::unique_ptr<PublishCoalescer> coalescer_;   // null when PUBLISH_COALESCE_MS is 0
+    std::unique_ptr<PublishSpool> spool_;           // null when SPOOL_DIR is unset
+    ShiftSummaryCollector summaries_;
+    ShiftScheduler shifts_;
+    std::string meta_prefix_;   // <ISA95_PREFIX>_meta/
+    metrics::Reporter metrics_;
 
     void subscribe_topics();
-    void handle_celima_data(const std::string& payload);
-    void publish_qos1(const std::string& topic, const std::string& payload);
+    void handle_ingest(IngestItem& item);
+    void handle_celima_data(const std::string& payload, std::chrono::system_clock::time_point received);
+    void handle_shift_change(const ShiftChange& ev);
+    /** Publish, or spool while offline; see PublishSpool::append() for `record`. */
+    void publish_qos1(std::string_view topic, std::string_view payload, std::string_view record = {});
+    /** Hand one publication to Paho; false if it was dropped (window full) or rejected. */
+    bool send_qos1(std::string_view topic, std::string_view payload);
+    void add_stats(nlohmann::json& report) const;
 };
@@ -0,0 +1,92 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "JsonWriter.hpp"
+
+/**
+ * One (topic, payload) publication, QoS 1 (the app enforces it).
+ * The topic is interned (topics::intern) and lives for the process; the
+ * payload views the PublicationSink it was written to and is valid until
+ * that sink is cleared.
+ */
+struct Publication {
+    std::string_view topic;
+    std::string_view payload;   // JSON
+    /**
+     * What the payload reports, without its timestamp, for topics where an
+     * unchanged value is no news (alarms); lets PublishCoalescer skip it.
+     */
+    std::optional<int64_t> state = std::nullopt;
+};
+
+/**
+ * PublicationSink: where processors and the shift summary collector write
+ * their publications. Payloads are serialized straight into one byte
+ * arena and the records into a vector, both reused: the owner (one per
+ * worker shard) clears the sink before each message, so once its buffers
+ * have grown to the largest message's output, publishing allocates
+ * nothing.
+ */
+class PublicationSink {
+public:
+    /** Append a publication whose payload `write(jsonw::Writer&)` writes in place. */
+    template <typename Fn>
+    void emit(std::string_view topic, Fn&& write, std::optional<int64_t> state = std::nullopt) {
+        const std::size_t off = bytes_.size();
+        jsonw::Writer w(bytes_);
+        write(w);
+        items_.push_back(Item{topic, off, bytes_.size() - off, state});
+    }
+
+    /** Append `obj` serialized with `schema`. */
+    template <typename T, typename... Ms>
+    void add(std::string_view topic, const T& obj, const jsonw::Schema<T, Ms...>& schema,
+             std::optional<int64_t> state = std::nullopt) {
+        emit(topic, [&](jsonw::Writer& w) { jsonw::write(w, obj, schema); }, state);
+    }
+
+    /** Append a payload serialized elsewhere (copied into the arena). */
+    void add(std::string_view topic, std::string_view payload, std::optional<int64_t> state = std::nullopt) {
+        emit(topic, [&](jsonw::Writer& w) { w.raw(payload); }, state);
+    }
+
+    std::size_t size() const { return items_.size(); }
+    bool empty() const { return items_.empty(); }
+
+    Publication operator[](std::size_t i) const {
+        const Item& it = items_[i];
+        return Publication{it.topic, std::string_view(bytes_).substr(it.off, it.len), it.state};
+    }
+
+    class const_iterator {
+    public:
+        const_iterator(const PublicationSink* s, std::size_t i) : s_(s), i_(i) {}
+        Publication operator*() const { return (*s_)[i_]; }
+        const_iterator& operator++() { ++i_; return *this; }
+        bool operator!=(const const_iterator& o) const { return i_ != o.i_; }
+    private:
+        const PublicationSink* s_;
+        std::size_t i_;
+    };
+    const_iterator begin() const { return {this, 0}; }
+    const_iterator end() const { return {this, items_.size()}; }
+
+    /** Drop the publications, keeping the buffers' capacity. */
+    void clear() {
+        bytes_.clear();
+        items_.clear();
+    }
+
+private:
+    struct Item {
+        std::string_view topic;
+        std::size_t off, len;   // payload bytes in bytes_
+        std::optional<int64_t> state;
+    };
+    std::string bytes_;
+    std::vector<Item> items_;
+};
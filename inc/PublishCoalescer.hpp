@@ -0,0 +1,104 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "MessageProcessor.hpp"
+
+/**
+ * Publish coalescing configuration.
+ *  - flush_ms:        how long a publication may wait for a newer one on its
+ *                     topic; 0 = coalescing off, publish immediately
+ *  - max_dirty:       flush early once this many topics are pending
+ *  - alarm_max_stale: republish an unchanged alarm after this long anyway
+ *                     (0 = never suppress)
+ */
+struct CoalesceOptions {
+    unsigned             flush_ms  = 0;
+    std::size_t          max_dirty = 512;
+    std::chrono::seconds alarm_max_stale{300};
+};
+
+struct CoalesceStats {
+    uint64_t submitted  = 0;
+    uint64_t published  = 0;
+    uint64_t coalesced  = 0;   // replaced by a newer payload before its flush
+    uint64_t suppressed = 0;   // unchanged alarm, not republished
+    uint64_t flushes    = 0;
+};
+
+/**
+ * PublishCoalescer: last-value-wins stage between the processors and the
+ * broker. It keeps the latest payload per topic and publishes the pending
+ * set every flush_ms (or when max_dirty topics are pending), so a line that
+ * reports faster than the flush interval costs one QoS 1 publish (token +
+ * PUBACK) per interval instead of one per uplink. The latest state always
+ * goes out.
+ *
+ * Publications carrying a `state` (alarms) are dropped while their state
+ * equals the last one published on that topic, unless that publish is older
+ * than alarm_max_stale.
+ *
+ * submit() is thread-safe and never blocks on I/O; the sink runs on the
+ * flusher thread (and on the caller of stop() for the final flush).
+ * Topics are the publications' interned views, so tracking a topic costs
+ * no copy. Payloads are copied into per-topic buffers that are swapped,
+ * not handed over, at flush time, so in steady state nothing is allocated.
+ */
+class PublishCoalescer {
+public:
+    using Sink = std::function<void(std::string_view topic, const std::string& payload)>;
+
+    PublishCoalescer(CoalesceOptions opts, Sink sink);
+    ~PublishCoalescer();
+
+    PublishCoalescer(const PublishCoalescer&) = delete;
+    PublishCoalescer& operator=(const PublishCoalescer&) = delete;
+
+    void start();
+    /** Flush what is pending and stop. */
+    void stop();
+
+    void submit(const Publication& pub);
+
+    CoalesceStats stats() const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Entry {
+        std::string payload;
+        bool dirty = false;
+        std::optional<int64_t> state;            // of the pending payload
+        std::optional<int64_t> published_state;
+        Clock::time_point published_at{};
+    };
+
+    CoalesceOptions opts_;
+    Sink sink_;
+
+    mutable std::mutex mu_;
+    std::condition_variable cv_;
+    std::unordered_map<std::string_view, Entry> topics_;   // keys interned
+    std::vector<std::pair<const std::string_view, Entry>*> dirty_;   // entries with dirty set
+    std::vector<std::pair<std::string_view, std::string>> batch_;      // flusher only; buffers reused
+    bool running_ = false;
+    std::thread thread_;
+
+    std::atomic<uint64_t> submitted_{0};
+    std::atomic<uint64_t> published_{0};
+    std::atomic<uint64_t> coalesced_{0};
+    std::atomic<uint64_t> suppressed_{0};
+    std::atomic<uint64_t> flushes_{0};
+
+    void run();
+    void flush(std::unique_lock<std::mutex>& lk);
+};
@@ -0,0 +1,152 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+
+/**
+ * Publish spool configuration.
+ *  - dir:           directory for the spool segments; empty = spool disabled
+ *  - max_bytes:     on-disk budget; past it the spool is compacted
+ *  - segment_bytes: roll to a new segment file past this size
+ *  - drain_rate:    publications per second replayed after a reconnect
+ */
+struct SpoolOptions {
+    std::string dir;
+    std::size_t max_bytes     = 64u << 20;
+    std::size_t segment_bytes = 4u << 20;
+    unsigned    drain_rate    = 100;
+};
+
+struct SpoolStats {
+    uint64_t    spooled     = 0;
+    uint64_t    drained     = 0;
+    uint64_t    superseded  = 0;   // replaced by a newer spooled or live publication
+    uint64_t    dropped     = 0;   // oldest topics evicted to stay within max_bytes
+    uint64_t    compactions = 0;
+    std::size_t topics      = 0;   // pending, one per topic (and record id)
+    std::size_t bytes       = 0;   // on disk
+};
+
+/**
+ * PublishSpool: file-backed store for publications made while the broker is
+ * unreachable, so an outage neither grows RAM nor loses state (and survives
+ * a restart).
+ *
+ * Segments are <dir>/spool-<seq>.dat, append-only, each record being
+ *
+ *   u32 crc32(topic, payload)  u32 topic_len  u32 payload_len  topic  payload
+ *
+ * (native endianness; payload_len 0xffffffff marks a tombstone, written when
+ * a topic is drained or superseded). Only an index stays in memory: the
+ * latest record of each topic; older records of a topic are dead space.
+ * Topics carry accumulated state (production counters, alarms), so the
+ * latest one is all that has to reach the broker. Fully dead segments are
+ * deleted oldest first.
+ *
+ * A publication that is a record of its own rather than the topic's latest
+ * state (a line's shift_summary, one per shift) is appended with a record
+ * id: it is indexed, and stored, under "<topic>\0<record>" (MQTT topics
+ * cannot hold NUL), so records with different ids are kept and drained
+ * side by side and supersede(topic) leaves them alone.
+ *
+ * Past max_bytes the spool is compacted: live records are copied to fresh
+ * segments and the old files deleted; if they still do not fit in 3/4 of
+ * the budget, the topics spooled longest ago are dropped.
+ *
+ * After request_drain() a drainer thread hands the pending records to the
+ * sink, oldest first, paced at drain_rate per second so a reconnect does
+ * not flood the broker. A record is tombstoned only once the sink returns
+ * true (sent); on false the pass stops there and resumes a few seconds
+ * later, or on the next request_drain(). A live publication on a spooled
+ * topic must call supersede() first so the older spooled state is not
+ * published after it: the drainer only hands a record to the sink while it
+ * is still the topic's latest, and supersede() of the topic being handed
+ * over waits until the sink returns.
+ *
+ * Records are written (not fsynced) per append: they survive a process
+ * crash; segment rolls and compactions are fdatasync'ed.
+ */
+class PublishSpool {
+public:
+    using Sink = std::function<bool(const std::string& topic, const std::string& payload)>;
+
+    PublishSpool(SpoolOptions opts, Sink sink);
+    ~PublishSpool();
+
+    PublishSpool(const PublishSpool&) = delete;
+    PublishSpool& operator=(const PublishSpool&) = delete;
+
+    /** Create the directory, index what a previous run left and start the drainer. */
+    bool open(std::string& err);
+    void stop();
+
+    /** Spool a publication; a non-empty `record` keeps it apart from the topic's other ones. */
+    void append(const std::string& topic, const std::string& payload, std::string_view record = {});
+    void supersede(const std::string& topic);
+    void request_drain();
+
+    /** Nothing pending (lock-free hint for the live publish path). */
+    bool empty() const { return pending_.load(std::memory_order_relaxed) == 0; }
+
+    SpoolStats stats() const;
+
+private:
+    struct Segment {
+        int         fd    = -1;
+        std::size_t bytes = 0;
+        std::size_t live  = 0;   // index entries pointing here
+    };
+    struct Loc {
+        uint64_t seq;
+        uint32_t segment;
+        uint64_t offset;         // of the record header
+        uint32_t topic_len;
+        uint32_t payload_len;
+    };
+
+    SpoolOptions opts_;
+    Sink sink_;
+
+    mutable std::mutex mu_;
+    std::condition_variable cv_;
+    std::condition_variable sink_done_;   // draining_ cleared
+    std::string draining_;                // key the drainer is handing to the sink
+    std::map<uint32_t, Segment> segments_;
+    std::unordered_map<std::string, Loc> index_;
+    uint32_t    active_ = 0;     // segment receiving appends; 0 = none yet
+    uint32_t    next_segment_ = 1;
+    uint64_t    next_seq_ = 1;
+    std::size_t bytes_ = 0;
+    bool        running_ = false;
+    bool        drain_requested_ = false;
+    std::thread thread_;
+    std::atomic<std::size_t> pending_{0};
+
+    std::atomic<uint64_t> spooled_{0};
+    std::atomic<uint64_t> drained_{0};
+    std::atomic<uint64_t> superseded_{0};
+    std::atomic<uint64_t> dropped_{0};
+    std::atomic<uint64_t> compactions_{0};
+
+    void run();
+    bool drain_pass();
+
+    // All with mu_ held.
+    bool roll(std::string& err);
+    bool write_record(const std::string& topic, const char* payload, uint32_t payload_len, Loc& loc);
+    bool read_payload(const Loc& loc, std::string& payload) const;
+    void write_tombstone(const std::string& topic);
+    void unlink_entry(const Loc& loc);
+    void trim();
+    void remove_segment(uint32_t id);
+    void compact();
+    void load(const std::string& path, uint32_t id);
+    std::string segment_path(uint32_t id) const;
+};
@@ -0,0 +1,75 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+
+/**
+ * QoS 1 publish flow control.
+ *  - max_inflight: unacknowledged publishes on the wire (Paho max inflight)
+ *  - max_buffered: publishes Paho may hold beyond that, including while
+ *                  disconnected (Paho max buffered messages)
+ *  - block_ms:     how long a publisher waits for room before the
+ *                  publication is dropped
+ */
+struct PublishOptions {
+    unsigned max_inflight = 64;
+    unsigned max_buffered = 10000;
+    unsigned block_ms     = 5000;
+};
+
+struct PublishStats {
+    uint64_t inflight  = 0;   // sent, awaiting PUBACK
+    uint64_t buffered  = 0;   // queued in Paho (window full or disconnected)
+    uint64_t published = 0;
+    uint64_t acked     = 0;
+    uint64_t failed    = 0;   // delivery failed after publish() accepted it
+    uint64_t dropped   = 0;   // never handed to Paho: no room or publish() threw
+};
+
+/**
+ * PublishWindow: counts QoS 1 publications handed to Paho until their
+ * delivery completes or fails, and bounds them to max_inflight +
+ * max_buffered so a broker outage cannot make publish() throw once Paho's
+ * buffer is full.
+ *
+ * acquire() blocks the publishing thread (an ingest worker or the
+ * coalescer) while the window is full, which throttles the IngestPipeline:
+ * its queues fill up and its overflow policy applies upstream. The wait is
+ * bounded by block_ms because acknowledgements arrive on the Paho callback
+ * thread, which may itself be blocked handing a new uplink to a full queue;
+ * after block_ms the publication is dropped and counted.
+ */
+class PublishWindow {
+public:
+    explicit PublishWindow(PublishOptions opts);
+
+    /** Reserve a slot; false (counted as dropped) if none freed up within block_ms. */
+    bool acquire();
+    /** Delivery of an acquired publication finished: acknowledged or failed. */
+    void complete(bool acked);
+    /** publish() rejected an acquired publication. */
+    void abandon();
+
+    void set_connected(bool connected);
+    bool connected() const { return connected_.load(std::memory_order_relaxed); }
+
+    PublishStats stats() const;
+    const PublishOptions& options() const { return opts_; }
+
+private:
+    PublishOptions opts_;
+
+    mutable std::mutex mu_;
+    std::condition_variable cv_;
+    uint64_t outstanding_ = 0;
+    bool throttled_ = false;
+    std::atomic<bool> connected_{false};
+
+    std::atomic<uint64_t> published_{0};
+    std::atomic<uint64_t> acked_{0};
+    std::atomic<uint64_t> failed_{0};
+    std::atomic<uint64_t> dropped_{0};
+
+    void release();
+};
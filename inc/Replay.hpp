@@ -0,0 +1,31 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <string>
+#include "MessageProcessor.hpp"
+
+struct ReplayStats {
+    uint64_t messages     = 0;
+    uint64_t invalid      = 0;
+    uint64_t publications = 0;
+    uint64_t shift_closes = 0;   // boundaries replayed
+    double   seconds      = 0;
+};
+
+/**
+ * Offline replay of a Journal directory on the calling thread, as fast as it
+ * goes: every uplink runs through the same decode_uplink -> ProcessorTable ->
+ * process() path as MqttApp, with its journaled receive time as the message
+ * time. Shift boundaries of the configured calendar are replayed at their
+ * instants between messages (close_shift + ShiftSummaryCollector), so state
+ * and shift summaries evolve as they did live.
+ *
+ * Every publication goes to `sink`, its payload valid for the call. With
+ * pstore open, the per-line state of the last shift is rebuilt in the
+ * state file, which must start empty: state already saved for a shift the
+ * journal covers would be restored and its uplinks counted again (main
+ * refuses an existing STATE_FILE in --replay mode).
+ */
+bool replay_journal(const std::string& dir, const std::string& isa95_prefix,
+                    const std::function<void(const Publication&)>& sink,
+                    ReplayStats& stats, std::string& err);
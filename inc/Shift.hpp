@@ -1,27 +1,104 @@
 #pragma once
 #include <ctime>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
 
-enum class Shift : int { S1 = 1, S2 = 2, S3 = 3 };
+/**
+ * ShiftSchedule: when shifts start, in local time.
+ *
+ *  - boundaries: minutes after local midnight, strictly ascending, at least
+ *    two. Shift k (1-based) starts at boundaries[k-1] and runs until the next
+ *    boundary; the last one wraps past midnight.
+ *  - holidays: dates (YYYYMMDD, sorted) on which no boundary fires; the shift
+ *    running when a holiday starts continues until the first boundary after it.
+ *
+ * The default is the plant's historical 06:00 / 14:00 / 22:00 schedule.
+ */
+struct ShiftSchedule {
+    std::vector<int> boundaries{6 * 60, 14 * 60, 22 * 60};
+    std::vector<int> holidays;
 
-inline Shift current_shift_localtime() {
-    std::time_t now = std::time(nullptr);
-    std::tm lt{};
-#if defined(_WIN32)
-    localtime_s(&lt, &now);
-#else
-    localtime_r(&now, &lt);
-#endif
+    bool is_holiday(int yyyymmdd) const;
+};
 
-    int h = lt.tm_hour; // 0–23
+/**
+ * Plant schedule plus per-line boundary overrides (holidays are plant-wide).
+ *
+ * Env (parsed by parse_shift_config):
+ *  - SHIFT_BOUNDARIES      "06:00,14:00,22:00"
+ *  - SHIFT_HOLIDAYS        "2025-01-01,2025-05-01"
+ *  - SHIFT_LINE_OVERRIDES  "3=07:00,19:00;5=06:00,14:00,22:00"
+ */
+struct ShiftConfig {
+    ShiftSchedule plant;
+    std::map<int, std::vector<int>> line_boundaries;
 
-    // Shift 1: 07:00–14:59
-    if (h >= 6 && h < 14)
-        return Shift::S1;
+    bool has_override(int line) const { return line_boundaries.count(line) != 0; }
+    ShiftSchedule for_line(int line) const;
+};
 
-    // Shift 2: 15:00–22:59
-    if (h >= 14 && h < 22)
-        return Shift::S2;
+/** Empty strings keep the defaults. On error `err` names the bad entry. */
+bool parse_shift_config(std::string_view boundaries, std::string_view holidays,
+                        std::string_view line_overrides, ShiftConfig& out, std::string& err);
 
-    // Shift 3: 23:00–06:59
-    return Shift::S3;
-}
+std::string describe(const ShiftConfig& cfg);
+
+/**
+ * Process-wide shift configuration. set_shift_config() must run before any
+ * thread calls shift_at() (i.e. at startup, before workers start).
+ */
+void set_shift_config(ShiftConfig cfg);
+const ShiftConfig& shift_config();
+
+/**
+ * ShiftCalendar: maps an instant to its shift number under one schedule.
+ *
+ * The calendar remembers the [start, next boundary) interval of the last
+ * shift it resolved, so a lookup inside it is two integer comparisons;
+ * localtime_r/mktime (and the libc tz lock) only run when a boundary is
+ * crossed. Boundaries come from mktime with tm_isdst = -1, so DST days get
+ * the right instants. Not thread-safe: use one instance per thread
+ * (shift_at does).
+ */
+class ShiftCalendar {
+public:
+    explicit ShiftCalendar(ShiftSchedule s = {}) : sched_(std::move(s)) {}
+
+    int at(std::time_t t) {
+        if (t >= start_ && t < next_) return current_;
+        recompute(t);
+        return current_;
+    }
+
+    // Result of the last lookup: shift number, its start, first instant of the next one.
+    int current() const { return current_; }
+    std::time_t shift_start() const { return start_; }
+    std::time_t next_boundary() const { return next_; }
+
+private:
+    ShiftSchedule sched_;
+    std::time_t start_ = 0;
+    std::time_t next_  = 0;
+    int current_       = 0;
+
+    void recompute(std::time_t t);
+};
+
+/** Shift number of `line` at instant t, through the calling thread's calendars. */
+int shift_at(std::time_t t, int line = 0);
+
+/** Start of that shift: identifies one shift instance (shift numbers repeat daily). */
+std::time_t shift_start_at(std::time_t t, int line = 0);
+
+/**
+ * A shift boundary, as fired by ShiftScheduler.
+ * line = -1 for the plant schedule (every line without an override).
+ */
+struct ShiftChange {
+    std::time_t at   = 0;
+    int line         = -1;
+    int closed_shift = 0;
+    int opened_shift = 0;
+};
@@ -0,0 +1,43 @@
+#pragma once
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include "Shift.hpp"
+
+/**
+ * ShiftScheduler: timer thread that fires a ShiftChange at every shift
+ * boundary of the plant schedule and of each per-line override, so state
+ * rolls over on time even when no uplink arrives.
+ *
+ * The thread sleeps until the earliest pending boundary (wall clock, so DST
+ * and clock corrections are honored) and calls the handler once per
+ * boundary each schedule crossed, in order: after a clock step or a suspend
+ * that passed several, every skipped shift is still closed under its own
+ * turno. The handler runs on the timer thread; MqttApp
+ * uses it to post a control item to every ingest shard.
+ */
+class ShiftScheduler {
+public:
+    using Handler = std::function<void(const ShiftChange&)>;
+
+    ShiftScheduler(ShiftConfig cfg, Handler handler);
+    ~ShiftScheduler();
+
+    ShiftScheduler(const ShiftScheduler&) = delete;
+    ShiftScheduler& operator=(const ShiftScheduler&) = delete;
+
+    void start();
+    void stop();
+
+private:
+    ShiftConfig cfg_;
+    Handler handler_;
+
+    std::mutex mu_;
+    std::condition_variable cv_;
+    bool running_ = false;
+    std::thread thread_;
+
+    void run();
+};
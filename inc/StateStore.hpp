@@ -0,0 +1,67 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <string>
+
+/**
+ * pstore: crash-safe persistence of per-line processor state in a
+ * memory-mapped file, so a restart mid-shift resumes the shift's counters
+ * instead of starting again from zero.
+ *
+ * File layout (fixed, native endianness):
+ *
+ *   Header  magic "CELSTATE", FORMAT_VERSION, slot size, capacity,
+ *           number of claimed slots, checksum of the fixed fields
+ *   Slot[capacity]
+ *           seq (odd while a write is in progress), device kind, line,
+ *           device EUI, state size, shift start, checksum, raw state bytes
+ *
+ * A slot belongs to one (kind, line, device) for the life of the file; a
+ * negative kind is a second state of that device (LineStates keeps a closed
+ * shift there until its summary is out). save() is a
+ * memcpy into the shared mapping plus a checksum: no syscall per message.
+ * The kernel writes dirty pages back on its own; sync() (shift boundaries,
+ * shutdown) asks for it explicitly. A process crash loses nothing already
+ * saved; a torn slot (crash inside save) fails its checksum and is ignored.
+ *
+ * Bump FORMAT_VERSION whenever a processor State struct changes layout:
+ * a file with another version is discarded and recreated.
+ */
+namespace pstore {
+
+constexpr uint32_t FORMAT_VERSION = 4;
+constexpr std::size_t SLOT_PAYLOAD = 192;   // max sizeof(State)
+
+struct Slot;
+
+/**
+ * Map (creating or recreating as needed) the state file. Call once at
+ * startup, before any worker runs. On failure persistence stays disabled
+ * and `err` says why.
+ */
+bool open(const std::string& path, std::size_t capacity, std::string& err);
+
+/** Flush and unmap. Call after the workers have stopped. */
+void close();
+
+bool enabled();
+
+/**
+ * The slot of (kind, line, device), claiming a free one on first use.
+ * kind must not be 0 (a free slot).
+ * `device` is the devEUI (0: none). Thread-safe. nullptr when persistence
+ * is disabled or the file is full.
+ */
+Slot* slot(int kind, int line, uint64_t device = 0);
+
+/** Copy the slot's state into `out` if it is intact, `size` bytes long and was saved during the shift that started at shift_start. */
+bool load(const Slot* s, void* out, std::size_t size, std::time_t shift_start);
+
+/** Overwrite the slot's state in place. Only the shard that owns the line writes its slot. */
+void save(Slot* s, const void* state, std::size_t size, std::time_t shift_start);
+
+/** Schedule write-back of dirty pages (msync MS_ASYNC). */
+void sync();
+
+} // namespace pstore
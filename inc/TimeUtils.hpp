@@ -1,27 +1,71 @@
 #pragma once
 #include <string>
-#include <sstream>
-#include <iomanip>
+#include <string_view>
 #include <chrono>
+#include <cstdint>
+#include <cstring>
 #include <ctime>
 
-inline std::string iso8601_utc_now()
+// "YYYY-MM-DDTHH:MM:SS.mmmZ"
+constexpr std::size_t ISO8601_LEN = 24;
+
+/** Fixed-size, NUL-terminated ISO-8601 UTC timestamp. */
+struct IsoTimestamp {
+    char data[ISO8601_LEN + 1];
+
+    std::string_view view() const { return {data, ISO8601_LEN}; }
+};
+
+/**
+ * Formats tp as "YYYY-MM-DDTHH:MM:SS.mmmZ" into out (ISO8601_LEN + 1 bytes).
+ * The date/time prefix is cached per thread for the current second, so the
+ * common case is a memcpy plus three millisecond digits: no stream, no
+ * allocation, no gmtime_r.
+ */
+inline void iso8601_utc_format(std::chrono::system_clock::time_point tp, char* out)
 {
     using namespace std::chrono;
 
-    const auto now = system_clock::now();
-    const auto ms  = duration_cast<milliseconds>(now.time_since_epoch()) % 1000;
-    const std::time_t t = system_clock::to_time_t(now);
+    const auto since_epoch = duration_cast<milliseconds>(tp.time_since_epoch()).count();
+    const std::time_t sec  = static_cast<std::time_t>(since_epoch / 1000);
+    const int ms           = static_cast<int>(since_epoch % 1000);
 
-    std::tm utc{};
+    thread_local std::time_t cached_sec = -1;
+    thread_local char prefix[20];  // "YYYY-MM-DDTHH:MM:SS"
+
+    if (sec != cached_sec) {
+        std::tm utc{};
 #if defined(_WIN32)
-    gmtime_s(&utc, &t);
+        gmtime_s(&utc, &sec);
 #else
-    gmtime_r(&t, &utc);  // ← CORREGIDO: el segundo parámetro es &utc
+        gmtime_r(&sec, &utc);
 #endif
+        std::strftime(prefix, sizeof(prefix), "%Y-%m-%dT%H:%M:%S", &utc);
+        cached_sec = sec;
+    }
+
+    std::memcpy(out, prefix, 19);
+    out[19] = '.';
+    out[20] = static_cast<char>('0' + ms / 100);
+    out[21] = static_cast<char>('0' + ms / 10 % 10);
+    out[22] = static_cast<char>('0' + ms % 10);
+    out[23] = 'Z';
+    out[24] = '\0';
+}
 
-    std::ostringstream oss;
-    oss << std::put_time(&utc, "%Y-%m-%dT%H:%M:%S")
-        << '.' << std::setfill('0') << std::setw(3) << ms.count() << 'Z';
-    return oss.str();
+inline IsoTimestamp iso8601_utc(std::chrono::system_clock::time_point tp)
+{
+    IsoTimestamp ts;
+    iso8601_utc_format(tp, ts.data);
+    return ts;
+}
+
+inline IsoTimestamp iso8601_utc()
+{
+    return iso8601_utc(std::chrono::system_clock::now());
+}
+
+inline std::string iso8601_utc_now()
+{
+    return std::string(iso8601_utc().view());
 }
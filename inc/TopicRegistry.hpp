@@ -0,0 +1,64 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include "LineTable.hpp"
+
+/**
+ * topics: interned publication topics.
+ *
+ * Every topic the processors publish on is one of a fixed set per line
+ * ("<prefix><line>/esmalte/production", ...). intern() keeps one copy of
+ * each distinct topic for the life of the process, so a Publication can
+ * carry a std::string_view instead of an owned string; LineTopics builds a
+ * processor's topics for a line the first time the line shows up and
+ * afterwards hands out the interned views with no allocation.
+ */
+namespace topics {
+
+/** The process-lifetime copy of `topic` (one per distinct string). Thread-safe. */
+std::string_view intern(std::string_view topic);
+
+/** Topics interned so far. */
+std::size_t count();
+
+/**
+ * The topics "<prefix><line><suffix>" of N fixed suffixes, by line. Not
+ * thread-safe: processors keep one per worker shard (thread_local), next
+ * to their line states. A prefix other than the last one seen rebuilds
+ * the table.
+ */
+template <std::size_t N>
+class LineTopics {
+public:
+    using Set = std::array<std::string_view, N>;
+
+    explicit LineTopics(const Set& suffixes) : suffixes_(suffixes) {}
+
+    Set at(std::string_view prefix, int line)
+    {
+        if (prefix != prefix_) {
+            lines_.clear();
+            prefix_.assign(prefix);
+        }
+        auto [set, inserted] = lines_.try_emplace(line);
+        if (inserted) {
+            std::string topic;
+            for (std::size_t i = 0; i < N; ++i) {
+                topic.assign(prefix_);
+                topic += std::to_string(line);
+                topic += suffixes_[i];
+                (*set)[i] = intern(topic);
+            }
+        }
+        return *set;
+    }
+
+private:
+    Set suffixes_;
+    std::string prefix_;
+    LineTable<Set> lines_;
+};
+
+} // namespace topics
@@ -0,0 +1,143 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+/**
+ * Known celima/data fields: the union of what the eight device processors
+ * read. Order is irrelevant; names must match the LoRaWAN decoder output.
+ */
+#define CELIMA_UPLINK_FIELDS(X)                                              \
+    /* header */                                                             \
+    X(devEUI) X(lineID) X(deviceType) X(alarms) X(checksum) X(status)        \
+    X(timer1Hz)                                                              \
+    /* PH_1, PH_2, Salida_secador, Esmalte */                                \
+    X(cantidadProductos) X(tiempoProduccion_ds) X(paradas) X(tiempoParadas_s) \
+    /* Entrada_secador */                                                    \
+    X(arranques) X(tiempoOperacion_s)                                        \
+    /* Entrada_horno */                                                      \
+    X(cantidadGrades) X(fallaHorno) X(tiempoFalla_s)                         \
+    X(metricaMCF) X(metricaMCF_acum) X(metricaFOR) X(metricaFOR_acum)        \
+    /* Salida_horno */                                                       \
+    X(bancalinos0) X(bancalinos1) X(bancalinosComb1) X(bancalinosComb2)      \
+    X(bancalinosTotal) X(cambioBarrera) X(cambioBarreraTotal)                \
+    X(cambioSentido) X(cambioSentidoTotal) X(cantidad) X(cantidad_total)     \
+    X(paradas_1) X(paradas_2)                                                \
+    /* Calidad */                                                            \
+    X(boxesQ1) X(boxesQ2) X(boxesQ6) X(totalBroken)                          \
+    X(cajaCalidad) X(quebrados) X(quebrado)
+
+enum class UF : uint8_t {
+#define CELIMA_UF_ENUM(name) name,
+    CELIMA_UPLINK_FIELDS(CELIMA_UF_ENUM)
+#undef CELIMA_UF_ENUM
+    COUNT
+};
+
+constexpr std::size_t UF_COUNT = static_cast<std::size_t>(UF::COUNT);
+
+const char* upFieldName(UF f);
+
+/**
+ * Uplink: flat decoded view of one celima/data payload.
+ *
+ * decode_uplink() validates the whole document and stores only the known
+ * top-level fields (CELIMA_UPLINK_FIELDS); everything else is skipped
+ * without allocation. `raw` points at the caller's payload, which must
+ * outlive the Uplink (DefaultProcessor parses it into a DOM on demand).
+ *
+ * Accessors mirror the nlohmann calls they replace:
+ *  - get_opt(f)    ~ jsonu::get_opt<int>(j, key): nullopt if missing or not a number
+ *  - value(f, def) ~ j.value(key, def): def if missing, throws if not a number
+ *  - contains(f)   ~ j.contains(key)
+ *  - get_str(f)    raw contents of a string field (e.g. devEUI)
+ * Numbers convert like nlohmann's get<int>() (booleans count as 0/1,
+ * floats truncate).
+ */
+struct Uplink {
+    enum class Kind : uint8_t { Missing = 0, Integer, Unsigned, Float, Boolean, Null, String, Object, Array };
+
+    /** A string value's contents in `raw`, between the quotes. */
+    struct Span {
+        uint32_t off;
+        uint32_t len;
+    };
+
+    struct Value {
+        Kind kind = Kind::Missing;
+        union {
+            int64_t  i;
+            uint64_t u;
+            double   d;
+            Span     s;   // Kind::String
+        };
+        Value() : i(0) {}
+    };
+
+    std::string_view raw;
+    std::array<Value, UF_COUNT> fields{};
+
+    const Value& at(UF f) const { return fields[static_cast<std::size_t>(f)]; }
+
+    bool contains(UF f) const { return at(f).kind != Kind::Missing; }
+
+    std::optional<int> get_opt(UF f) const {
+        const Value& v = at(f);
+        if (!is_number(v.kind)) return std::nullopt;
+        return to_int(v);
+    }
+
+    /** Contents as they appear in the payload (escapes not decoded); nullopt if missing or not a string. */
+    std::optional<std::string_view> get_str(UF f) const {
+        const Value& v = at(f);
+        if (v.kind != Kind::String) return std::nullopt;
+        return raw.substr(v.s.off, v.s.len);
+    }
+
+    int value(UF f, int def) const {
+        const Value& v = at(f);
+        if (v.kind == Kind::Missing) return def;
+        if (!is_number(v.kind)) throw_type_error(f);
+        return to_int(v);
+    }
+
+private:
+    static bool is_number(Kind k) {
+        return k == Kind::Integer || k == Kind::Unsigned || k == Kind::Float || k == Kind::Boolean;
+    }
+
+    static int to_int(const Value& v) {
+        switch (v.kind) {
+            case Kind::Integer:  return static_cast<int>(v.i);
+            case Kind::Unsigned: return static_cast<int>(v.u);
+            case Kind::Float:    return static_cast<int>(v.d);
+            case Kind::Boolean:  return static_cast<int>(v.i);
+            default:             return 0;
+        }
+    }
+
+    [[noreturn]] void throw_type_error(UF f) const;
+};
+
+/**
+ * Streaming, validating decoder for celima/data payloads (RFC 8259 JSON,
+ * UTF-8 checked). No DOM, no per-field allocation; `err` is only written
+ * on failure. The top-level value must be an object.
+ */
+bool decode_uplink(std::string_view payload, Uplink& out, std::string& err);
+
+/** Worker shard key of a celima/data payload. */
+struct UplinkRoute {
+    int deviceType = 0;
+    int lineID     = 0;
+};
+
+/**
+ * deviceType and lineID exactly as the processors will read them: the
+ * payload goes through decode_uplink() (top-level keys only, last duplicate
+ * wins, numbers converted as Uplink::get_opt()), so a line never lands on
+ * two shards. 0 for a missing or non-numeric value or an invalid payload.
+ */
+UplinkRoute route_uplink(std::string_view payload);
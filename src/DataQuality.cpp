@@ -0,0 +1,108 @@
+#include "DataQuality.hpp"
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "DeviceTypes.hpp"
+#include "TimeUtils.hpp"
+
+namespace dq {
+
+namespace {
+
+// Lines of one worker shard. Only the owning thread adds blocks, under mu
+// (render() reads under it too); its own lookups need no lock.
+struct Shard {
+    std::mutex mu;
+    std::deque<LineCounters> blocks;                       // stable addresses
+    std::unordered_map<uint64_t, LineCounters*> index;     // by key()
+};
+
+struct Registry {
+    std::mutex mu;
+    std::vector<std::unique_ptr<Shard>> shards;            // never freed: outlive their threads
+    std::map<int, std::span<const std::string_view>> names;
+};
+
+Registry& registry() {
+    static Registry r;
+    return r;
+}
+
+thread_local Shard* t_shard = nullptr;
+
+uint64_t key(int kind, int line) {
+    return (static_cast<uint64_t>(static_cast<uint32_t>(kind)) << 32) | static_cast<uint32_t>(line);
+}
+
+} // namespace
+
+LineCounters& line(int kind, int line, std::span<const std::string_view> fields) {
+    Shard* s = t_shard;
+    if (!s) {
+        Registry& r = registry();
+        std::lock_guard<std::mutex> lk(r.mu);
+        r.shards.push_back(std::make_unique<Shard>());
+        s = t_shard = r.shards.back().get();
+    }
+
+    const uint64_t k = key(kind, line);
+    if (auto it = s->index.find(k); it != s->index.end()) return *it->second;
+
+    {
+        Registry& r = registry();
+        std::lock_guard<std::mutex> lk(r.mu);
+        r.names.try_emplace(kind, fields.first(std::min(fields.size(), MAX_FIELDS)));
+    }
+    std::lock_guard<std::mutex> lk(s->mu);
+    LineCounters& c = s->blocks.emplace_back();
+    s->index.emplace(k, &c);
+    return c;
+}
+
+std::string render() {
+    using Totals = std::array<std::array<uint64_t, 4>, MAX_FIELDS>;
+    std::map<std::pair<int, int>, Totals> lines;   // (kind, line), summed over shards
+    std::map<int, std::span<const std::string_view>> names;
+
+    {
+        Registry& r = registry();
+        std::lock_guard<std::mutex> lk(r.mu);
+        names = r.names;
+        for (auto& s : r.shards) {
+            std::lock_guard<std::mutex> slk(s->mu);
+            for (const auto& [k, c] : s->index) {
+                Totals& t = lines[{static_cast<int>(k >> 32), static_cast<int>(static_cast<uint32_t>(k))}];
+                for (std::size_t f = 0; f < MAX_FIELDS; ++f)
+                    for (std::size_t d = 0; d < 4; ++d)
+                        t[f][d] += c->fields[f].n[d].load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    nlohmann::json devices = nlohmann::json::object();
+    for (const auto& [kl, t] : lines) {
+        const auto [kind, line] = kl;
+        auto dt = deviceTypeFromInt(kind);
+        nlohmann::json& j = devices[dt ? deviceTypeName(*dt) : "Unknown"][std::to_string(line)];
+        const auto& fields = names[kind];
+        for (std::size_t f = 0; f < fields.size(); ++f) {
+            j[std::string(fields[f])] = {
+                {"counted",  t[f][static_cast<std::size_t>(Delta::Counted)]},
+                {"rejected", t[f][static_cast<std::size_t>(Delta::Rejected)]},
+                {"rollover", t[f][static_cast<std::size_t>(Delta::Rollover)]},
+                {"zero",     t[f][static_cast<std::size_t>(Delta::Zero)]},
+            };
+        }
+    }
+    nlohmann::json report;
+    report["devices"] = std::move(devices);
+    report["ts"] = std::string(iso8601_utc().view());
+    return report.dump();
+}
+
+} // namespace dq
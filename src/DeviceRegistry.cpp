@@ -0,0 +1,120 @@
+#include "DeviceRegistry.hpp"
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace devices {
+
+namespace {
+
+struct Registry {
+    std::mutex mu;
+    std::vector<uint64_t> euis{0};                 // by Id; [NONE] unused
+    std::unordered_map<uint64_t, Id> ids;
+};
+
+Registry& registry() {
+    static Registry r;
+    return r;
+}
+
+// EUIs the calling thread has already met: open addressing, linear
+// probing, power-of-two size, at most half full. id == NONE marks a free slot.
+struct Index {
+    struct Slot {
+        uint64_t eui = 0;
+        Id       id  = NONE;
+    };
+    std::vector<Slot> slots;
+    std::size_t used = 0;
+
+    static std::size_t hash(uint64_t eui) {
+        return static_cast<std::size_t>((eui * 0x9E3779B97F4A7C15ull) >> 32);   // Fibonacci hashing
+    }
+
+    Slot& probe(uint64_t eui) {
+        const std::size_t mask = slots.size() - 1;
+        for (std::size_t i = hash(eui) & mask;; i = (i + 1) & mask)
+            if (slots[i].id == NONE || slots[i].eui == eui) return slots[i];
+    }
+
+    void insert(uint64_t eui, Id id) {
+        if (used + 1 > slots.size() / 2) {
+            std::vector<Slot> old(slots.empty() ? 16 : slots.size() * 2);
+            old.swap(slots);
+            for (const Slot& s : old)
+                if (s.id != NONE) probe(s.eui) = s;
+        }
+        probe(eui) = {eui, id};
+        ++used;
+    }
+};
+
+thread_local Index t_index;
+
+int hex(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+} // namespace
+
+std::optional<uint64_t> parse_eui(std::string_view s) {
+    if (s.size() != 16) return std::nullopt;
+    uint64_t v = 0;
+    for (char c : s) {
+        const int h = hex(c);
+        if (h < 0) return std::nullopt;
+        v = (v << 4) | static_cast<uint64_t>(h);
+    }
+    return v;
+}
+
+std::string eui_hex(uint64_t eui) {
+    static constexpr char DIGITS[] = "0123456789abcdef";
+    std::string s(16, '0');
+    for (int i = 15; i >= 0; --i, eui >>= 4) s[static_cast<std::size_t>(i)] = DIGITS[eui & 0xF];
+    return s;
+}
+
+Id intern(uint64_t eui) {
+    Index& idx = t_index;
+    if (!idx.slots.empty()) {
+        const Index::Slot& s = idx.probe(eui);
+        if (s.id != NONE) return s.id;
+    }
+
+    Id id;
+    {
+        Registry& r = registry();
+        std::lock_guard<std::mutex> lk(r.mu);
+        auto [it, inserted] = r.ids.try_emplace(eui, static_cast<Id>(r.euis.size()));
+        if (inserted) r.euis.push_back(eui);
+        id = it->second;
+    }
+    idx.insert(eui, id);
+    return id;
+}
+
+uint64_t eui(Id id) {
+    Registry& r = registry();
+    std::lock_guard<std::mutex> lk(r.mu);
+    return id < r.euis.size() ? r.euis[id] : 0;
+}
+
+Id of(const Uplink& up) {
+    const auto text = up.get_str(UF::devEUI);
+    if (!text) return NONE;
+    const auto eui = parse_eui(*text);
+    return eui ? intern(*eui) : NONE;
+}
+
+std::size_t count() {
+    Registry& r = registry();
+    std::lock_guard<std::mutex> lk(r.mu);
+    return r.euis.size() - 1;
+}
+
+} // namespace devices
@@ -0,0 +1,224 @@
+#include "IngestPipeline.hpp"
+#include <algorithm>
+#include "Logger.hpp"
+
+IngestPipeline::IngestPipeline(IngestOptions opts, Handler handler)
+    : opts_(opts)
+    , handler_(std::move(handler))
+{
+    for (unsigned i = 0; i < opts_.workers; ++i)
+        shards_.push_back(std::make_unique<Shard>(opts_.capacity));
+}
+
+IngestPipeline::~IngestPipeline() {
+    stop();
+}
+
+unsigned IngestPipeline::shard_for(int deviceType, int lineID, unsigned shards) {
+    if (shards <= 1) return 0;
+    // splitmix64 finalizer over the packed key: cheap and well spread even
+    // for small dense lineIDs.
+    uint64_t x = (static_cast<uint64_t>(static_cast<uint32_t>(deviceType)) << 32)
+               | static_cast<uint32_t>(lineID);
+    x ^= x >> 30; x *= 0xBF58476D1CE4E5B9ULL;
+    x ^= x >> 27; x *= 0x94D049BB133111EBULL;
+    x ^= x >> 31;
+    return static_cast<unsigned>(x % shards);
+}
+
+void IngestPipeline::start() {
+    if (running_.exchange(true)) return;
+    for (auto& sh : shards_)
+        sh->thread = std::thread(&IngestPipeline::worker_loop, this, std::ref(*sh));
+
+    LOG_INFO(Ingest) << "[INGEST] " << shards_.size() << " worker shard(s), capacity "
+              << (shards_.empty() ? 0 : shards_.front()->queue.capacity())
+              << " each, overflow " << overflowPolicyName(opts_.overflow);
+}
+
+void IngestPipeline::stop() {
+    if (!running_.exchange(false)) return;
+
+    // Wake idle workers (they drain their queue before exiting) and blocked producers.
+    for (auto& sh : shards_) {
+        sh->items_signal.fetch_add(1);
+        sh->items_signal.notify_all();
+    }
+    space_signal_.fetch_add(1);
+    space_signal_.notify_all();
+
+    for (auto& sh : shards_)
+        if (sh->thread.joinable()) sh->thread.join();
+
+    auto s = stats();
+    LOG_INFO(Ingest) << "[INGEST] Stopped. enqueued=" << s.enqueued
+              << " processed=" << s.processed
+              << " dropped_oldest=" << s.dropped_oldest
+              << " dropped_newest=" << s.dropped_newest
+              << " max_depth=" << s.max_depth;
+}
+
+bool IngestPipeline::submit(IngestItem&& item) {
+    if (!running_.load(std::memory_order_acquire)) return false;
+
+    // Inline mode: behave like the old single-threaded callback path.
+    if (shards_.empty()) {
+        enqueued_.fetch_add(1, std::memory_order_relaxed);
+        run_control(inline_control_, item.received);
+        run_handler(item);
+        return true;
+    }
+
+    Shard& sh = *shards_[shard_for(item.deviceType, item.lineID,
+                                   static_cast<unsigned>(shards_.size()))];
+    for (;;) {
+        if (sh.queue.try_push(std::move(item))) {
+            note_enqueued(sh);
+            return true;
+        }
+
+        switch (opts_.overflow) {
+        case OverflowPolicy::DropNewest:
+            note_drop(dropped_newest_, "newest");
+            return false;
+
+        case OverflowPolicy::DropOldest: {
+            IngestItem victim;
+            if (sh.queue.try_pop(victim))
+                note_drop(dropped_oldest_, "oldest");
+            break; // retry push
+        }
+
+        case OverflowPolicy::Block: {
+            blocked_producers_.fetch_add(1);
+            const uint32_t seen = space_signal_.load();
+            if (sh.queue.try_push(std::move(item))) {
+                blocked_producers_.fetch_sub(1);
+                note_enqueued(sh);
+                return true;
+            }
+            if (!running_.load(std::memory_order_acquire)) {
+                blocked_producers_.fetch_sub(1);
+                return false;
+            }
+            space_signal_.wait(seen);
+            blocked_producers_.fetch_sub(1);
+            break; // retry push
+        }
+        }
+    }
+}
+
+bool IngestPipeline::post(const IngestItem& item) {
+    if (!running_.load(std::memory_order_acquire)) return false;
+
+    auto enqueue = [&](ControlQueue& cq) {
+        std::lock_guard<std::mutex> lk(cq.mu);
+        cq.items.push_back(item);
+        cq.pending.store(true, std::memory_order_release);
+    };
+
+    if (shards_.empty()) {
+        enqueue(inline_control_);
+        return true;
+    }
+    for (auto& sh : shards_) {
+        enqueue(sh->control);
+        // Wake the worker if idle so it runs the item now.
+        sh->items_signal.fetch_add(1, std::memory_order_release);
+        sh->items_signal.notify_one();
+    }
+    return true;
+}
+
+IngestStats IngestPipeline::stats() const {
+    IngestStats s;
+    s.enqueued       = enqueued_.load(std::memory_order_relaxed);
+    s.processed      = processed_.load(std::memory_order_relaxed);
+    s.dropped_oldest = dropped_oldest_.load(std::memory_order_relaxed);
+    s.dropped_newest = dropped_newest_.load(std::memory_order_relaxed);
+    for (const auto& sh : shards_) {
+        const std::size_t d = sh->queue.size_approx();
+        s.shard_depth.push_back(d);
+        s.depth += d;
+        s.max_depth = std::max(s.max_depth, sh->max_depth.load(std::memory_order_relaxed));
+    }
+    return s;
+}
+
+void IngestPipeline::worker_loop(Shard& shard) {
+    IngestItem item;
+    for (;;) {
+        if (!shard.queue.try_pop(item)) {
+            const uint32_t seen = shard.items_signal.load(std::memory_order_acquire);
+            if (!shard.queue.try_pop(item)) {
+                // Idle: nothing queued can predate pending control items.
+                run_control(shard.control, std::chrono::system_clock::time_point::max());
+                if (!running_.load(std::memory_order_acquire))
+                    break; // stopped and drained
+                shard.items_signal.wait(seen, std::memory_order_acquire);
+                continue;
+            }
+        }
+
+        if (blocked_producers_.load() > 0) {
+            space_signal_.fetch_add(1);
+            space_signal_.notify_all();
+        }
+        run_control(shard.control, item.received);
+        run_handler(item);
+    }
+}
+
+void IngestPipeline::run_handler(IngestItem& item) {
+    try {
+        handler_(item);
+    } catch (const std::exception& e) {
+        LOG_ERROR(Ingest) << "[INGEST] Handler error on " << item.topic << ": " << e.what();
+    }
+    processed_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void IngestPipeline::run_control(ControlQueue& cq, std::chrono::system_clock::time_point due) {
+    if (!cq.pending.load(std::memory_order_acquire)) return;
+
+    std::vector<IngestItem> ready;
+    {
+        std::lock_guard<std::mutex> lk(cq.mu);
+        auto it = cq.items.begin();
+        while (it != cq.items.end() && it->received <= due) ++it;
+        ready.assign(std::make_move_iterator(cq.items.begin()), std::make_move_iterator(it));
+        cq.items.erase(cq.items.begin(), it);
+        cq.pending.store(!cq.items.empty(), std::memory_order_release);
+    }
+
+    for (auto& c : ready) {
+        try {
+            handler_(c);
+        } catch (const std::exception& e) {
+            LOG_ERROR(Ingest) << "[INGEST] Control handler error: " << e.what();
+        }
+    }
+}
+
+void IngestPipeline::note_enqueued(Shard& shard) {
+    enqueued_.fetch_add(1, std::memory_order_relaxed);
+
+    const std::size_t depth = shard.queue.size_approx();
+    std::size_t prev = shard.max_depth.load(std::memory_order_relaxed);
+    while (depth > prev &&
+           !shard.max_depth.compare_exchange_weak(prev, depth, std::memory_order_relaxed)) {
+    }
+
+    shard.items_signal.fetch_add(1, std::memory_order_release);
+    shard.items_signal.notify_one();
+}
+
+void IngestPipeline::note_drop(std::atomic<uint64_t>& counter, const char* what) {
+    const uint64_t n = counter.fetch_add(1, std::memory_order_relaxed) + 1;
+    // Log on 1, 2, 4, 8, ... drops so a sustained overflow does not flood stdout.
+    if ((n & (n - 1)) == 0) {
+        LOG_WARN(Ingest) << "[INGEST] Queue full (" << overflowPolicyName(opts_.overflow)
+                         << "): dropped " << n << " " << what << " message(s) so far";
+    }
+}
@@ -0,0 +1,346 @@
+#include "Journal.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+#include <zlib.h>
+#include "Logger.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr char BLOCK_MAGIC[4] = {'C', 'J', 'B', '1'};
+constexpr std::size_t BLOCK_HEADER = 4 + 4 * sizeof(uint32_t);
+constexpr std::size_t RECORD_HEADER = sizeof(int64_t) + sizeof(uint32_t);
+
+// Flush early once a batch reaches this size.
+constexpr std::size_t BATCH_SOFT_LIMIT = 256u << 10;
+// Drop records rather than grow the batch past this while the flusher is stuck.
+constexpr std::size_t BATCH_HARD_LIMIT = 16u << 20;
+
+template <typename T>
+void put(std::string& out, T v) {
+    out.append(reinterpret_cast<const char*>(&v), sizeof(v));
+}
+
+template <typename T>
+T get(const char* p) {
+    T v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+bool write_all(int fd, const char* p, std::size_t n) {
+    while (n > 0) {
+        const ssize_t w = ::write(fd, p, n);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        p += w;
+        n -= static_cast<std::size_t>(w);
+    }
+    return true;
+}
+
+} // namespace
+
+Journal::Journal(JournalOptions opts)
+    : opts_(std::move(opts))
+{
+}
+
+Journal::~Journal() {
+    stop();
+}
+
+bool Journal::start(std::string& err) {
+    {
+        std::lock_guard<std::mutex> lk(mu_);
+        if (running_) return true;
+    }
+    std::error_code ec;
+    fs::create_directories(opts_.dir, ec);
+    if (ec) {
+        err = "create " + opts_.dir + ": " + ec.message();
+        return false;
+    }
+    if (!open_segment(err)) return false;
+
+    {
+        std::lock_guard<std::mutex> lk(mu_);
+        running_ = true;
+    }
+    thread_ = std::thread(&Journal::run, this);
+    LOG_INFO(Ingest) << "[JOURNAL] Writing to " << opts_.dir << " (flush every " << opts_.flush_ms
+                     << " ms, segments of " << (opts_.segment_bytes >> 20) << " MiB, keeping at most "
+                     << (opts_.max_bytes >> 20) << " MiB / " << opts_.max_age_h << " h; 0 = no limit)";
+    return true;
+}
+
+void Journal::stop() {
+    {
+        std::lock_guard<std::mutex> lk(mu_);
+        if (!running_) return;
+        running_ = false;
+    }
+    cv_.notify_all();
+    if (thread_.joinable()) thread_.join();
+    if (fd_ >= 0) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+
+    auto s = stats();
+    LOG_INFO(Ingest) << "[JOURNAL] Stopped. records=" << s.records << " blocks=" << s.blocks
+                     << " raw_bytes=" << s.raw_bytes << " disk_bytes=" << s.disk_bytes
+                     << " errors=" << s.errors << " dropped=" << s.dropped << " pruned=" << s.pruned;
+}
+
+void Journal::append(std::chrono::system_clock::time_point received, std::string_view payload) {
+    using namespace std::chrono;
+    const int64_t us = duration_cast<microseconds>(received.time_since_epoch()).count();
+
+    bool flush_now = false;
+    {
+        std::lock_guard<std::mutex> lk(mu_);
+        if (!running_) return;
+        if (batch_.size() + RECORD_HEADER + payload.size() > BATCH_HARD_LIMIT) {
+            const uint64_t n = dropped_.fetch_add(1, std::memory_order_relaxed) + 1;
+            // Log on 1, 2, 4, 8, ... drops so a stuck disk does not flood stdout.
+            if ((n & (n - 1)) == 0) {
+                LOG_WARN(Ingest) << "[JOURNAL] Batch full (" << (BATCH_HARD_LIMIT >> 20)
+                                 << " MiB not yet written): dropped " << n << " record(s) so far";
+            }
+            return;
+        }
+        put<int64_t>(batch_, us);
+        put<uint32_t>(batch_, static_cast<uint32_t>(payload.size()));
+        batch_.append(payload.data(), payload.size());
+        ++batch_records_;
+        flush_now = batch_.size() >= BATCH_SOFT_LIMIT;
+    }
+    if (flush_now) cv_.notify_one();
+}
+
+JournalStats Journal::stats() const {
+    JournalStats s;
+    s.records    = records_.load(std::memory_order_relaxed);
+    s.blocks     = blocks_.load(std::memory_order_relaxed);
+    s.raw_bytes  = raw_bytes_.load(std::memory_order_relaxed);
+    s.disk_bytes = disk_bytes_.load(std::memory_order_relaxed);
+    s.errors     = errors_.load(std::memory_order_relaxed);
+    s.dropped    = dropped_.load(std::memory_order_relaxed);
+    s.pruned     = pruned_.load(std::memory_order_relaxed);
+    return s;
+}
+
+void Journal::run() {
+    // Double buffer: the flusher owns `pending` while producers fill batch_.
+    std::string pending;
+    std::unique_lock<std::mutex> lk(mu_);
+    for (;;) {
+        cv_.wait_for(lk, std::chrono::milliseconds(opts_.flush_ms),
+                     [this] { return !running_ || batch_.size() >= BATCH_SOFT_LIMIT; });
+        const bool stopping = !running_;
+
+        pending.clear();
+        pending.swap(batch_);
+        const uint32_t n = batch_records_;
+        batch_records_ = 0;
+
+        lk.unlock();
+        if (n > 0) write_block(pending, n);
+        lk.lock();
+
+        if (stopping) break;
+    }
+}
+
+bool Journal::open_segment(std::string& err) {
+    using namespace std::chrono;
+    const auto ms = duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count();
+    char name[64];
+    std::snprintf(name, sizeof(name), "journal-%013lld-%06u.wal", static_cast<long long>(ms),
+                  segment_seq_++);
+    const std::string path = (fs::path(opts_.dir) / name).string();
+
+    const int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        err = "open " + path + ": " + std::strerror(errno);
+        return false;
+    }
+    // Make the new file's directory entry durable too.
+    const int dfd = ::open(opts_.dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dfd >= 0) {
+        ::fsync(dfd);
+        ::close(dfd);
+    }
+
+    if (fd_ >= 0) ::close(fd_);
+    fd_ = fd;
+    segment_path_ = path;
+    segment_size_ = 0;
+    prune();
+    return true;
+}
+
+void Journal::prune() {
+    if (opts_.max_bytes == 0 && opts_.max_age_h == 0) return;
+
+    struct Segment {
+        fs::path  path;
+        uintmax_t bytes;
+        long long start_ms;
+    };
+    std::error_code ec;
+    std::vector<Segment> segments;
+    uintmax_t total = 0;
+    for (const auto& e : fs::directory_iterator(opts_.dir, ec)) {
+        long long ms = 0;
+        unsigned seq = 0;
+        const std::string name = e.path().filename().string();
+        if (!e.is_regular_file() || std::sscanf(name.c_str(), "journal-%lld-%u.wal", &ms, &seq) != 2) continue;
+        std::error_code size_ec;
+        const uintmax_t bytes = e.file_size(size_ec);
+        segments.push_back({e.path(), size_ec ? 0 : bytes, ms});
+        total += segments.back().bytes;
+    }
+    if (ec) {
+        LOG_WARN(Ingest) << "[JOURNAL] Retention skipped, cannot read " << opts_.dir << ": " << ec.message();
+        return;
+    }
+    std::sort(segments.begin(), segments.end(), [](const Segment& a, const Segment& b) { return a.path < b.path; });
+
+    using namespace std::chrono;
+    const long long now_ms = duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count();
+    const long long max_age_ms = static_cast<long long>(opts_.max_age_h) * 3600 * 1000;
+    std::size_t removed = 0;
+    // A segment's last record is no later than the next segment's start.
+    for (std::size_t i = 0; i + 1 < segments.size(); ++i) {
+        const Segment& s = segments[i];
+        if (s.path == segment_path_) break;
+        const bool over_size = opts_.max_bytes && total > opts_.max_bytes;
+        const bool too_old   = opts_.max_age_h && now_ms - segments[i + 1].start_ms > max_age_ms;
+        if (!over_size && !too_old) break;
+        if (!fs::remove(s.path, ec)) {
+            LOG_WARN(Ingest) << "[JOURNAL] Cannot delete " << s.path.string() << ": " << ec.message();
+            break;
+        }
+        total -= s.bytes;
+        ++removed;
+    }
+    if (removed) {
+        pruned_.fetch_add(removed, std::memory_order_relaxed);
+        LOG_INFO(Ingest) << "[JOURNAL] Retention: deleted " << removed << " old segment(s), "
+                         << (total >> 20) << " MiB kept";
+    }
+}
+
+void Journal::write_block(const std::string& raw, uint32_t records) {
+    if (segment_size_ >= opts_.segment_bytes) {
+        std::string err;
+        if (!open_segment(err)) {
+            LOG_ERROR(Ingest) << "[JOURNAL] " << err;
+            errors_.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    // Header and deflated body in one buffer, one write().
+    uLongf comp_len = compressBound(static_cast<uLong>(raw.size()));
+    std::string block(BLOCK_HEADER + comp_len, '\0');
+    char* body = block.data() + BLOCK_HEADER;
+    if (compress2(reinterpret_cast<Bytef*>(body), &comp_len, reinterpret_cast<const Bytef*>(raw.data()),
+                  static_cast<uLong>(raw.size()), Z_BEST_SPEED) != Z_OK) {
+        LOG_ERROR(Ingest) << "[JOURNAL] Compression failed; dropped " << records << " record(s)";
+        errors_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    block.resize(BLOCK_HEADER + comp_len);
+
+    const uint32_t fields[4] = {static_cast<uint32_t>(raw.size()), static_cast<uint32_t>(comp_len),
+                                static_cast<uint32_t>(crc32(0L, reinterpret_cast<const Bytef*>(body), comp_len)),
+                                records};
+    std::memcpy(block.data(), BLOCK_MAGIC, sizeof(BLOCK_MAGIC));
+    std::memcpy(block.data() + sizeof(BLOCK_MAGIC), fields, sizeof(fields));
+
+    if (fd_ < 0 || !write_all(fd_, block.data(), block.size()) || ::fdatasync(fd_) != 0) {
+        LOG_ERROR(Ingest) << "[JOURNAL] Write failed: " << std::strerror(errno) << "; dropped "
+                          << records << " record(s)";
+        errors_.fetch_add(1, std::memory_order_relaxed);
+        // A partial block ends the segment for readers: continue in a new one.
+        segment_size_ = opts_.segment_bytes;
+        return;
+    }
+
+    segment_size_ += block.size();
+    records_.fetch_add(records, std::memory_order_relaxed);
+    blocks_.fetch_add(1, std::memory_order_relaxed);
+    raw_bytes_.fetch_add(raw.size(), std::memory_order_relaxed);
+    disk_bytes_.fetch_add(block.size(), std::memory_order_relaxed);
+}
+
+bool Journal::read(const std::string& dir, const Visitor& visit, std::string& err) {
+    std::error_code ec;
+    std::vector<fs::path> segments;
+    for (const auto& e : fs::directory_iterator(dir, ec)) {
+        const std::string name = e.path().filename().string();
+        if (e.is_regular_file() && name.rfind("journal-", 0) == 0 && e.path().extension() == ".wal")
+            segments.push_back(e.path());
+    }
+    if (ec) {
+        err = "read " + dir + ": " + ec.message();
+        return false;
+    }
+    std::sort(segments.begin(), segments.end());
+
+    std::string comp, raw;
+    for (const auto& path : segments) {
+        std::ifstream in(path, std::ios::binary);
+        char head[BLOCK_HEADER];
+        while (in.read(head, sizeof(head))) {
+            const auto raw_len  = get<uint32_t>(head + 4);
+            const auto comp_len = get<uint32_t>(head + 8);
+            const auto crc      = get<uint32_t>(head + 12);
+            if (std::memcmp(head, BLOCK_MAGIC, sizeof(BLOCK_MAGIC)) != 0) {
+                LOG_WARN(Ingest) << "[JOURNAL] " << path.string() << ": bad block header, skipping rest of segment";
+                break;
+            }
+            comp.resize(comp_len);
+            if (!in.read(comp.data(), comp_len)) {
+                LOG_WARN(Ingest) << "[JOURNAL] " << path.string() << ": truncated block at end of segment";
+                break;
+            }
+            if (crc32(0L, reinterpret_cast<const Bytef*>(comp.data()), comp_len) != crc) {
+                LOG_WARN(Ingest) << "[JOURNAL] " << path.string() << ": checksum mismatch, skipping rest of segment";
+                break;
+            }
+            raw.resize(raw_len);
+            uLongf out_len = raw_len;
+            if (uncompress(reinterpret_cast<Bytef*>(raw.data()), &out_len,
+                           reinterpret_cast<const Bytef*>(comp.data()), comp_len) != Z_OK ||
+                out_len != raw_len) {
+                LOG_WARN(Ingest) << "[JOURNAL] " << path.string() << ": undecodable block, skipping rest of segment";
+                break;
+            }
+
+            for (std::size_t off = 0; off + RECORD_HEADER <= raw.size();) {
+                const auto us  = get<int64_t>(raw.data() + off);
+                const auto len = get<uint32_t>(raw.data() + off + sizeof(int64_t));
+                off += RECORD_HEADER;
+                if (len > raw.size() - off) break;
+                visit(std::chrono::system_clock::time_point(std::chrono::microseconds(us)),
+                      std::string_view(raw.data() + off, len));
+                off += len;
+            }
+        }
+    }
+    return true;
+}
@@ -1,15 +1,110 @@
 #include "JsonUtils.hpp"
+#include <algorithm>
 
 namespace jsonu {
 
-std::optional<json> parse(const std::string& s, std::string& err) {
+Arena& Arena::local() {
+    static thread_local Arena a;
+    return a;
+}
+
+void* Arena::allocate(std::size_t n, std::size_t align) {
+    if (depth_ == 0) return ::operator new(n);   // no scope: plain heap
+
+    for (;;) {
+        if (cur_ < blocks_.size()) {
+            Block& b = blocks_[cur_];
+            const std::size_t off = (used_ + align - 1) & ~(align - 1);
+            if (off + n <= b.size) {
+                used_ = off + n;
+                return b.mem.get() + off;
+            }
+            ++cur_;
+            used_ = 0;
+            continue;
+        }
+        const std::size_t size = std::max(BLOCK, n + align);
+        blocks_.push_back(Block{std::make_unique<std::byte[]>(size), size});
+    }
+}
+
+void Arena::deallocate(void* p) noexcept {
+    if (!owns(p)) ::operator delete(p);   // from the no-scope fallback
+}
+
+bool Arena::owns(const void* p) const noexcept {
+    const auto* b = static_cast<const std::byte*>(p);
+    for (const Block& blk : blocks_)
+        if (b >= blk.mem.get() && b < blk.mem.get() + blk.size) return true;
+    return false;
+}
+
+std::size_t Arena::capacity() const {
+    std::size_t n = 0;
+    for (const Block& blk : blocks_) n += blk.size;
+    return n;
+}
+
+// Rewind to the first block. Blocks of the regular size are kept for the
+// next message; oversized ones (a single huge payload) are released.
+void Arena::reset() {
+    blocks_.erase(std::remove_if(blocks_.begin(), blocks_.end(),
+                                 [](const Block& b) { return b.size > BLOCK; }),
+                  blocks_.end());
+    cur_ = 0;
+    used_ = 0;
+}
+
+std::optional<arena_json> parse(std::string_view s, std::string& err) {
     try {
-        auto j = json::parse(s);
-        return j;
+        return arena_json::parse(s);
     } catch (const std::exception& e) {
         err = e.what();
         return std::nullopt;
     }
 }
 
+void write(jsonw::Writer& w, const arena_json& j) {
+    switch (j.type()) {
+    case arena_json::value_t::object: {
+        w.raw('{');
+        bool first = true;
+        for (const auto& [k, v] : j.get_ref<const arena_json::object_t&>()) {
+            if (!first) w.raw(',');
+            first = false;
+            w.value(std::string_view(k.data(), k.size()));
+            w.raw(':');
+            write(w, v);
+        }
+        w.raw('}');
+        return;
+    }
+    case arena_json::value_t::array: {
+        w.raw('[');
+        bool first = true;
+        for (const arena_json& v : j.get_ref<const arena_json::array_t&>()) {
+            if (!first) w.raw(',');
+            first = false;
+            write(w, v);
+        }
+        w.raw(']');
+        return;
+    }
+    case arena_json::value_t::string: {
+        const auto& s = j.get_ref<const arena_string&>();
+        w.value(std::string_view(s.data(), s.size()));
+        return;
+    }
+    case arena_json::value_t::boolean:         w.value(j.get<bool>()); return;
+    case arena_json::value_t::number_integer:  w.value(j.get<std::int64_t>()); return;
+    case arena_json::value_t::number_unsigned: w.value(j.get<std::uint64_t>()); return;
+    case arena_json::value_t::number_float:    w.value(j.get<double>()); return;
+    case arena_json::value_t::null:
+    case arena_json::value_t::binary:      // never produced by parse()
+    case arena_json::value_t::discarded:
+        w.raw(std::string_view("null"));
+        return;
+    }
+}
+
 } // namespace jsonu
@@ -0,0 +1,61 @@
+#include "JsonWriter.hpp"
+#include <array>
+#include <cmath>
+#include <nlohmann/json.hpp>
+
+namespace jsonw {
+
+void Writer::value(double v) {
+    if (!std::isfinite(v)) {
+        raw(std::string_view("null"));
+        return;
+    }
+    // Same routine (and buffer size) nlohmann's serializer uses for doubles,
+    // so the digits match dump() exactly.
+    std::array<char, 64> tmp;
+    char* end = ::nlohmann::detail::to_chars(tmp.data(), tmp.data() + tmp.size(), v);
+    out_.append(tmp.data(), static_cast<std::size_t>(end - tmp.data()));
+}
+
+void Writer::value(std::string_view s) {
+    static constexpr char HEX[] = "0123456789abcdef";
+
+    raw('"');
+    std::size_t run = 0;  // start of the pending unescaped run
+    for (std::size_t i = 0; i < s.size(); ++i) {
+        const auto c = static_cast<unsigned char>(s[i]);
+        if (c >= 0x20 && c != '"' && c != '\\') continue;
+
+        out_.append(s.data() + run, i - run);
+        run = i + 1;
+        switch (c) {
+            case '"':  raw(std::string_view("\\\"")); break;
+            case '\\': raw(std::string_view("\\\\")); break;
+            case '\b': raw(std::string_view("\\b"));  break;
+            case '\f': raw(std::string_view("\\f"));  break;
+            case '\n': raw(std::string_view("\\n"));  break;
+            case '\r': raw(std::string_view("\\r"));  break;
+            case '\t': raw(std::string_view("\\t"));  break;
+            default: {
+                const char esc[] = {'\\', 'u', '0', '0', HEX[c >> 4], HEX[c & 0xF]};
+                raw(std::string_view(esc, sizeof(esc)));
+            }
+        }
+    }
+    out_.append(s.data() + run, s.size() - run);
+    raw('"');
+}
+
+namespace detail {
+
+std::string& scratch() {
+    thread_local std::string buf = [] {
+        std::string s;
+        s.reserve(4096);
+        return s;
+    }();
+    return buf;
+}
+
+} // namespace detail
+} // namespace jsonw
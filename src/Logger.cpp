@@ -0,0 +1,245 @@
+#include "Logger.hpp"
+#include "IngestQueue.hpp"
+#include <atomic>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <optional>
+#include <thread>
+
+namespace logx {
+
+namespace {
+
+constexpr std::size_t QUEUE_CAPACITY = 2048;
+constexpr int CAT_COUNT = static_cast<int>(Cat::COUNT);
+
+struct RateWindow {
+    std::atomic<int64_t>  second{-1};
+    std::atomic<uint32_t> count{0};
+    std::atomic<uint64_t> suppressed{0};
+};
+
+struct LevelSlot {
+    std::atomic<int> v{static_cast<int>(Level::Info)};
+};
+
+std::array<LevelSlot, CAT_COUNT> g_levels;
+std::array<RateWindow, CAT_COUNT> g_rate;
+std::atomic<uint32_t> g_rate_limit{100};
+
+BoundedMpmcQueue<detail::Record> g_queue(QUEUE_CAPACITY);
+std::atomic<bool> g_async{false};
+std::atomic<bool> g_stop{false};
+std::thread g_drain;
+
+std::atomic<uint64_t> g_written{0};
+std::atomic<uint64_t> g_dropped{0};
+std::atomic<uint64_t> g_suppressed{0};
+
+void write_record(const detail::Record& r) {
+    std::FILE* out = r.lv >= Level::Warn ? stderr : stdout;
+    std::fwrite(r.text, 1, r.len, out);
+    g_written.fetch_add(1, std::memory_order_relaxed);
+}
+
+void drain_loop() {
+    using namespace std::chrono_literals;
+    detail::Record r;
+    uint64_t dropped_reported = 0;
+    for (;;) {
+        bool any = false;
+        while (g_queue.try_pop(r)) {
+            write_record(r);
+            any = true;
+        }
+        if (any) {
+            std::fflush(stdout);
+            std::fflush(stderr);
+        }
+
+        const uint64_t dropped = g_dropped.load(std::memory_order_relaxed);
+        if (dropped != dropped_reported) {
+            std::fprintf(stderr, "[LOG] %llu line(s) dropped (ring buffer full)\n",
+                         static_cast<unsigned long long>(dropped - dropped_reported));
+            dropped_reported = dropped;
+        }
+
+        if (g_stop.load(std::memory_order_acquire)) {
+            while (g_queue.try_pop(r)) write_record(r);
+            std::fflush(stdout);
+            std::fflush(stderr);
+            return;
+        }
+        if (!any) std::this_thread::sleep_for(20ms);
+    }
+}
+
+std::optional<Level> levelFromString(const std::string& s) {
+    if (s == "debug") return Level::Debug;
+    if (s == "info")  return Level::Info;
+    if (s == "warn")  return Level::Warn;
+    if (s == "error") return Level::Error;
+    if (s == "off")   return Level::Off;
+    return std::nullopt;
+}
+
+std::optional<Cat> catFromString(const std::string& s) {
+    for (int i = 0; i < CAT_COUNT; ++i)
+        if (s == catName(static_cast<Cat>(i))) return static_cast<Cat>(i);
+    return std::nullopt;
+}
+
+// "info,data=debug,pub=warn"
+void apply_level_spec(const std::string& spec) {
+    std::size_t start = 0;
+    while (start <= spec.size()) {
+        std::size_t end = spec.find(',', start);
+        if (end == std::string::npos) end = spec.size();
+        const std::string item = spec.substr(start, end - start);
+        start = end + 1;
+        if (item.empty()) continue;
+
+        const std::size_t eq = item.find('=');
+        if (eq == std::string::npos) {
+            if (auto lv = levelFromString(item)) set_level(*lv);
+            else std::fprintf(stderr, "[LOG] Ignoring unknown level '%s'\n", item.c_str());
+            continue;
+        }
+        auto cat = catFromString(item.substr(0, eq));
+        auto lv  = levelFromString(item.substr(eq + 1));
+        if (cat && lv) set_level(*cat, *lv);
+        else std::fprintf(stderr, "[LOG] Ignoring invalid LOG_LEVEL entry '%s'\n", item.c_str());
+    }
+}
+
+} // namespace
+
+const char* levelName(Level lv) {
+    switch (lv) {
+        case Level::Debug: return "debug";
+        case Level::Info:  return "info";
+        case Level::Warn:  return "warn";
+        case Level::Error: return "error";
+        case Level::Off:   return "off";
+    }
+    return "unknown";
+}
+
+const char* catName(Cat c) {
+    switch (c) {
+        case Cat::MQTT:   return "mqtt";
+        case Cat::Ingest: return "ingest";
+        case Cat::Data:   return "data";
+        case Cat::Pub:    return "pub";
+        case Cat::Shift:  return "shift";
+        case Cat::Proc:   return "proc";
+        case Cat::COUNT:  break;
+    }
+    return "unknown";
+}
+
+void set_level(Cat c, Level lv) {
+    g_levels[static_cast<int>(c)].v.store(static_cast<int>(lv), std::memory_order_relaxed);
+}
+
+void set_level(Level lv) {
+    for (auto& l : g_levels) l.v.store(static_cast<int>(lv), std::memory_order_relaxed);
+}
+
+void set_rate_limit(uint32_t lines_per_s) {
+    g_rate_limit.store(lines_per_s, std::memory_order_relaxed);
+}
+
+void init_from_env() {
+    if (const char* v = std::getenv("LOG_LEVEL"))
+        apply_level_spec(v);
+    if (const char* v = std::getenv("LOG_RATE_LIMIT")) {
+        char* end = nullptr;
+        const unsigned long n = std::strtoul(v, &end, 10);
+        if (end != v && *end == '\0') set_rate_limit(static_cast<uint32_t>(n));
+        else std::fprintf(stderr, "[LOG] Ignoring invalid LOG_RATE_LIMIT=%s\n", v);
+    }
+
+    if (g_async.exchange(true)) return;
+    g_stop.store(false);
+    g_drain = std::thread(drain_loop);
+}
+
+void shutdown() {
+    if (!g_async.load()) return;
+    g_stop.store(true, std::memory_order_release);
+    if (g_drain.joinable()) g_drain.join();
+    g_async.store(false);
+}
+
+bool should_log(Level lv, Cat c) {
+    const int ci = static_cast<int>(c);
+    if (static_cast<int>(lv) < g_levels[ci].v.load(std::memory_order_relaxed))
+        return false;
+
+    const uint32_t limit = g_rate_limit.load(std::memory_order_relaxed);
+    if (limit == 0) return true;
+
+    RateWindow& rw = g_rate[ci];
+    const int64_t sec = std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+    int64_t seen = rw.second.load(std::memory_order_relaxed);
+    if (seen != sec && rw.second.compare_exchange_strong(seen, sec, std::memory_order_relaxed)) {
+        rw.count.store(0, std::memory_order_relaxed);
+        const uint64_t sup = rw.suppressed.exchange(0, std::memory_order_relaxed);
+        if (sup > 0) {
+            Line(Level::Warn, c) << "[LOG] " << catName(c) << ": " << sup
+                                 << " line(s) suppressed by rate limit";
+        }
+    }
+
+    if (rw.count.fetch_add(1, std::memory_order_relaxed) < limit)
+        return true;
+
+    rw.suppressed.fetch_add(1, std::memory_order_relaxed);
+    g_suppressed.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+Stats stats() {
+    Stats s;
+    s.written         = g_written.load(std::memory_order_relaxed);
+    s.dropped_full    = g_dropped.load(std::memory_order_relaxed);
+    s.suppressed_rate = g_suppressed.load(std::memory_order_relaxed);
+    return s;
+}
+
+void detail::commit(Record& rec) {
+    if (!g_async.load(std::memory_order_acquire)) {
+        write_record(rec);
+        return;
+    }
+    if (!g_queue.try_push(std::move(rec)))
+        g_dropped.fetch_add(1, std::memory_order_relaxed);
+}
+
+void Line::append(const char* p, std::size_t n) {
+    // Keep room for "...\n"
+    constexpr std::size_t room = LOG_LINE_MAX - 4;
+    if (truncated_) return;
+    if (rec_.len + n > room) {
+        n = room - rec_.len;
+        truncated_ = true;
+    }
+    std::memcpy(rec_.text + rec_.len, p, n);
+    rec_.len = static_cast<uint16_t>(rec_.len + n);
+}
+
+Line::~Line() {
+    if (truncated_) {
+        std::memcpy(rec_.text + rec_.len, "...", 3);
+        rec_.len += 3;
+    }
+    rec_.text[rec_.len++] = '\n';
+    detail::commit(rec_);
+}
+
+} // namespace logx
@@ -1,65 +1,613 @@
 #include "MessageProcessor.hpp"
+#include "CounterFields.hpp"
+#include "DeviceRegistry.hpp"
 #include "JsonUtils.hpp"
+#include "JsonWriter.hpp"
+#include "LineTable.hpp"
 #include "Shift.hpp"
+#include "StateStore.hpp"
 #include "TimeUtils.hpp"
+#include "TopicRegistry.hpp"
+#include "Logger.hpp"
+#include "Metrics.hpp"
+#include <algorithm>
 #include <memory>
+#include <type_traits>
+#include <span>
 #include <sstream>
-#include <mutex>
-#include <atomic>
-#include <iostream>
-using json = nlohmann::json;
 
-static std::atomic<int> g_last_global_shift { -1 };
+// Processor state is sharded per worker thread (see IngestPipeline): every
+// states_ map below is thread_local, so each shard owns the lines routed to it
+// and no lock is needed. Shift boundaries reach each shard as a ShiftChange
+// control item (see close_shift).
 
-bool detect_global_shift_change(int currentShift)
+MessageContext make_message_context(std::chrono::system_clock::time_point received, int line)
 {
-    int prev = g_last_global_shift.load(std::memory_order_relaxed);
-    if (prev == currentShift)
-        return false;
-
-    // First run or shift change
-    g_last_global_shift.store(currentShift, std::memory_order_relaxed);
-    return true;
+    const std::time_t t = std::chrono::system_clock::to_time_t(received);
+
+    MessageContext ctx;
+    ctx.received    = received;
+    ctx.shift       = shift_at(t, line);
+    ctx.shift_start = shift_start_at(t, line);
+    iso8601_utc_format(received, ctx.ts.data);
+    return ctx;
 }
 
+/**
+ * Line states of one processor on the calling shard, keyed by lineID, in a
+ * flat cache-aligned LineTable.
+ *
+ * A line can have several physical devices of the processor's type: each
+ * devEUI keeps its own state (its counters' last readings must not mix),
+ * and line_total() sums them (S::merge) for the line's publications and
+ * shift summary. The first device of a line lives in the table slot itself;
+ * uplinks without devEUI count as one device (devices::NONE).
+ *
+ * A device whose message crosses a shift boundary before the ShiftChange
+ * reaches the shard (the scheduler posts it only once the boundary has
+ * passed) starts the new shift through begin_shift(), which parks the
+ * closed shift's state for retire() instead of dropping it.
+ *
+ * Each device is mirrored into its pstore slot when persistence is enabled:
+ * get() restores a state saved during the current shift instance the first
+ * time the device shows up (i.e. after a restart), save() writes the updated
+ * state back in place (a memcpy, no syscall). A parked closed state has a
+ * second slot (negative kind), saved under the shift it was parked in and
+ * invalidated once retire() took it, so a restart before the ShiftChange
+ * still reports it.
+ */
+template <typename S>
+class LineStates {
+    static_assert(std::is_trivially_copyable_v<S>, "persisted state must be trivially copyable");
+    static_assert(sizeof(S) <= pstore::SLOT_PAYLOAD, "state does not fit a pstore slot");
+
+public:
+    struct Entry {
+        S st{};
+        S closed{};   // the last shift's state, rolled over before retire() took it
+        bool closed_dirty = false;   // closed changed since it was last saved
+        devices::Id device = devices::NONE;
+        pstore::Slot *slot = nullptr;
+        pstore::Slot *closed_slot = nullptr;
+        dq::LineCounters *quality = nullptr;   // the line's; set when the processor names delta fields
+    };
+
+    explicit LineStates(DeviceType kind, std::span<const std::string_view> delta_fields = {})
+        : kind_(kind), delta_fields_(delta_fields) {}
+
+    Entry &get(int line, devices::Id device, const MessageContext &ctx)
+    {
+        auto [l, new_line] = lines_.try_emplace(line);
+        if (!new_line) {
+            if (l->first.device == device) return l->first;
+            for (Entry &e : l->more)
+                if (e.device == device) return e;
+        }
+
+        Entry &e = new_line ? l->first : l->more.emplace_back();
+        e.device = device;
+        e.slot = pstore::slot(static_cast<int>(kind_), line, devices::eui(device));
+        pstore::load(e.slot, &e.st, sizeof(S), ctx.shift_start);
+        e.closed_slot = pstore::slot(-static_cast<int>(kind_), line, devices::eui(device));
+        pstore::load(e.closed_slot, &e.closed, sizeof(S), ctx.shift_start);
+        if (!delta_fields_.empty()) e.quality = &dq::line(static_cast<int>(kind_), line, delta_fields_);
+        if (!new_line) {
+            LOG_INFO(Proc) << "[DEVICES] " << deviceTypeName(kind_) << " line " << line << ": device "
+                           << devices::eui_hex(devices::eui(device)) << " is device #" << l->more.size() + 1
+                           << " of the line";
+        }
+        return e;
+    }
+
+    /**
+     * Put the device on `shift` if its state is empty or from another shift,
+     * and return true so the caller seeds the fresh state. A state from
+     * another shift moves to e.closed, where the next retire() finds it.
+     */
+    bool begin_shift(Entry &e, int shift)
+    {
+        if (e.st.initialized && e.st.shift == shift) return false;
+        if (e.st.initialized) {
+            e.closed = e.st;
+            e.closed_dirty = true;
+        }
+        e.st = S{};
+        e.st.initialized = true;
+        e.st.shift = shift;
+        return true;
+    }
+
+    void save(Entry &e, const MessageContext &ctx)
+    {
+        if (e.slot) pstore::save(e.slot, &e.st, sizeof(S), ctx.shift_start);
+        if (e.closed_dirty && e.closed_slot) pstore::save(e.closed_slot, &e.closed, sizeof(S), ctx.shift_start);
+        e.closed_dirty = false;
+    }
+
+    /**
+     * The line's state in `shift`: its devices' states in that shift merged,
+     * or a default S if it has none. With one device, that device's state.
+     */
+    S line_total(int line, int shift)
+    {
+        S total{};
+        bool any = false;
+        if (Line *l = lines_.find(line)) {
+            l->each([&](Entry &e) {
+                if (!e.st.initialized || e.st.shift != shift) return;
+                if (any) total.merge(e.st);
+                else total = e.st;
+                any = true;
+            });
+        }
+        return total;
+    }
+
+    /**
+     * Retire every line selected by `applies` that has devices with a closed
+     * state (parked by begin_shift) or still in a shift other than
+     * keep_shift: those accumulators, merged, go into `out` as JSON from
+     * `summarize(st)`, and are reset in place, so each device's next message
+     * starts the new shift. Other lines and devices are untouched.
+     */
+    template <typename Pred, typename Summarize>
+    void retire(int keep_shift, Pred applies, std::string_view device, Summarize summarize,
+                std::vector<DeviceSnapshot> &out)
+    {
+        lines_.for_each([&](int line, Line &l) {
+            if (!applies(line)) return;
+            S total{};
+            bool any = false;
+            auto take = [&](S &st) {
+                if (any) total.merge(st);
+                else total = st;
+                any = true;
+                st = S{};
+            };
+            l.each([&](Entry &e) {
+                if (e.closed.initialized) {
+                    take(e.closed);
+                    // Reported: a restart must not restore it (no shift starts at 0).
+                    if (e.closed_slot) pstore::save(e.closed_slot, &e.closed, sizeof(S), 0);
+                    e.closed_dirty = false;
+                }
+                if (e.st.initialized && e.st.shift != keep_shift) take(e.st);
+            });
+            if (any) out.push_back(DeviceSnapshot{line, device, summarize(total)});
+        });
+    }
+
+    void clear() { lines_.clear(); }
+
+private:
+    struct Line {
+        Entry first;
+        std::vector<Entry> more;   // further devices of the line, rare
+
+        template <typename F>
+        void each(F f)
+        {
+            f(first);
+            for (Entry &e : more) f(e);
+        }
+    };
+
+    DeviceType kind_;
+    std::span<const std::string_view> delta_fields_;
+    LineTable<Line> lines_;
+};
+
+static void publish(PublicationSink &sink, std::string_view topic, const jsonu::arena_json &j)
+{
+    metrics::Timer t(metrics::registry().serialize);
+    sink.emit(topic, [&](jsonw::Writer &w) { jsonu::write(w, j); });
+}
 
+template <typename T, typename... Ms>
+static void publish(PublicationSink &sink, std::string_view topic, const T &out,
+                    const jsonw::Schema<T, Ms...> &schema)
+{
+    metrics::Timer t(metrics::registry().serialize);
+    sink.add(topic, out, schema);
+}
 
-static Publication make_pub(const std::string &topic, const json &j)
+/** Alarm word publication: its state is the alarm value. */
+template <typename T, typename... Ms>
+static void publish_alarm(PublicationSink &sink, std::string_view topic, const T &out,
+                          const jsonw::Schema<T, Ms...> &schema)
 {
-    return Publication{topic, j.dump()};
+    metrics::Timer t(metrics::registry().serialize);
+    sink.add(topic, out, schema, out.alarms);
 }
 
+// ============================================================================
+// Output schemas
+//
+// One struct per published payload, members named after their JSON keys and
+// listed in key (byte) order; jsonw writes them exactly as json::dump() did.
+// Member types match the values the processors used to assign; timestamps
+// are views of the message's IsoTimestamp.
+// ============================================================================
+namespace {
+
+/** .../alarms of PH1, PH2, Salida_secador, Esmalte, Salida_horno */
+struct AlarmsOut {
+    int              alarms;
+    std::string_view timestamp_device;
+};
+constexpr auto ALARMS_SCHEMA = jsonw::schema(
+    JSONW_FIELD(AlarmsOut, alarms),
+    JSONW_FIELD(AlarmsOut, timestamp_device));
+static_assert(ALARMS_SCHEMA.valid(), "keys must be sorted");
+
+/** entrada_secador/alarms */
+struct AlarmsTsOut {
+    int              alarms;
+    std::string_view ts;
+};
+constexpr auto ALARMS_TS_SCHEMA = jsonw::schema(
+    JSONW_FIELD(AlarmsTsOut, alarms),
+    JSONW_FIELD(AlarmsTsOut, ts));
+static_assert(ALARMS_TS_SCHEMA.valid(), "keys must be sorted");
+
+/** prensa_hidraulica1/production, prensa_hidraulica2/production */
+struct PrensaProdOut {
+    bool             bit15_corruption_cantidadProductos;
+    bool             bit15_corruption_paradas;
+    bool             bit15_corruption_tiempoParadas;
+    uint32_t         cantidadPisadas_min;
+    uint32_t         cantidadPisadas_turno;
+    uint16_t         cantidadProductos_instantaneo;
+    int              cantidadProductos_raw;
+    uint32_t         cantidadProductos_turno;
+    int              maquina_id;
+    uint16_t         paradas_instantaneo;
+    int              paradas_raw;
+    uint32_t         paradas_turno;
+    uint16_t         tiempoParadas_instantaneo;
+    int              tiempoParadas_raw;
+    uint32_t         tiempoParadas_turno_s;
+    uint16_t         tiempoProduccion_ds_instantaneo;
+    uint32_t         tiempoProduccion_turno_s;
+    std::string_view timestamp_device;
+    int              turno;
+};
+constexpr auto PRENSA_PROD_SCHEMA = jsonw::schema(
+    JSONW_FIELD(PrensaProdOut, bit15_corruption_cantidadProductos),
+    JSONW_FIELD(PrensaProdOut, bit15_corruption_paradas),
+    JSONW_FIELD(PrensaProdOut, bit15_corruption_tiempoParadas),
+    JSONW_FIELD(PrensaProdOut, cantidadPisadas_min),
+    JSONW_FIELD(PrensaProdOut, cantidadPisadas_turno),
+    JSONW_FIELD(PrensaProdOut, cantidadProductos_instantaneo),
+    JSONW_FIELD(PrensaProdOut, cantidadProductos_raw),
+    JSONW_FIELD(PrensaProdOut, cantidadProductos_turno),
+    JSONW_FIELD(PrensaProdOut, maquina_id),
+    JSONW_FIELD(PrensaProdOut, paradas_instantaneo),
+    JSONW_FIELD(PrensaProdOut, paradas_raw),
+    JSONW_FIELD(PrensaProdOut, paradas_turno),
+    JSONW_FIELD(PrensaProdOut, tiempoParadas_instantaneo),
+    JSONW_FIELD(PrensaProdOut, tiempoParadas_raw),
+    JSONW_FIELD(PrensaProdOut, tiempoParadas_turno_s),
+    JSONW_FIELD(PrensaProdOut, tiempoProduccion_ds_instantaneo),
+    JSONW_FIELD(PrensaProdOut, tiempoProduccion_turno_s),
+    JSONW_FIELD(PrensaProdOut, timestamp_device),
+    JSONW_FIELD(PrensaProdOut, turno));
+static_assert(PRENSA_PROD_SCHEMA.valid(), "keys must be sorted");
+
+/** entrada_secador/production */
+struct EntradaSecadorProdOut {
+    uint32_t         cantidad_arranques;
+    int              maquina_id;
+    uint32_t         tiempo_operacion;
+    std::string_view timestamp_device;
+    int              turno;
+};
+constexpr auto ENTRADA_SECADOR_PROD_SCHEMA = jsonw::schema(
+    JSONW_FIELD(EntradaSecadorProdOut, cantidad_arranques),
+    JSONW_FIELD(EntradaSecadorProdOut, maquina_id),
+    JSONW_FIELD(EntradaSecadorProdOut, tiempo_operacion),
+    JSONW_FIELD(EntradaSecadorProdOut, timestamp_device),
+    JSONW_FIELD(EntradaSecadorProdOut, turno));
+static_assert(ENTRADA_SECADOR_PROD_SCHEMA.valid(), "keys must be sorted");
+
+/** salida_secador/production, esmalte/production */
+struct LineProdOut {
+    uint32_t         cantidad_paradas;
+    uint32_t         cantidad_produccion;
+    int              maquina_id;
+    uint32_t         tiempo_paradas;
+    uint32_t         tiempo_produccion;
+    std::string_view timestamp_device;
+    int              turno;
+};
+constexpr auto LINE_PROD_SCHEMA = jsonw::schema(
+    JSONW_FIELD(LineProdOut, cantidad_paradas),
+    JSONW_FIELD(LineProdOut, cantidad_produccion),
+    JSONW_FIELD(LineProdOut, maquina_id),
+    JSONW_FIELD(LineProdOut, tiempo_paradas),
+    JSONW_FIELD(LineProdOut, tiempo_produccion),
+    JSONW_FIELD(LineProdOut, timestamp_device),
+    JSONW_FIELD(LineProdOut, turno));
+static_assert(LINE_PROD_SCHEMA.valid(), "keys must be sorted");
+
+/** entrada_horno/status */
+struct EntradaHornoStatusOut {
+    uint16_t         raw_grades;
+    int              status;
+    int              timer;
+    std::string_view ts;
+};
+constexpr auto ENTRADA_HORNO_STATUS_SCHEMA = jsonw::schema(
+    JSONW_FIELD(EntradaHornoStatusOut, raw_grades),
+    JSONW_FIELD(EntradaHornoStatusOut, status),
+    JSONW_FIELD(EntradaHornoStatusOut, timer),
+    JSONW_FIELD(EntradaHornoStatusOut, ts));
+static_assert(ENTRADA_HORNO_STATUS_SCHEMA.valid(), "keys must be sorted");
+
+/** entrada_horno/production */
+struct EntradaHornoProdOut {
+    uint32_t         cantidad_fallas;
+    uint32_t         cantidad_paradas;
+    uint32_t         cantidad_produccion;
+    int              maquina_id;
+    uint32_t         tiempo_fallas;
+    uint32_t         tiempo_metrica_for;
+    uint32_t         tiempo_metrica_mcf;
+    uint32_t         tiempo_paradas;
+    std::string_view timestamp_device;
+    int              turno;
+    double           vacio_horno_min;
+};
+constexpr auto ENTRADA_HORNO_PROD_SCHEMA = jsonw::schema(
+    JSONW_FIELD(EntradaHornoProdOut, cantidad_fallas),
+    JSONW_FIELD(EntradaHornoProdOut, cantidad_paradas),
+    JSONW_FIELD(EntradaHornoProdOut, cantidad_produccion),
+    JSONW_FIELD(EntradaHornoProdOut, maquina_id),
+    JSONW_FIELD(EntradaHornoProdOut, tiempo_fallas),
+    JSONW_FIELD(EntradaHornoProdOut, tiempo_metrica_for),
+    JSONW_FIELD(EntradaHornoProdOut, tiempo_metrica_mcf),
+    JSONW_FIELD(EntradaHornoProdOut, tiempo_paradas),
+    JSONW_FIELD(EntradaHornoProdOut, timestamp_device),
+    JSONW_FIELD(EntradaHornoProdOut, turno),
+    JSONW_FIELD(EntradaHornoProdOut, vacio_horno_min));
+static_assert(ENTRADA_HORNO_PROD_SCHEMA.valid(), "keys must be sorted");
+
+/** salida_horno/production */
+struct SalidaHornoProdOut {
+    uint16_t         bancalinos0_instantaneo;
+    uint32_t         bancalinos0_turno;
+    uint16_t         bancalinos1_instantaneo;
+    uint32_t         bancalinos1_turno;
+    uint16_t         bancalinosComb1_instantaneo;
+    uint32_t         bancalinosComb1_turno;
+    uint16_t         bancalinosComb2_instantaneo;
+    uint32_t         bancalinosComb2_turno;
+    int              bancalinosTotal_raw;
+    uint32_t         bancalinosTotal_turno;
+    bool             bit15_corruption_bancalinosTotal;
+    bool             bit15_corruption_cambioBarreraTotal;
+    bool             bit15_corruption_cambioSentidoTotal;
+    bool             bit15_corruption_cantidad;
+    bool             bit15_corruption_cantidad_total;
+    int              cambioBarreraTotal_raw;
+    uint32_t         cambioBarreraTotal_turno;
+    uint16_t         cambioBarrera_instantaneo;
+    uint32_t         cambioBarrera_turno;
+    int              cambioSentidoTotal_raw;
+    uint32_t         cambioSentidoTotal_turno;
+    uint16_t         cambioSentido_instantaneo;
+    uint32_t         cambioSentido_turno;
+    uint16_t         cantidad_instantanea;
+    uint32_t         cantidad_produccion_turno;
+    int              cantidad_raw;
+    int              cantidad_total_raw;
+    uint32_t         cantidad_total_turno;
+    int              checksum;
+    int              deviceType;
+    int              lineID;
+    int              maquina_id;
+    uint16_t         paradas_1_instantaneo;
+    uint32_t         paradas_1_turno;
+    uint16_t         paradas_2_instantaneo;
+    uint32_t         paradas_2_turno;
+    uint32_t         tiempo_operacion_turno_s;
+    uint16_t         timer1Hz_instantaneo;
+    std::string_view timestamp_device;
+    int              turno;
+};
+constexpr auto SALIDA_HORNO_PROD_SCHEMA = jsonw::schema(
+    JSONW_FIELD(SalidaHornoProdOut, bancalinos0_instantaneo),
+    JSONW_FIELD(SalidaHornoProdOut, bancalinos0_turno),
+    JSONW_FIELD(SalidaHornoProdOut, bancalinos1_instantaneo),
+    JSONW_FIELD(SalidaHornoProdOut, bancalinos1_turno),
+    JSONW_FIELD(SalidaHornoProdOut, bancalinosComb1_instantaneo),
+    JSONW_FIELD(SalidaHornoProdOut, bancalinosComb1_turno),
+    JSONW_FIELD(SalidaHornoProdOut, bancalinosComb2_instantaneo),
+    JSONW_FIELD(SalidaHornoProdOut, bancalinosComb2_turno),
+    JSONW_FIELD(SalidaHornoProdOut, bancalinosTotal_raw),
+    JSONW_FIELD(SalidaHornoProdOut, bancalinosTotal_turno),
+    JSONW_FIELD(SalidaHornoProdOut, bit15_corruption_bancalinosTotal),
+    JSONW_FIELD(SalidaHornoProdOut, bit15_corruption_cambioBarreraTotal),
+    JSONW_FIELD(SalidaHornoProdOut, bit15_corruption_cambioSentidoTotal),
+    JSONW_FIELD(SalidaHornoProdOut, bit15_corruption_cantidad),
+    JSONW_FIELD(SalidaHornoProdOut, bit15_corruption_cantidad_total),
+    JSONW_FIELD(SalidaHornoProdOut, cambioBarreraTotal_raw),
+    JSONW_FIELD(SalidaHornoProdOut, cambioBarreraTotal_turno),
+    JSONW_FIELD(SalidaHornoProdOut, cambioBarrera_instantaneo),
+    JSONW_FIELD(SalidaHornoProdOut, cambioBarrera_turno),
+    JSONW_FIELD(SalidaHornoProdOut, cambioSentidoTotal_raw),
+    JSONW_FIELD(SalidaHornoProdOut, cambioSentidoTotal_turno),
+    JSONW_FIELD(SalidaHornoProdOut, cambioSentido_instantaneo),
+    JSONW_FIELD(SalidaHornoProdOut, cambioSentido_turno),
+    JSONW_FIELD(SalidaHornoProdOut, cantidad_instantanea),
+    JSONW_FIELD(SalidaHornoProdOut, cantidad_produccion_turno),
+    JSONW_FIELD(SalidaHornoProdOut, cantidad_raw),
+    JSONW_FIELD(SalidaHornoProdOut, cantidad_total_raw),
+    JSONW_FIELD(SalidaHornoProdOut, cantidad_total_turno),
+    JSONW_FIELD(SalidaHornoProdOut, checksum),
+    JSONW_FIELD(SalidaHornoProdOut, deviceType),
+    JSONW_FIELD(SalidaHornoProdOut, lineID),
+    JSONW_FIELD(SalidaHornoProdOut, maquina_id),
+    JSONW_FIELD(SalidaHornoProdOut, paradas_1_instantaneo),
+    JSONW_FIELD(SalidaHornoProdOut, paradas_1_turno),
+    JSONW_FIELD(SalidaHornoProdOut, paradas_2_instantaneo),
+    JSONW_FIELD(SalidaHornoProdOut, paradas_2_turno),
+    JSONW_FIELD(SalidaHornoProdOut, tiempo_operacion_turno_s),
+    JSONW_FIELD(SalidaHornoProdOut, timer1Hz_instantaneo),
+    JSONW_FIELD(SalidaHornoProdOut, timestamp_device),
+    JSONW_FIELD(SalidaHornoProdOut, turno));
+static_assert(SALIDA_HORNO_PROD_SCHEMA.valid(), "keys must be sorted");
+
+/** calidad/production */
+struct CalidadProdOut {
+    uint64_t         comercial;
+    uint64_t         extra_c1;
+    uint64_t         extra_c2;
+    int              lineID;
+    int              maquina_id;
+    uint64_t         quebrados;
+    int              shift;
+    std::string_view timestamp_device;
+};
+constexpr auto CALIDAD_PROD_SCHEMA = jsonw::schema(
+    JSONW_FIELD(CalidadProdOut, comercial),
+    JSONW_FIELD(CalidadProdOut, extra_c1),
+    JSONW_FIELD(CalidadProdOut, extra_c2),
+    JSONW_FIELD(CalidadProdOut, lineID),
+    JSONW_FIELD(CalidadProdOut, maquina_id),
+    JSONW_FIELD(CalidadProdOut, quebrados),
+    JSONW_FIELD(CalidadProdOut, shift),
+    JSONW_FIELD(CalidadProdOut, timestamp_device));
+static_assert(CALIDAD_PROD_SCHEMA.valid(), "keys must be sorted");
+
+
+// ============================================================================
+// Counter fields
+//
+// The PLC counters each processor accumulates per shift (see CounterFields.hpp),
+// in the order the processor reads them; the enum above each table indexes
+// it. A table is part of its processor's State layout: bump
+// pstore::FORMAT_VERSION when one changes.
+// ============================================================================
+using counters::Clean;
+using counters::Wrap;
+
+/** prensa_hidraulica1, prensa_hidraulica2 */
+enum PrensaCounter : uint8_t { PH_PISADAS, PH_PROD_TIME, PH_PARADAS, PH_TIEMPO_PARADAS };
+constexpr counters::Field PRENSA_FIELDS[] = {
+    {.name = "cantidadProductos",   .key = "acc_pisadas",          .clean = Clean::Mask15, .wrap = Wrap::Mod15},
+    {.name = "tiempoProduccion_ds", .key = "acc_prod_time_s",      .scale = 0.1},   // ds -> s
+    {.name = "paradas",             .key = "acc_paradas",          .clean = Clean::Mask15, .wrap = Wrap::Mod15},
+    {.name = "tiempoParadas_s",     .key = "acc_tiempo_paradas_s", .clean = Clean::Mask15, .wrap = Wrap::Mod15},
+};
+
+/** entrada_secador: MSB masked (not reported), but 16-bit deltas (a bank flip is rejected as a jump) */
+enum EntradaSecadorCounter : uint8_t { ES_ARRANQUES, ES_T_OPERACION };
+constexpr counters::Field ENTRADA_SECADOR_FIELDS[] = {
+    // at most 100 arranques per 30 s
+    {.name = "arranques",         .key = "acc_arranques",     .clean = Clean::Low15, .max_reasonable = 100},
+    {.name = "tiempoOperacion_s", .key = "acc_t_operacion_s", .clean = Clean::Low15, .max_reasonable = 30},
+};
+
+/** salida_secador: MSB masked, not reported */
+enum SalidaSecadorCounter : uint8_t { SS_PROD_Q, SS_STOP_Q, SS_PROD_T, SS_STOP_T };
+constexpr counters::Field SALIDA_SECADOR_FIELDS[] = {
+    {.name = "cantidadProductos",   .key = "acc_prod_q",   .clean = Clean::Low15, .wrap = Wrap::Mod15},
+    {.name = "paradas",             .key = "acc_stop_q",   .clean = Clean::Low15, .wrap = Wrap::Mod15},
+    {.name = "tiempoProduccion_ds", .key = "acc_prod_t_s", .scale = 0.1},   // ds -> s
+    {.name = "tiempoParadas_s",     .key = "acc_stop_t_s", .clean = Clean::Low15, .wrap = Wrap::Mod15},
+};
+
+/** esmalte: raw 16-bit values, no MSB mask */
+enum EsmalteCounter : uint8_t { EM_PROD_Q, EM_STOP_Q, EM_PROD_T, EM_STOP_T };
+constexpr counters::Field ESMALTE_FIELDS[] = {
+    {.name = "cantidadProductos",   .key = "acc_prod_q",   .max_reasonable = 200},
+    {.name = "paradas",             .key = "acc_stop_q",   .max_reasonable = 200},
+    {.name = "tiempoProduccion_ds", .key = "acc_prod_t_s", .max_reasonable = 200, .scale = 0.1},
+    {.name = "tiempoParadas_s",     .key = "acc_stop_t_s", .max_reasonable = 200},
+};
+
+/** entrada_horno: limits are per 30 s uplink */
+enum EntradaHornoCounter : uint8_t { EH_GRADES, EH_STOPS_Q, EH_STOPS_T, EH_FAULTS_Q, EH_FAULTS_T, EH_MCF, EH_FOR };
+constexpr counters::Field ENTRADA_HORNO_FIELDS[] = {
+    // D29007 CICLO, BCD-converted (max 9999)
+    {.name = "cantidadGrades",  .key = "acc_grades",       .clean = Clean::Bcd, .max_reasonable = 150},
+    {.name = "paradas",         .key = "acc_stops_q",      .max_reasonable = 50},    // D29003
+    {.name = "tiempoParadas_s", .key = "acc_stops_t_s",    .max_reasonable = 30},    // D29004
+    {.name = "fallaHorno",      .key = "acc_faults_q",     .max_reasonable = 20},    // D29013
+    {.name = "tiempoFalla_s",   .key = "acc_faults_t_s",   .max_reasonable = 30},    // D29014
+    {.name = "metricaMCF",      .key = "acc_mcf_metric_s", .max_reasonable = 300, .scale = 0.1},   // D29005, ds
+    {.name = "metricaFOR",      .key = "acc_for_metric_s", .max_reasonable = 300, .scale = 0.1},   // D29008, ds
+};
+
+/** salida_horno: 15-bit counters (MSB is the bank flag) and the 16-bit 1 Hz timer */
+enum SalidaHornoCounter : uint8_t {
+    SH_BANCALINOS0, SH_BANCALINOS1, SH_BANCALINOS_COMB1, SH_BANCALINOS_COMB2, SH_BANCALINOS_TOTAL,
+    SH_CAMBIO_BARRERA, SH_CAMBIO_BARRERA_TOTAL, SH_CAMBIO_SENTIDO, SH_CAMBIO_SENTIDO_TOTAL,
+    SH_CANTIDAD, SH_CANTIDAD_TOTAL, SH_PARADAS_1, SH_PARADAS_2, SH_TIMER_1HZ,
+};
+constexpr counters::Field SALIDA_HORNO_FIELDS[] = {
+    {.name = "bancalinos0",        .key = "acc_bancalinos0",        .clean = Clean::Mask15, .wrap = Wrap::Mod15},
+    {.name = "bancalinos1",        .key = "acc_bancalinos1",        .clean = Clean::Mask15, .wrap = Wrap::Mod15},
+    {.name = "bancalinosComb1",    .key = "acc_bancalinosComb1",    .clean = Clean::Mask15, .wrap = Wrap::Mod15},
+    {.name = "bancalinosComb2",    .key = "acc_bancalinosComb2",    .clean = Clean::Mask15, .wrap = Wrap::Mod15},
+    {.name = "bancalinosTotal",    .key = "acc_bancalinosTotal",    .clean = Clean::Mask15, .wrap = Wrap::Mod15},
+    {.name = "cambioBarrera",      .key = "acc_cambioBarrera",      .clean = Clean::Mask15, .wrap = Wrap::Mod15},
+    {.name = "cambioBarreraTotal", .key = "acc_cambioBarreraTotal", .clean = Clean::Mask15, .wrap = Wrap::Mod15},
+    {.name = "cambioSentido",      .key = "acc_cambioSentido",      .clean = Clean::Mask15, .wrap = Wrap::Mod15},
+    {.name = "cambioSentidoTotal", .key = "acc_cambioSentidoTotal", .clean = Clean::Mask15, .wrap = Wrap::Mod15},
+    {.name = "cantidad",           .key = "acc_cantidad",           .clean = Clean::Mask15, .wrap = Wrap::Mod15},
+    {.name = "cantidad_total",     .key = "acc_cantidad_total",     .clean = Clean::Mask15, .wrap = Wrap::Mod15},
+    {.name = "paradas_1",          .key = "acc_paradas_1",          .clean = Clean::Mask15, .wrap = Wrap::Mod15},
+    {.name = "paradas_2",          .key = "acc_paradas_2",          .clean = Clean::Mask15, .wrap = Wrap::Mod15},
+    // timer1Hz counts seconds: also summarized as the operating time
+    {.name = "timer1Hz",           .key = "acc_timer1Hz",           .alias = "acc_tiempo_operacion_s"},
+};
+
+} // namespace
+
 /** Default processor: lightly normalize and forward a summary. */
 class DefaultProcessor : public IMessageProcessor
 {
 public:
-    std::vector<Publication> process(const json &msg, const std::string &isa95_prefix) override
+    void process(const Uplink &up, const MessageContext &ctx, const std::string &isa95_prefix,
+                 PublicationSink &sink) override
     {
-        json out;
+        // Unknown payload shape: this is the only processor that needs the DOM.
+        // Its nodes live in the thread's arena, rewound when the scope ends.
+        jsonu::ArenaScope arena;
+        std::string err;
+        auto dom = jsonu::parse(up.raw, err);
+        if (!dom)
+            return;
+        const jsonu::arena_json &msg = *dom;
+
+        jsonu::arena_json out;
         out["source"] = "celima/data";
         out["observed"] = msg;
 
         // Put some commonly useful fields if present
-        if (auto dev = jsonu::get_opt<std::string>(msg, "devEUI"))
+        if (auto dev = jsonu::get_opt<jsonu::arena_string>(msg, "devEUI"))
             out["devEUI"] = *dev;
-        if (auto dn = jsonu::get_opt<std::string>(msg, "deviceName"))
+        if (auto dn = jsonu::get_opt<jsonu::arena_string>(msg, "deviceName"))
             out["deviceName"] = *dn;
         if (auto dt = jsonu::get_opt<int>(msg, "deviceType"))
             out["deviceType"] = *dt;
 
         // Example: publish to a “production” topic
-        auto t1 = isa95_prefix + "/production/line/quantity";
-        json p1;
+        const auto t1 = topics::intern(isa95_prefix + "/production/line/quantity");
+        jsonu::arena_json p1;
         p1["quantity"] = jsonu::get_opt<int>(msg, "cantidad").value_or(0);
-        p1["ts"] = std::time(nullptr);
+        p1["ts"] = std::chrono::system_clock::to_time_t(ctx.received);
 
         // Example: publish to a “quality/alarms” topic
-        auto t2 = isa95_prefix + "/quality/alarms";
-        json p2;
+        const auto t2 = topics::intern(isa95_prefix + "/quality/alarms");
+        jsonu::arena_json p2;
         p2["alarms"] = jsonu::get_opt<int>(msg, "alarms").value_or(0);
-        p2["ts"] = std::time(nullptr);
+        p2["ts"] = std::chrono::system_clock::to_time_t(ctx.received);
 
-        return {make_pub(t1, p1), make_pub(t2, p2)};
+        publish(sink, t1, p1);
+        publish(sink, t2, p2);
     }
 };
 
@@ -68,7 +616,7 @@ public:
  * - Receives accumulated counts every 3 minutes (boxesQ1, boxesQ2, boxesQ6, totalBroken)
  * - Maintains per-shift accumulators for qualities 1, 2, 6 and discarded ("quebrados")
  * - Resets accumulators when the shift changes (S1->S2->S3->S1...)
- * - Thread-safe via a static mutex (safe even if processor instances are recreated)
+ * - Lock-free: state is per worker shard (thread_local), and all messages of a line go to the same shard
  * 
  * Input JSON format (new):
  * {
@@ -100,18 +648,41 @@ class CalidadProcessor final : public IMessageProcessor {
         uint64_t acc_discarded = 0;
         int shift = -1;
         bool initialized = false;
+
+        void merge(const LineState &o) {
+            acc_q1 += o.acc_q1;
+            acc_q2 += o.acc_q2;
+            acc_q6 += o.acc_q6;
+            acc_discarded += o.acc_discarded;
+        }
     };
     
-    static std::mutex mtx_;
-    static std::unordered_map<int, LineState> states_;
+    static thread_local LineStates<LineState> states_;
+    static thread_local topics::LineTopics<1> topics_;
 
 public:
     static void reset_states();
+    // Shift accumulators published in shift_summary.
+    static constexpr auto SUMMARY_SCHEMA = jsonw::schema(
+        JSONW_FIELD(LineState, acc_discarded),
+        JSONW_FIELD(LineState, acc_q1),
+        JSONW_FIELD(LineState, acc_q2),
+        JSONW_FIELD(LineState, acc_q6));
+    static_assert(SUMMARY_SCHEMA.valid(), "keys must be sorted");
+
+    template <typename Pred>
+    static void close_lines(const ShiftChange& ev, Pred applies, std::vector<DeviceSnapshot>& out) {
+        states_.retire(ev.opened_shift, applies, "calidad", [](const LineState &st) {
+            return std::string(jsonw::serialize(st, SUMMARY_SCHEMA));
+        }, out);
+    }
     
-    std::vector<Publication> process(const json& msg,
-                                     const std::string& isa95_prefix) override {
-        const int shift_now = static_cast<int>(current_shift_localtime());
-        const int line_id   = msg.value("lineID", 0);
+    void process(const Uplink &msg,
+                 const MessageContext &ctx,
+                 const std::string &isa95_prefix,
+                 PublicationSink &sink) override {
+        const int shift_now = ctx.shift;
+        const int line_id   = msg.value(UF::lineID, 0);
         
         // Extract accumulated counts from new payload format
         // Support both field names for backward compatibility
@@ -121,22 +692,22 @@ public:
         uint64_t delta_broken = 0;
         
         // NEW FORMAT: accumulated counts (3-minute intervals)
-        if (msg.contains("boxesQ1")) {
-            delta_q1 = msg.value("boxesQ1", 0);
-            delta_q2 = msg.value("boxesQ2", 0);
-            delta_q6 = msg.value("boxesQ6", 0);
-            delta_broken = msg.value("totalBroken", 0);
+        if (msg.contains(UF::boxesQ1)) {
+            delta_q1 = msg.value(UF::boxesQ1, 0);
+            delta_q2 = msg.value(UF::boxesQ2, 0);
+            delta_q6 = msg.value(UF::boxesQ6, 0);
+            delta_broken = msg.value(UF::totalBroken, 0);
         }
         // OLD FORMAT: single box event (backward compatibility)
-        else if (msg.contains("cajaCalidad")) {
-            const int cajaCalidad = msg.value("cajaCalidad", 0);
+        else if (msg.contains(UF::cajaCalidad)) {
+            const int cajaCalidad = msg.value(UF::cajaCalidad, 0);
             if      (cajaCalidad == 1) delta_q1 = 1;
             else if (cajaCalidad == 2) delta_q2 = 1;
             else if (cajaCalidad == 6) delta_q6 = 1;
             
-            const int quebrados = msg.contains("quebrados")
-                                    ? msg.value("quebrados", 0)
-                                    : msg.value("quebrado", 0);
+            const int quebrados = msg.contains(UF::quebrados)
+                                    ? msg.value(UF::quebrados, 0)
+                                    : msg.value(UF::quebrado, 0);
             if (quebrados > 0) {
                 delta_broken = static_cast<uint64_t>(quebrados);
             }
@@ -144,15 +715,11 @@ public:
         
         uint64_t q1, q2, q6, disc;
         {
-            std::lock_guard<std::mutex> lock(mtx_);
-            auto& st = states_[line_id];
+            auto &entry = states_.get(line_id, devices::of(msg), ctx);
+            auto &st = entry.st;
             
             // First time or shift changed
-            if (!st.initialized || st.shift != shift_now) {
-                st = LineState();      // reset for this line
-                st.initialized = true;
-                st.shift = shift_now;
-            }
+            states_.begin_shift(entry, shift_now);
             
             // Add the deltas (accumulated counts from this message)
             st.acc_q1 += delta_q1;
@@ -160,130 +727,106 @@ public:
             st.acc_q6 += delta_q6;
             st.acc_discarded += delta_broken;
             
-            // Snapshot current shift totals
-            q1 = st.acc_q1;
-            q2 = st.acc_q2;
-            q6 = st.acc_q6;
-            disc = st.acc_discarded;
+            states_.save(entry, ctx);
+
+            // Snapshot current shift totals of the line (all its devices)
+            const LineState line = states_.line_total(line_id, shift_now);
+            q1 = line.acc_q1;
+            q2 = line.acc_q2;
+            q6 = line.acc_q6;
+            disc = line.acc_discarded;
         }
         
         // Output format remains unchanged
-        json out;
-        out["maquina_id"]       = 8;
-        out["timestamp_device"] = iso8601_utc_now();
-        out["shift"]            = shift_now;
-        out["lineID"]           = line_id;
-        out["extra_c1"]   = q1;
-        out["extra_c2"]   = q2;
-        out["comercial"]  = q6;
-        out["quebrados"]  = disc;
+        CalidadProdOut out{};
+        out.maquina_id       = 8;
+        out.timestamp_device = ctx.ts.view();
+        out.shift            = shift_now;
+        out.lineID           = line_id;
+        out.extra_c1   = q1;
+        out.extra_c2   = q2;
+        out.comercial  = q6;
+        out.quebrados  = disc;
         
-        const auto t1 = isa95_prefix + std::to_string(line_id) + "/calidad/production";
-        return { make_pub(t1, out) };
+        publish(sink, topics_.at(isa95_prefix, line_id)[0], out, CALIDAD_PROD_SCHEMA);
     }
 };
 
 // Static definitions
-std::mutex CalidadProcessor::mtx_;
-std::unordered_map<int, CalidadProcessor::LineState> CalidadProcessor::states_;
+thread_local LineStates<CalidadProcessor::LineState> CalidadProcessor::states_{DeviceType::Calidad};
+thread_local topics::LineTopics<1> CalidadProcessor::topics_{{"/calidad/production"}};
 
 void CalidadProcessor::reset_states() {
-    std::lock_guard<std::mutex> lock(mtx_);
     states_.clear();
 }
 
 // ============================================================================
-// PrensaHidraulica1Processor - Enhanced with Monotonic Accumulators
+// PrensaHidraulicaProcessor - Enhanced with Monotonic Accumulators
+//
+// One class for both presses: PH_1 and PH_2 differ only in maquina_id and
+// their topic / shift_summary name.
 // ============================================================================
 
-class PrensaHidraulica1Processor : public IMessageProcessor
+template <DeviceType DT>
+class PrensaHidraulicaProcessor : public IMessageProcessor
 {
-    struct PH1State {
-        bool initialized = false;
-        int  shift       = -1;
-
-        // cantidadProductos (15-bit counter, MSB = bank flag)
-        uint16_t last_contador15 = 0;
-        uint32_t acc_pisadas = 0;
+    static_assert(DT == DeviceType::PH_1 || DT == DeviceType::PH_2);
+    static constexpr bool PH1 = DT == DeviceType::PH_1;
+    static constexpr const char *NAME          = PH1 ? "prensa_hidraulica1" : "prensa_hidraulica2";
+    static constexpr const char *ALARMS_TOPIC  = PH1 ? "/prensa_hidraulica1/alarms" : "/prensa_hidraulica2/alarms";
+    static constexpr const char *PROD_TOPIC    = PH1 ? "/prensa_hidraulica1/production"
+                                                     : "/prensa_hidraulica2/production";
 
-        // tiempoProduccion_ds (16-bit, no MSB flag)
-        uint16_t last_raw_prod_time = 0;
-        double   acc_prod_time_s = 0.0;
+    using Counters = counters::Bank<PRENSA_FIELDS>;
 
-        // paradas (15-bit counter)
-        uint16_t last_paradas15 = 0;
-        uint32_t acc_paradas = 0;
+    struct State {
+        bool initialized = false;
+        int  shift       = -1;
+        Counters c;
 
-        // tiempoParadas_s (15-bit counter)
-        uint16_t last_tiempo_paradas15 = 0;
-        uint32_t acc_tiempo_paradas_s = 0;
+        void merge(const State &o) { c.merge(o.c); }
     };
 
-    static std::mutex mtx_;
-    static std::unordered_map<int, PH1State> states_;
-
-    // 15-bit counter: MSB is a bank flag
-    static constexpr uint16_t COUNTER_MASK = 0x7FFF;
-    static constexpr uint16_t COUNTER_MOD  = 0x8000;
-
-    static inline uint16_t clean15(int x) {
-        return static_cast<uint16_t>(x) & COUNTER_MASK;
-    }
-
-    static inline bool is_corrupted(int x) {
-        return (x & 0x8000) != 0;
-    }
-
-    static uint16_t diff15(uint16_t curr, uint16_t prev) {
-        if (curr >= prev) {
-            return curr - prev;
-        } else {
-            return static_cast<uint16_t>(COUNTER_MOD + curr - prev);
-        }
-    }
-
-    static uint16_t diff16(uint16_t curr, uint16_t prev) {
-        if (curr >= prev) {
-            return curr - prev;
-        } else {
-            return static_cast<uint16_t>(65536 - prev + curr);
-        }
+    static thread_local LineStates<State> states_;
+    // Function-local: GCC 12 emits a clashing TLS guard for a second
+    // thread_local static data member of a class template.
+    static topics::LineTopics<2> &topics()
+    {
+        static thread_local topics::LineTopics<2> t{{ALARMS_TOPIC, PROD_TOPIC}};
+        return t;
     }
 
 public:
     /**
-     * Reset all accumulated states across all lines
+     * Reset all accumulated states of the calling shard
      * Useful for testing or manual reset operations
      */
     static void reset_states() {
-        std::lock_guard<std::mutex> lock(mtx_);
         states_.clear();
     }
 
-    std::vector<Publication> process(const json &msg,
-                                     const std::string &isa95_prefix) override
+    template <typename Pred>
+    static void close_lines(const ShiftChange& ev, Pred applies, std::vector<DeviceSnapshot>& out) {
+        states_.retire(ev.opened_shift, applies, NAME, [](const State &st) { return st.c.summary(); }, out);
+    }
+
+    void process(const Uplink &msg,
+                 const MessageContext &ctx,
+                 const std::string &isa95_prefix,
+                 PublicationSink &sink) override
     {
-        auto sh = current_shift_localtime();
-        int shiftNum = (sh == Shift::S1 ? 1 : (sh == Shift::S2 ? 2 : 3));
+        const int shiftNum = ctx.shift;
 
         // Read inputs
-        int line          = jsonu::get_opt<int>(msg, "lineID").value_or(0);
-        int alarms        = jsonu::get_opt<int>(msg, "alarms").value_or(0);
-        int raw_count_i   = jsonu::get_opt<int>(msg, "cantidadProductos").value_or(0);
-        int raw_time_i    = jsonu::get_opt<int>(msg, "tiempoProduccion_ds").value_or(0);
-        int paradas_raw   = jsonu::get_opt<int>(msg, "paradas").value_or(0);
-        int tiempo_paradas_raw = jsonu::get_opt<int>(msg, "tiempoParadas_s").value_or(0);
-
-        // Detect corruption
-        bool corr_contador = is_corrupted(raw_count_i);
-        bool corr_paradas = is_corrupted(paradas_raw);
-        bool corr_tiempo_paradas = is_corrupted(tiempo_paradas_raw);
-
-        // Clean values (remove MSB)
-        uint16_t contador_clean = clean15(raw_count_i);
-        uint16_t time_clean = static_cast<uint16_t>(raw_time_i);  // 16-bit, no corruption
-        uint16_t paradas_clean = clean15(paradas_raw);
-        uint16_t tiempo_paradas_clean = clean15(tiempo_paradas_raw);
+        int line          = msg.get_opt(UF::lineID).value_or(0);
+        int alarms        = msg.get_opt(UF::alarms).value_or(0);
+        int raw_count_i   = msg.get_opt(UF::cantidadProductos).value_or(0);
+        int raw_time_i    = msg.get_opt(UF::tiempoProduccion_ds).value_or(0);
+        int paradas_raw   = msg.get_opt(UF::paradas).value_or(0);
+        int tiempo_paradas_raw = msg.get_opt(UF::tiempoParadas_s).value_or(0);
+
+        // Clean values (remove MSB) and detect corruption
+        const Counters::Readings r = Counters::read({raw_count_i, raw_time_i, paradas_raw, tiempo_paradas_raw});
 
         // Output accumulators
         uint32_t acc_pisadas_out = 0;
@@ -293,44 +836,25 @@ public:
         double   pisadas_min = 0.0;
 
         {
-            std::lock_guard<std::mutex> lock(mtx_);
-            PH1State &st = states_[line];
-
-            if (!st.initialized || st.shift != shiftNum) {
-                // New shift - reset all accumulators
-                st = PH1State();
-                st.initialized = true;
-                st.shift = shiftNum;
-
-                st.last_contador15 = contador_clean;
-                st.last_raw_prod_time = time_clean;
-                st.last_paradas15 = paradas_clean;
-                st.last_tiempo_paradas15 = tiempo_paradas_clean;
+            auto &entry = states_.get(line, devices::of(msg), ctx);
+            State &st = entry.st;
+
+            if (states_.begin_shift(entry, shiftNum)) {
+                // New shift - accumulators start from these readings
+                st.c.reset(r);
             }
             else {
-                // Accumulate pisadas (15-bit counter)
-                st.acc_pisadas += diff15(contador_clean, st.last_contador15);
-                st.last_contador15 = contador_clean;
-
-                // Accumulate production time (16-bit, deciseconds -> seconds)
-                uint16_t delta_time = diff16(time_clean, st.last_raw_prod_time);
-                st.acc_prod_time_s += delta_time * 0.1;
-                st.last_raw_prod_time = time_clean;
-
-                // Accumulate paradas (15-bit counter)
-                st.acc_paradas += diff15(paradas_clean, st.last_paradas15);
-                st.last_paradas15 = paradas_clean;
-
-                // Accumulate tiempo paradas (15-bit counter, already in seconds)
-                st.acc_tiempo_paradas_s += diff15(tiempo_paradas_clean, st.last_tiempo_paradas15);
-                st.last_tiempo_paradas15 = tiempo_paradas_clean;
+                st.c.update(r, entry.quality);
             }
 
-            // Copy out accumulated values
-            acc_pisadas_out = st.acc_pisadas;
-            acc_prod_time_s_out = st.acc_prod_time_s;
-            acc_paradas_out = st.acc_paradas;
-            acc_tiempo_paradas_s_out = st.acc_tiempo_paradas_s;
+            states_.save(entry, ctx);
+
+            // Copy out the line's accumulated values (all its devices)
+            const Counters acc = states_.line_total(line, shiftNum).c;
+            acc_pisadas_out = acc.count(PH_PISADAS);
+            acc_prod_time_s_out = acc.value(PH_PROD_TIME);
+            acc_paradas_out = acc.count(PH_PARADAS);
+            acc_tiempo_paradas_s_out = acc.count(PH_TIEMPO_PARADAS);
 
             // Calculate rate (pisadas per minute)
             if (acc_prod_time_s_out > 1.0) {
@@ -363,432 +887,182 @@ public:
                 break;
         }
 
-        json qual;
-        qual["alarms"] = alarms;
-        qual["timestamp_device"] = iso8601_utc_now();
+        AlarmsOut qual{};
+        qual.alarms = alarms;
+        qual.timestamp_device = ctx.ts.view();
 
-        json prod;
-        prod["maquina_id"] = 1;
-        prod["turno"] = shiftNum;
+        PrensaProdOut prod{};
+        prod.maquina_id = static_cast<int>(DT);
+        prod.turno = shiftNum;
 
         // Pisadas (primary counter)
-        prod["cantidadProductos_raw"] = raw_count_i;
-        prod["cantidadProductos_instantaneo"] = contador_clean;
-        prod["bit15_corruption_cantidadProductos"] = corr_contador;
-        
-        prod["cantidadPisadas_turno"] = acc_pisadas_out;
-        prod["cantidadPisadas_min"] = static_cast<uint32_t>(pisadas_min);
-        prod["cantidadProductos_turno"] = acc_pisadas_out * factor_pisadas;
-
-        // Production time
-        prod["tiempoProduccion_ds_instantaneo"] = time_clean;
-        prod["tiempoProduccion_turno_s"] = static_cast<uint32_t>(acc_prod_time_s_out);
-
-        // Paradas (stops)
-        prod["paradas_raw"] = paradas_raw;
-        prod["paradas_instantaneo"] = paradas_clean;
-        prod["paradas_turno"] = acc_paradas_out;
-        prod["bit15_corruption_paradas"] = corr_paradas;
-
-        // Tiempo paradas (stop time)
-        prod["tiempoParadas_raw"] = tiempo_paradas_raw;
-        prod["tiempoParadas_instantaneo"] = tiempo_paradas_clean;
-        prod["tiempoParadas_turno_s"] = acc_tiempo_paradas_s_out;
-        prod["bit15_corruption_tiempoParadas"] = corr_tiempo_paradas;
-
-        prod["timestamp_device"] = iso8601_utc_now();
-
-        auto t1 = isa95_prefix + std::to_string(line) + "/prensa_hidraulica1/alarms";
-        auto t2 = isa95_prefix + std::to_string(line) + "/prensa_hidraulica1/production";
-
-        return {make_pub(t1, qual), make_pub(t2, prod)};
-    }
-};
-
-// Static definitions
-std::mutex PrensaHidraulica1Processor::mtx_;
-std::unordered_map<int, PrensaHidraulica1Processor::PH1State>
-    PrensaHidraulica1Processor::states_;
-
-// ============================================================================
-// PrensaHidraulica2Processor - Enhanced with Monotonic Accumulators
-// ============================================================================
-
-class PrensaHidraulica2Processor : public IMessageProcessor
-{
-    struct PH2State {
-        bool initialized = false;
-        int  shift       = -1;
-
-        // cantidadProductos (15-bit counter, MSB = bank flag)
-        uint16_t last_contador15 = 0;
-        uint32_t acc_pisadas = 0;
-
-        // tiempoProduccion_ds (16-bit, no MSB flag)
-        uint16_t last_raw_prod_time = 0;
-        double   acc_prod_time_s = 0.0;
-
-        // paradas (15-bit counter)
-        uint16_t last_paradas15 = 0;
-        uint32_t acc_paradas = 0;
-
-        // tiempoParadas_s (15-bit counter)
-        uint16_t last_tiempo_paradas15 = 0;
-        uint32_t acc_tiempo_paradas_s = 0;
-    };
-
-    static std::mutex mtx_;
-    static std::unordered_map<int, PH2State> states_;
-
-    // 15-bit counter: MSB is a bank flag
-    static constexpr uint16_t COUNTER_MASK = 0x7FFF;
-    static constexpr uint16_t COUNTER_MOD  = 0x8000;
-
-    static inline uint16_t clean15(int x) {
-        return static_cast<uint16_t>(x) & COUNTER_MASK;
-    }
-
-    static inline bool is_corrupted(int x) {
-        return (x & 0x8000) != 0;
-    }
-
-    static uint16_t diff15(uint16_t curr, uint16_t prev) {
-        if (curr >= prev) {
-            return curr - prev;
-        } else {
-            return static_cast<uint16_t>(COUNTER_MOD + curr - prev);
-        }
-    }
-
-    static uint16_t diff16(uint16_t curr, uint16_t prev) {
-        if (curr >= prev) {
-            return curr - prev;
-        } else {
-            return static_cast<uint16_t>(65536 - prev + curr);
-        }
-    }
-
-public:
-    /**
-     * Reset all accumulated states across all lines
-     * Useful for testing or manual reset operations
-     */
-    static void reset_states() {
-        std::lock_guard<std::mutex> lock(mtx_);
-        states_.clear();
-    }
-
-    std::vector<Publication> process(const json &msg,
-                                     const std::string &isa95_prefix) override
-    {
-        auto sh = current_shift_localtime();
-        int shiftNum = (sh == Shift::S1 ? 1 : (sh == Shift::S2 ? 2 : 3));
-
-        // Read inputs
-        int line          = jsonu::get_opt<int>(msg, "lineID").value_or(0);
-        int alarms        = jsonu::get_opt<int>(msg, "alarms").value_or(0);
-        int raw_count_i   = jsonu::get_opt<int>(msg, "cantidadProductos").value_or(0);
-        int raw_time_i    = jsonu::get_opt<int>(msg, "tiempoProduccion_ds").value_or(0);
-        int paradas_raw   = jsonu::get_opt<int>(msg, "paradas").value_or(0);
-        int tiempo_paradas_raw = jsonu::get_opt<int>(msg, "tiempoParadas_s").value_or(0);
-
-        // Detect corruption
-        bool corr_contador = is_corrupted(raw_count_i);
-        bool corr_paradas = is_corrupted(paradas_raw);
-        bool corr_tiempo_paradas = is_corrupted(tiempo_paradas_raw);
-
-        // Clean values (remove MSB)
-        uint16_t contador_clean = clean15(raw_count_i);
-        uint16_t time_clean = static_cast<uint16_t>(raw_time_i);  // 16-bit, no corruption
-        uint16_t paradas_clean = clean15(paradas_raw);
-        uint16_t tiempo_paradas_clean = clean15(tiempo_paradas_raw);
-
-        // Output accumulators
-        uint32_t acc_pisadas_out = 0;
-        double   acc_prod_time_s_out = 0.0;
-        uint32_t acc_paradas_out = 0;
-        uint32_t acc_tiempo_paradas_s_out = 0;
-        double   pisadas_min = 0.0;
-
-        {
-            std::lock_guard<std::mutex> lock(mtx_);
-            PH2State &st = states_[line];
-
-            if (!st.initialized || st.shift != shiftNum) {
-                // New shift - reset all accumulators
-                st = PH2State();
-                st.initialized = true;
-                st.shift = shiftNum;
-
-                st.last_contador15 = contador_clean;
-                st.last_raw_prod_time = time_clean;
-                st.last_paradas15 = paradas_clean;
-                st.last_tiempo_paradas15 = tiempo_paradas_clean;
-            }
-            else {
-                // Accumulate pisadas (15-bit counter)
-                st.acc_pisadas += diff15(contador_clean, st.last_contador15);
-                st.last_contador15 = contador_clean;
-
-                // Accumulate production time (16-bit, deciseconds -> seconds)
-                uint16_t delta_time = diff16(time_clean, st.last_raw_prod_time);
-                st.acc_prod_time_s += delta_time * 0.1;
-                st.last_raw_prod_time = time_clean;
-
-                // Accumulate paradas (15-bit counter)
-                st.acc_paradas += diff15(paradas_clean, st.last_paradas15);
-                st.last_paradas15 = paradas_clean;
-
-                // Accumulate tiempo paradas (15-bit counter, already in seconds)
-                st.acc_tiempo_paradas_s += diff15(tiempo_paradas_clean, st.last_tiempo_paradas15);
-                st.last_tiempo_paradas15 = tiempo_paradas_clean;
-            }
+        prod.cantidadProductos_raw = raw_count_i;
+        prod.cantidadProductos_instantaneo = r.v[PH_PISADAS];
+        prod.bit15_corruption_cantidadProductos = r.corrupted(PH_PISADAS);
 
-            // Copy out accumulated values
-            acc_pisadas_out = st.acc_pisadas;
-            acc_prod_time_s_out = st.acc_prod_time_s;
-            acc_paradas_out = st.acc_paradas;
-            acc_tiempo_paradas_s_out = st.acc_tiempo_paradas_s;
-
-            // Calculate rate (pisadas per minute)
-            if (acc_prod_time_s_out > 1.0) {
-                pisadas_min = acc_pisadas_out / (acc_prod_time_s_out / 60.0);
-            }
-        }
-
-        // Build output JSON
-               //Calcular facto de pisadas
-        int factor_pisadas;
-        switch (line) {
-            case 1:
-                factor_pisadas = L1_PIEZAS_PISADA;
-                break;
-            case 2:
-                factor_pisadas = L2_PIEZAS_PISADA;
-                break;
-            case 3:
-                factor_pisadas = L3_PIEZAS_PISADA;
-                break;
-            case 4:
-                factor_pisadas = L4_PIEZAS_PISADA;
-                break;
-            case 5:
-                factor_pisadas = L5_PIEZAS_PISADA;
-                break;
-            default:
-                factor_pisadas = 3; // Valor por defecto si la línea no es reconocida
-                break;
-        }
-
-        json qual;
-        qual["alarms"] = alarms;
-        qual["timestamp_device"] = iso8601_utc_now();
-
-        json prod;
-        prod["maquina_id"] = 2;  // Machine ID 2 for Prensa Hidraulica 2
-        prod["turno"] = shiftNum;
-
-        // Pisadas (primary counter)
-        prod["cantidadProductos_raw"] = raw_count_i;
-        prod["cantidadProductos_instantaneo"] = contador_clean;
-        prod["bit15_corruption_cantidadProductos"] = corr_contador;
-        
-        prod["cantidadPisadas_turno"] = acc_pisadas_out;
-        prod["cantidadPisadas_min"] = static_cast<uint32_t>(pisadas_min);
-        prod["cantidadProductos_turno"] = acc_pisadas_out * factor_pisadas;  
+        prod.cantidadPisadas_turno = acc_pisadas_out;
+        prod.cantidadPisadas_min = static_cast<uint32_t>(pisadas_min);
+        prod.cantidadProductos_turno = acc_pisadas_out * factor_pisadas;
 
         // Production time
-        prod["tiempoProduccion_ds_instantaneo"] = time_clean;
-        prod["tiempoProduccion_turno_s"] = static_cast<uint32_t>(acc_prod_time_s_out);
+        prod.tiempoProduccion_ds_instantaneo = r.v[PH_PROD_TIME];
+        prod.tiempoProduccion_turno_s = static_cast<uint32_t>(acc_prod_time_s_out);
 
         // Paradas (stops)
-        prod["paradas_raw"] = paradas_raw;
-        prod["paradas_instantaneo"] = paradas_clean;
-        prod["paradas_turno"] = acc_paradas_out;
-        prod["bit15_corruption_paradas"] = corr_paradas;
+        prod.paradas_raw = paradas_raw;
+        prod.paradas_instantaneo = r.v[PH_PARADAS];
+        prod.paradas_turno = acc_paradas_out;
+        prod.bit15_corruption_paradas = r.corrupted(PH_PARADAS);
 
         // Tiempo paradas (stop time)
-        prod["tiempoParadas_raw"] = tiempo_paradas_raw;
-        prod["tiempoParadas_instantaneo"] = tiempo_paradas_clean;
-        prod["tiempoParadas_turno_s"] = acc_tiempo_paradas_s_out;
-        prod["bit15_corruption_tiempoParadas"] = corr_tiempo_paradas;
+        prod.tiempoParadas_raw = tiempo_paradas_raw;
+        prod.tiempoParadas_instantaneo = r.v[PH_TIEMPO_PARADAS];
+        prod.tiempoParadas_turno_s = acc_tiempo_paradas_s_out;
+        prod.bit15_corruption_tiempoParadas = r.corrupted(PH_TIEMPO_PARADAS);
 
-        prod["timestamp_device"] = iso8601_utc_now();
+        prod.timestamp_device = ctx.ts.view();
 
-        auto t1 = isa95_prefix + std::to_string(line) + "/prensa_hidraulica2/alarms";
-        auto t2 = isa95_prefix + std::to_string(line) + "/prensa_hidraulica2/production";
+        const auto [t1, t2] = topics().at(isa95_prefix, line);
 
-        return {make_pub(t1, qual), make_pub(t2, prod)};
+        publish_alarm(sink, t1, qual, ALARMS_SCHEMA);
+        publish(sink, t2, prod, PRENSA_PROD_SCHEMA);
     }
 };
 
 // Static definitions
-std::mutex PrensaHidraulica2Processor::mtx_;
-std::unordered_map<int, PrensaHidraulica2Processor::PH2State>
-    PrensaHidraulica2Processor::states_;
-
+template <DeviceType DT>
+thread_local LineStates<typename PrensaHidraulicaProcessor<DT>::State>
+    PrensaHidraulicaProcessor<DT>::states_{DT};
 class EntradaSecadorProcessor : public IMessageProcessor
 {
+    using Counters = counters::Bank<ENTRADA_SECADOR_FIELDS>;
+
     struct State {
         bool initialized = false;
         int  shift = -1;
+        Counters c;   // tiempoOperacion viene en segundos
 
-        uint16_t last_arranques = 0;
-        uint32_t acc_arranques  = 0;
-
-        uint16_t last_t_operacion = 0;
-        uint32_t acc_t_operacion_s = 0;  // tiempoOperacion viene en segundos
+        void merge(const State &o) { c.merge(o.c); }
     };
 
-    static std::mutex mtx_;
-    static std::unordered_map<int, State> states_;
-
-    // ---- Same pattern used for Esmalte/SalidaHorno ----
-    static inline uint16_t clean15(int x) {
-        return static_cast<uint16_t>(x) & 0x7FFF;
-    }
-    static uint16_t diff16(uint16_t curr, uint16_t prev) {
-        return (curr >= prev)
-            ? (curr - prev)
-            : static_cast<uint16_t>(curr + (65536 - prev));
-    }
-
-    // Reject 0 and absurd deltas
-    static uint16_t safe_delta_u16(uint16_t prev, uint16_t curr, uint16_t max_reasonable)
-    {
-        const uint16_t d = diff16(curr, prev);
-        if (d == 0) return 0;
-        if (d > max_reasonable) return 0;   // ignore rollover/garbage
-        return d;
-    }
+    static thread_local LineStates<State> states_;
+    static thread_local topics::LineTopics<2> topics_;
 
 public:
 static void reset_states();
-    std::vector<Publication> process(const json &msg,
-                                     const std::string &isa95_prefix) override
+
+    template <typename Pred>
+    static void close_lines(const ShiftChange& ev, Pred applies, std::vector<DeviceSnapshot>& out) {
+        states_.retire(ev.opened_shift, applies, "entrada_secador",
+                       [](const State &st) { return st.c.summary(); }, out);
+    }
+    void process(const Uplink &msg,
+                 const MessageContext &ctx,
+                 const std::string &isa95_prefix,
+                 PublicationSink &sink) override
     {
         // ---- Determine shift ----
-        auto sh = current_shift_localtime();
-        int shiftNum = (sh == Shift::S1 ? 1 : (sh == Shift::S2 ? 2 : 3));
+        const int shiftNum = ctx.shift;
 
-        int lineID        = msg.value("lineID", 0);
-        int alarms        = msg.value("alarms", 0);
+        int lineID        = msg.value(UF::lineID, 0);
+        int alarms        = msg.value(UF::alarms, 0);
 
-        int arr_in        = msg.value("arranques", 0);
-        int t_oper_s_in   = msg.value("tiempoOperacion_s", 0);
+        int arr_in        = msg.value(UF::arranques, 0);
+        int t_oper_s_in   = msg.value(UF::tiempoOperacion_s, 0);
 
         uint32_t out_arranques = 0;
         uint32_t out_t_oper    = 0;
 
         // mask MSB like other processors
-        uint16_t raw_arr    = clean15(arr_in);
-        uint16_t raw_t_oper = clean15(t_oper_s_in);
+        const Counters::Readings r = Counters::read({arr_in, t_oper_s_in});
 
         {
-            std::lock_guard<std::mutex> lock(mtx_);
-            State &st = states_[lineID];
-
-            if (!st.initialized || st.shift != shiftNum) {
-                st = State();
-                st.initialized     = true;
-                st.shift           = shiftNum;
+            auto &entry = states_.get(lineID, devices::of(msg), ctx);
+            State &st = entry.st;
 
-                st.last_arranques     = raw_arr;
-                st.last_t_operacion   = raw_t_oper;
+            if (states_.begin_shift(entry, shiftNum)) {
+                st.c.reset(r);
             }
             else {
-                // use reasonable deltas: assume no more than 100 arranques per 30 s
-                st.acc_arranques += safe_delta_u16(st.last_arranques,
-                                                   raw_arr,
-                                                   100);
-                st.last_arranques = raw_arr;
-
-                // tiempo de operación en segundos: delta razonable 0..30
-                st.acc_t_operacion_s += safe_delta_u16(st.last_t_operacion,
-                                                       raw_t_oper,
-                                                       30);
-                st.last_t_operacion = raw_t_oper;
+                // reasonable deltas only (ENTRADA_SECADOR_FIELDS)
+                st.c.update(r, entry.quality);
             }
 
-            out_arranques = st.acc_arranques;
-            out_t_oper    = st.acc_t_operacion_s;
+            states_.save(entry, ctx);
+
+            const Counters acc = states_.line_total(lineID, shiftNum).c;
+            out_arranques = acc.count(ES_ARRANQUES);
+            out_t_oper    = acc.count(ES_T_OPERACION);
         }
 
         // ---- Build outputs ----
-        json j_alarms;
-        j_alarms["alarms"] = alarms;
-        j_alarms["ts"] = iso8601_utc_now();
+        AlarmsTsOut j_alarms{};
+        j_alarms.alarms = alarms;
+        j_alarms.ts = ctx.ts.view();
 
-        json prod;
-        prod["maquina_id"] = 3;
-        prod["turno"] = shiftNum;
-        prod["cantidad_arranques"] = out_arranques;
-        prod["tiempo_operacion"]   = out_t_oper;
-        prod["timestamp_device"]   = iso8601_utc_now();
+        EntradaSecadorProdOut prod{};
+        prod.maquina_id = 3;
+        prod.turno = shiftNum;
+        prod.cantidad_arranques = out_arranques;
+        prod.tiempo_operacion   = out_t_oper;
+        prod.timestamp_device   = ctx.ts.view();
 
-        auto t1 = isa95_prefix + std::to_string(lineID) + "/entrada_secador/alarms";
-        auto t2 = isa95_prefix + std::to_string(lineID) + "/entrada_secador/production";
+        const auto [t1, t2] = topics_.at(isa95_prefix, lineID);
 
-        return {make_pub(t1, j_alarms), make_pub(t2, prod)};
+        publish_alarm(sink, t1, j_alarms, ALARMS_TS_SCHEMA);
+        publish(sink, t2, prod, ENTRADA_SECADOR_PROD_SCHEMA);
     }
 };
 
-std::mutex EntradaSecadorProcessor::mtx_;
-std::unordered_map<int, EntradaSecadorProcessor::State>
-    EntradaSecadorProcessor::states_;
+thread_local LineStates<EntradaSecadorProcessor::State>
+    EntradaSecadorProcessor::states_{DeviceType::Entrada_secador, Counters::CHECKED_NAMES};
+thread_local topics::LineTopics<2>
+    EntradaSecadorProcessor::topics_{{"/entrada_secador/alarms", "/entrada_secador/production"}};
 
 
 void EntradaSecadorProcessor::reset_states()
 {
-    std::lock_guard<std::mutex> lk(mtx_);
     states_.clear();
 }
 
 class SalidaSecadorProcessor : public IMessageProcessor
 {
+    using Counters = counters::Bank<SALIDA_SECADOR_FIELDS>;
+
     struct State {
         bool initialized = false;
         int  shift       = -1;
+        Counters c;
 
-        // cantidadProductos (15-bit counter, MSB is flag)
-        uint16_t last_prod_q15   = 0;
-        uint32_t acc_prod_q      = 0;
-
-        // paradas (15-bit counter, MSB is flag)
-        uint16_t last_stop_q15   = 0;
-        uint32_t acc_stop_q      = 0;
-
-        // tiempoProduccion_ds (16-bit, deciseconds)
-        uint16_t last_raw_prod_t = 0;
-        double   acc_prod_t_s    = 0.0;
-
-        // tiempoParadas_s (15-bit, MSB is flag)
-        uint16_t last_stop_t15   = 0;
-        uint32_t acc_stop_t_s    = 0;
+        void merge(const State &o) { c.merge(o.c); }
     };
 
-    static std::mutex mtx_;
-    static std::unordered_map<int, State> states_;
-
-    static constexpr uint16_t MASK_15 = 0x7FFF;  // bits 0..14
-    static constexpr uint16_t MOD_15  = 0x8000;  // 2^15
+    static thread_local LineStates<State> states_;
+    static thread_local topics::LineTopics<2> topics_;
 
 public:
 static void reset_states();
-    std::vector<Publication> process(const json &msg,
-                                     const std::string &isa95_prefix) override
+
+    template <typename Pred>
+    static void close_lines(const ShiftChange& ev, Pred applies, std::vector<DeviceSnapshot>& out) {
+        states_.retire(ev.opened_shift, applies, "salida_secador",
+                       [](const State &st) { return st.c.summary(); }, out);
+    }
+    void process(const Uplink &msg,
+                 const MessageContext &ctx,
+                 const std::string &isa95_prefix,
+                 PublicationSink &sink) override
     {
         // ---- Current shift ----
-        auto sh       = current_shift_localtime();
-        int  shiftNum = (sh == Shift::S1 ? 1 : (sh == Shift::S2 ? 2 : 3));
+        const int shiftNum = ctx.shift;
 
         // ---- Read fields ----
-        int alarms = jsonu::get_opt<int>(msg, "alarms").value_or(0);
-        int prod_q = jsonu::get_opt<int>(msg, "cantidadProductos").value_or(0);
-        int prod_t = jsonu::get_opt<int>(msg, "tiempoProduccion_ds").value_or(0);
-        int line   = jsonu::get_opt<int>(msg, "lineID").value_or(0);
-        int stop_q = jsonu::get_opt<int>(msg, "paradas").value_or(0);
-        int stop_t = jsonu::get_opt<int>(msg, "tiempoParadas_s").value_or(0);
+        int alarms = msg.get_opt(UF::alarms).value_or(0);
+        int prod_q = msg.get_opt(UF::cantidadProductos).value_or(0);
+        int prod_t = msg.get_opt(UF::tiempoProduccion_ds).value_or(0);
+        int line   = msg.get_opt(UF::lineID).value_or(0);
+        int stop_q = msg.get_opt(UF::paradas).value_or(0);
+        int stop_t = msg.get_opt(UF::tiempoParadas_s).value_or(0);
 
         // Outputs
         uint32_t prod_q_shift   = 0;
@@ -797,184 +1071,104 @@ static void reset_states();
         uint32_t stop_t_shift_s = 0;
 
         {
-            std::lock_guard<std::mutex> lock(mtx_);
-            State &st = states_[line];
+            auto &entry = states_.get(line, devices::of(msg), ctx);
+            State &st = entry.st;
 
             // ---- Apply MSB removal for 15-bit counters ----
-            uint16_t prod_q15 = static_cast<uint16_t>(prod_q) & MASK_15;
-            uint16_t stop_q15 = static_cast<uint16_t>(stop_q) & MASK_15;
-            uint16_t prod_t16 = static_cast<uint16_t>(prod_t);           // 16-bit normal
-            uint16_t stop_t15 = static_cast<uint16_t>(stop_t) & MASK_15;
+            const Counters::Readings r = Counters::read({prod_q, stop_q, prod_t, stop_t});
 
             // ---- First sample or shift change ----
-            if (!st.initialized || st.shift != shiftNum) {
-                st.initialized = true;
-                st.shift       = shiftNum;
-
-                st.last_prod_q15   = prod_q15;
-                st.acc_prod_q      = 0;
-
-                st.last_stop_q15   = stop_q15;
-                st.acc_stop_q      = 0;
-
-                st.last_raw_prod_t = prod_t16;
-                st.acc_prod_t_s    = 0.0;
-
-                st.last_stop_t15   = stop_t15;
-                st.acc_stop_t_s    = 0;
+            if (states_.begin_shift(entry, shiftNum)) {
+                st.c.reset(r);
             }
             else {
-                // ---- cantidadProductos (15-bit modulo) ----
-                {
-                    uint16_t prev = st.last_prod_q15;
-                    uint16_t curr = prod_q15;
-                    uint16_t diff =
-                        (curr >= prev)
-                          ? static_cast<uint16_t>(curr - prev)
-                          : static_cast<uint16_t>(MOD_15 + curr - prev);
-
-                    st.acc_prod_q   += diff;
-                    st.last_prod_q15 = curr;
-                }
-
-                // ---- paradas (15-bit modulo) ----
-                {
-                    uint16_t prev = st.last_stop_q15;
-                    uint16_t curr = stop_q15;
-                    uint16_t diff =
-                        (curr >= prev)
-                          ? static_cast<uint16_t>(curr - prev)
-                          : static_cast<uint16_t>(MOD_15 + curr - prev);
-
-                    st.acc_stop_q   += diff;
-                    st.last_stop_q15 = curr;
-                }
-
-                // ---- tiempoProduccion_ds (16-bit normal modulo, ds→s) ----
-                {
-                    uint16_t prev = st.last_raw_prod_t;
-                    uint16_t curr = prod_t16;
-                    uint16_t diff =
-                        (curr >= prev)
-                          ? static_cast<uint16_t>(curr - prev)
-                          : static_cast<uint16_t>(curr + (uint16_t)(65536 - prev));
-
-                    st.acc_prod_t_s += diff * 0.1; // ds → s
-                    st.last_raw_prod_t = curr;
-                }
-
-                // ---- tiempoParadas_s (15-bit modulo) ----
-                {
-                    uint16_t prev = st.last_stop_t15;
-                    uint16_t curr = stop_t15;
-                    uint16_t diff =
-                        (curr >= prev)
-                          ? static_cast<uint16_t>(curr - prev)
-                          : static_cast<uint16_t>(MOD_15 + curr - prev);
-
-                    st.acc_stop_t_s += diff;
-                    st.last_stop_t15 = curr;
-                }
+                // 15-bit modulo counters, tiempoProduccion_ds 16-bit (ds → s)
+                st.c.update(r, entry.quality);
             }
 
-            // ---- Final accumulated values ----
-            prod_q_shift   = st.acc_prod_q;
-            prod_t_shift_s = st.acc_prod_t_s;
-            stop_q_shift   = st.acc_stop_q;
-            stop_t_shift_s = st.acc_stop_t_s;
+            states_.save(entry, ctx);
+
+            // ---- Final accumulated values (line total) ----
+            const Counters acc = states_.line_total(line, shiftNum).c;
+            prod_q_shift   = acc.count(SS_PROD_Q);
+            prod_t_shift_s = acc.value(SS_PROD_T);
+            stop_q_shift   = acc.count(SS_STOP_Q);
+            stop_t_shift_s = acc.count(SS_STOP_T);
         }
 
         // ---- Build MQTT payloads ----
-        json qual;
-        qual["alarms"]           = alarms;
-        qual["timestamp_device"] = iso8601_utc_now();
+        AlarmsOut qual{};
+        qual.alarms           = alarms;
+        qual.timestamp_device = ctx.ts.view();
 
-        json prod;
-        prod["maquina_id"]          = 4;
-        prod["turno"]               = shiftNum;
+        LineProdOut prod{};
+        prod.maquina_id          = 4;
+        prod.turno               = shiftNum;
 
-        prod["cantidad_produccion"] = prod_q_shift;
-        prod["tiempo_produccion"]   = static_cast<uint32_t>(prod_t_shift_s);
-        prod["cantidad_paradas"]    = stop_q_shift;
-        prod["tiempo_paradas"]      = stop_t_shift_s;
+        prod.cantidad_produccion = prod_q_shift;
+        prod.tiempo_produccion   = static_cast<uint32_t>(prod_t_shift_s);
+        prod.cantidad_paradas    = stop_q_shift;
+        prod.tiempo_paradas      = stop_t_shift_s;
 
-        prod["timestamp_device"]    = iso8601_utc_now();
+        prod.timestamp_device    = ctx.ts.view();
 
-        auto t1 = isa95_prefix + std::to_string(line) + "/salida_secador/alarms";
-        auto t2 = isa95_prefix + std::to_string(line) + "/salida_secador/production";
+        const auto [t1, t2] = topics_.at(isa95_prefix, line);
 
-        return { make_pub(t1, qual), make_pub(t2, prod) };
+        publish_alarm(sink, t1, qual, ALARMS_SCHEMA);
+        publish(sink, t2, prod, LINE_PROD_SCHEMA);
     }
 };
 
 // ---- STATIC DEFINITIONS ----
-std::mutex SalidaSecadorProcessor::mtx_;
-std::unordered_map<int, SalidaSecadorProcessor::State>
-    SalidaSecadorProcessor::states_;
+thread_local LineStates<SalidaSecadorProcessor::State>
+    SalidaSecadorProcessor::states_{DeviceType::Salida_secador};
+thread_local topics::LineTopics<2>
+    SalidaSecadorProcessor::topics_{{"/salida_secador/alarms", "/salida_secador/production"}};
 
 void SalidaSecadorProcessor::reset_states()
 {
-    std::lock_guard<std::mutex> lk(mtx_);
     states_.clear();
 }
 
 
 class EsmalteProcessor : public IMessageProcessor
 {
+    using Counters = counters::Bank<ESMALTE_FIELDS>;
+
     struct State {
         bool initialized = false;
         int shift = -1;
+        Counters c;
 
-        // cantidadProductos (15-bit)
-        uint16_t last_raw_prod_q = 0;
-        uint32_t acc_prod_q = 0;
-
-        // paradas (15-bit)
-        uint16_t last_raw_stop_q = 0;
-        uint32_t acc_stop_q = 0;
-
-        // tiempoProduccion_ds (16 bits reales, sin MSB flag)
-        uint16_t last_raw_prod_t = 0;
-        double   acc_prod_t_s = 0.0;
-
-        // tiempoParadas_s (15-bit)
-        uint16_t last_raw_stop_t = 0;
-        uint32_t acc_stop_t_s = 0;
+        void merge(const State &o) { c.merge(o.c); }
     };
 
-    static std::mutex mtx_;
-    static std::unordered_map<int, State> states_;
-
-    // --- Helpers ---
-    static constexpr uint16_t MASK_15 = 0x7FFF;
-    static constexpr uint16_t MOD_15  = 0x8000;
-
-    static uint16_t mask15(int x) {
-        return static_cast<uint16_t>(x) & MASK_15;
-    }
-
-    static uint16_t diff16(uint16_t curr, uint16_t prev) {
-        return (curr >= prev)
-            ? static_cast<uint16_t>(curr - prev)
-            : static_cast<uint16_t>(curr + (65536 - prev));
-    }
+    static thread_local LineStates<State> states_;
+    static thread_local topics::LineTopics<2> topics_;
 
 public:
 static void reset_states();
-    std::vector<Publication> process(const json &msg,
-                                     const std::string &isa95_prefix) override
+
+    template <typename Pred>
+    static void close_lines(const ShiftChange& ev, Pred applies, std::vector<DeviceSnapshot>& out) {
+        states_.retire(ev.opened_shift, applies, "esmalte",
+                       [](const State &st) { return st.c.summary(); }, out);
+    }
+    void process(const Uplink &msg,
+                 const MessageContext &ctx,
+                 const std::string &isa95_prefix,
+                 PublicationSink &sink) override
     {
         // ---- Determine shift ----
-        auto sh = current_shift_localtime();
-        int shiftNum = (sh == Shift::S1 ? 1 : sh == Shift::S2 ? 2 : 3);
+        const int shiftNum = ctx.shift;
 
         // ---- Extract fields ----
-        int alarms   = jsonu::get_opt<int>(msg, "alarms").value_or(0);
-        int prod_q   = jsonu::get_opt<int>(msg, "cantidadProductos").value_or(0);
-        int prod_t   = jsonu::get_opt<int>(msg, "tiempoProduccion_ds").value_or(0);   // 16-bit real
-        int line     = jsonu::get_opt<int>(msg, "lineID").value_or(0);
-        int stop_q   = jsonu::get_opt<int>(msg, "paradas").value_or(0);               // 15-bit
-        int stop_t   = jsonu::get_opt<int>(msg, "tiempoParadas_s").value_or(0);       // 15-bit
+        int alarms   = msg.get_opt(UF::alarms).value_or(0);
+        int prod_q   = msg.get_opt(UF::cantidadProductos).value_or(0);
+        int prod_t   = msg.get_opt(UF::tiempoProduccion_ds).value_or(0);   // 16-bit real
+        int line     = msg.get_opt(UF::lineID).value_or(0);
+        int stop_q   = msg.get_opt(UF::paradas).value_or(0);               // 15-bit
+        int stop_t   = msg.get_opt(UF::tiempoParadas_s).value_or(0);       // 15-bit
 
         uint32_t prod_q_shift = 0;
         uint32_t stop_q_shift = 0;
@@ -982,80 +1176,60 @@ static void reset_states();
         uint32_t stop_t_shift_s = 0;
 
         {
-            std::lock_guard<std::mutex> lock(mtx_);
-            State &st = states_[line];
+            auto &entry = states_.get(line, devices::of(msg), ctx);
+            State &st = entry.st;
 
             // Valores crudos sin máscara
-            uint16_t raw_prod_q = static_cast<uint16_t>(prod_q);
-            uint16_t raw_stop_q = static_cast<uint16_t>(stop_q);
-            uint16_t raw_prod_t = static_cast<uint16_t>(prod_t);
-            uint16_t raw_stop_t = static_cast<uint16_t>(stop_t);
+            const Counters::Readings r = Counters::read({prod_q, stop_q, prod_t, stop_t});
 
             // Reset por primer mensaje o cambio de turno
-            if (!st.initialized || st.shift != shiftNum) {
-                st = State();
-                st.initialized = true;
-                st.shift = shiftNum;
-
-                st.last_raw_prod_q = raw_prod_q;
-                st.last_raw_stop_q = raw_stop_q;
-                st.last_raw_prod_t = raw_prod_t;
-                st.last_raw_stop_t = raw_stop_t;
+            if (states_.begin_shift(entry, shiftNum)) {
+                st.c.reset(r);
             }
             else {
-                // ---- PRODUCCIÓN ----
-                st.acc_prod_q += safe_delta_u16(st.last_raw_prod_q, raw_prod_q);
-                st.last_raw_prod_q = raw_prod_q;
-
-                // ---- PARADAS ----
-                st.acc_stop_q += safe_delta_u16(st.last_raw_stop_q, raw_stop_q);
-                st.last_raw_stop_q = raw_stop_q;
-
-                // ---- tiempoProduccion_ds -> 0.1 s ----
-                st.acc_prod_t_s += safe_delta_u16(st.last_raw_prod_t, raw_prod_t) * 0.1;
-                st.last_raw_prod_t = raw_prod_t;
-
-                // ---- tiempoParadas_s ----
-                st.acc_stop_t_s += safe_delta_u16(st.last_raw_stop_t, raw_stop_t);
-                st.last_raw_stop_t = raw_stop_t;
+                // Producción, paradas, tiempoProduccion_ds -> 0.1 s, tiempoParadas_s
+                st.c.update(r, entry.quality);
             }
 
-            prod_q_shift      = st.acc_prod_q;
-            stop_q_shift      = st.acc_stop_q;
-            prod_t_shift_s    = st.acc_prod_t_s;
-            stop_t_shift_s    = st.acc_stop_t_s;
+            states_.save(entry, ctx);
+
+            const Counters acc = states_.line_total(line, shiftNum).c;
+            prod_q_shift      = acc.count(EM_PROD_Q);
+            stop_q_shift      = acc.count(EM_STOP_Q);
+            prod_t_shift_s    = acc.value(EM_PROD_T);
+            stop_t_shift_s    = acc.count(EM_STOP_T);
         }
 
 
         // ---- Create outputs ----
-        json qual;
-        qual["alarms"] = alarms;
-        qual["timestamp_device"] = iso8601_utc_now();
-
-        json prod;
-        prod["maquina_id"]        = 5;
-        prod["turno"]             = shiftNum;
-        prod["cantidad_produccion"] = prod_q_shift;
-        prod["tiempo_produccion"]   = static_cast<uint32_t>(prod_t_shift_s);
-        prod["cantidad_paradas"]    = stop_q_shift;
-        prod["tiempo_paradas"]      = stop_t_shift_s;
-        prod["timestamp_device"]    = iso8601_utc_now();
-
-        auto t1 = isa95_prefix + std::to_string(line) + "/esmalte/alarms";
-        auto t2 = isa95_prefix + std::to_string(line) + "/esmalte/production";
-
-        return {make_pub(t1, qual), make_pub(t2, prod)};
+        AlarmsOut qual{};
+        qual.alarms = alarms;
+        qual.timestamp_device = ctx.ts.view();
+
+        LineProdOut prod{};
+        prod.maquina_id        = 5;
+        prod.turno             = shiftNum;
+        prod.cantidad_produccion = prod_q_shift;
+        prod.tiempo_produccion   = static_cast<uint32_t>(prod_t_shift_s);
+        prod.cantidad_paradas    = stop_q_shift;
+        prod.tiempo_paradas      = stop_t_shift_s;
+        prod.timestamp_device    = ctx.ts.view();
+
+        const auto [t1, t2] = topics_.at(isa95_prefix, line);
+
+        publish_alarm(sink, t1, qual, ALARMS_SCHEMA);
+        publish(sink, t2, prod, LINE_PROD_SCHEMA);
     }
 };
 
 // ---- STATIC DEFINITIONS ----
-std::mutex EsmalteProcessor::mtx_;
-std::unordered_map<int, EsmalteProcessor::State>
-    EsmalteProcessor::states_;
+thread_local LineStates<EsmalteProcessor::State>
+    EsmalteProcessor::states_{DeviceType::Esmalte, Counters::CHECKED_NAMES};
+thread_local topics::LineTopics<2>
+    EsmalteProcessor::topics_{{"/esmalte/alarms", "/esmalte/production"}};
 
 void EsmalteProcessor::reset_states()
 {
-    std::lock_guard<std::mutex> lk(mtx_);
     states_.clear();
 }
 
@@ -1065,122 +1239,83 @@ void EsmalteProcessor::reset_states()
 
 class EntradaHornoProcessor : public IMessageProcessor
 {
+    using Counters = counters::Bank<ENTRADA_HORNO_FIELDS>;
+
     struct State {
         bool initialized = false;
         int  shift = -1;
 
-        // Production: Número de Grades (CICLO)
-        uint16_t last_raw_grades = 0;
-        uint32_t acc_grades = 0;
-
-        // Stops: Paradas MCF
-        uint16_t last_raw_stops_q = 0;
-        uint32_t acc_stops_q = 0;
-
-        uint16_t last_raw_stops_t = 0;
-        uint32_t acc_stops_t_s = 0;
-
-        // Faults: Falha Forno
-        uint16_t last_raw_faults_q = 0;
-        uint32_t acc_faults_q = 0;
-
-        uint16_t last_raw_faults_t = 0;
-        uint32_t acc_faults_t_s = 0;
-
-        // Optional: MCF Metrics for validation
-        uint16_t last_raw_mcf_metric = 0;
-        double   acc_mcf_metric_s = 0.0;
+        // Production: Número de Grades (CICLO); Stops: Paradas MCF;
+        // Faults: Falha Forno; MCF / FORMADOR metrics for validation
+        Counters c;
 
-        // Optional: FORMADOR Metrics for validation
-        uint16_t last_raw_for_metric = 0;
-        double   acc_for_metric_s = 0.0;
+        void merge(const State &o) { c.merge(o.c); }
     };
 
-    static std::mutex mtx_;
-    static std::unordered_map<int, State> states_;
-
-    // Clean BCD-converted value (D29007 has max 9999 from BCD origin)
-    static inline uint16_t cleanBCD(int x) {
-        uint16_t val = static_cast<uint16_t>(x);
-        // Cap at BCD maximum value
-        return (val > 9999) ? 9999 : val;
-    }
-
-    // Standard 16-bit cleanup (for non-BCD fields)
-    static inline uint16_t clean16(int x) {
-        return static_cast<uint16_t>(x) & 0xFFFF;
-    }
-
-    // Calculate delta with wraparound handling
-    static uint16_t diff16(uint16_t curr, uint16_t prev) {
-        return (curr >= prev)
-             ? (curr - prev)
-             : static_cast<uint16_t>(curr + (65536 - prev));
-    }
-
-    // Safe delta with maximum reasonable value check
-    static uint16_t safe_delta_u16(uint16_t prev, uint16_t curr, uint16_t max_reasonable)
-    {
-        const uint16_t d = diff16(curr, prev);
-        if (d == 0) return 0;
-        if (d > max_reasonable) return 0;  // Reject unreasonable jumps
-        return d;
-    }
+    static thread_local LineStates<State> states_;
+    static thread_local topics::LineTopics<2> topics_;
 
 public:
     static void reset_states();
+
+    template <typename Pred>
+    static void close_lines(const ShiftChange& ev, Pred applies, std::vector<DeviceSnapshot>& out) {
+        states_.retire(ev.opened_shift, applies, "entrada_horno",
+                       [](const State &st) { return st.c.summary(); }, out);
+    }
     
-    std::vector<Publication> process(const json &msg,
-                                     const std::string &isa95_prefix) override
+    void process(const Uplink &msg,
+                 const MessageContext &ctx,
+                 const std::string &isa95_prefix,
+                 PublicationSink &sink) override
     {
-        auto sh = current_shift_localtime();
-        int shiftNum = (sh == Shift::S1 ? 1 : sh == Shift::S2 ? 2 : 3);
+        const int shiftNum = ctx.shift;
 
         // ========== HEADER FIELDS ==========
-        int line     = msg.value("lineID", 0);
-        int devType  = msg.value("deviceType", 0);
+        int line     = msg.value(UF::lineID, 0);
+        int devType  = msg.value(UF::deviceType, 0);
 
         // Validate device type
         if (devType != 6) {
             // Log warning: wrong device type for this processor
-            std::cerr << "[EntradaHorno] WARNING: Wrong deviceType " 
-                      << devType << " (expected 6)" << std::endl;
+            LOG_WARN(Proc) << "[EntradaHorno] WARNING: Wrong deviceType "
+                           << devType << " (expected 6)";
         }
 
         // ========== STATUS & DIAGNOSTICS ==========
-        int status   = msg.value("status", 0);       // D29002 - Status Lento
-        int timer    = msg.value("timer1Hz", 0);     // D29001 - 1Hz Timer
+        int status   = msg.value(UF::status, 0);       // D29002 - Status Lento
+        int timer    = msg.value(UF::timer1Hz, 0);     // D29001 - 1Hz Timer
 
         // ========== PRODUCTION FIELDS (CRITICAL) ==========
         // D29007 - Número de Grades (CICLO) - The actual production count!
-        int grades   = msg.value("cantidadGrades", 0);
+        int grades   = msg.value(UF::cantidadGrades, 0);
 
         // ========== STOP FIELDS ==========
         // D29003 - Parada MCF Quantidade
-        int stops_q  = msg.value("paradas", 0);
+        int stops_q  = msg.value(UF::paradas, 0);
         
         // D29004 - Parada MCF Tempo (seconds)
-        int stops_t  = msg.value("tiempoParadas_s", 0);
+        int stops_t  = msg.value(UF::tiempoParadas_s, 0);
 
         // ========== FAULT FIELDS ==========
         // D29013 - Falha Forno Quantidade
-        int faults_q = msg.value("fallaHorno", 0);
+        int faults_q = msg.value(UF::fallaHorno, 0);
         
         // D29014 - Falha Forno Tempo (seconds)
-        int faults_t = msg.value("tiempoFalla_s", 0);
+        int faults_t = msg.value(UF::tiempoFalla_s, 0);
 
         // ========== OPTIONAL: METRIC FIELDS (for validation) ==========
         // D29005 - Métrica MCF (deciseconds)
-        int mcf_metric = msg.value("metricaMCF", 0);
+        int mcf_metric = msg.value(UF::metricaMCF, 0);
         
         // D29006 - Métrica MCF Acumulador
-        int mcf_acum = msg.value("metricaMCF_acum", 0);
+        int mcf_acum = msg.value(UF::metricaMCF_acum, 0);
         
         // D29008 - Métrica FORMADOR (deciseconds)
-        int for_metric = msg.value("metricaFOR", 0);
+        int for_metric = msg.value(UF::metricaFOR, 0);
         
         // D29009 - Métrica FORMADOR Acumulador
-        int for_acum = msg.value("metricaFOR_acum", 0);
+        int for_acum = msg.value(UF::metricaFOR_acum, 0);
 
         // ========== OUTPUT ACCUMULATORS ==========
         uint32_t out_grades = 0;
@@ -1194,120 +1329,55 @@ public:
         double   out_for_metric_s = 0.0;
 
         // ========== CLEAN RAW VALUES ==========
-        // D29007 uses BCD-converted format (max 9999)
-        uint16_t raw_grades  = cleanBCD(grades);
-        
-        // Other fields are standard 16-bit
-        uint16_t raw_stops_q  = clean16(stops_q);
-        uint16_t raw_stops_t  = clean16(stops_t);
-        
-        uint16_t raw_faults_q = clean16(faults_q);
-        uint16_t raw_faults_t = clean16(faults_t);
-        
-        uint16_t raw_mcf_metric = clean16(mcf_metric);
-        uint16_t raw_for_metric = clean16(for_metric);
+        // D29007 uses BCD-converted format (max 9999), other fields are standard 16-bit
+        const Counters::Readings r =
+            Counters::read({grades, stops_q, stops_t, faults_q, faults_t, mcf_metric, for_metric});
+        const uint16_t raw_grades = r.v[EH_GRADES];
 
         // ========== BCD OVERFLOW WARNING ==========
         if (raw_grades > 9900) {
-            std::cerr << "[EntradaHorno] WARNING: Grade counter approaching BCD limit: " 
-                      << raw_grades << " (max 9999)" << std::endl;
+            LOG_WARN(Proc) << "[EntradaHorno] WARNING: Grade counter approaching BCD limit: "
+                           << raw_grades << " (max 9999)";
         }
 
         // ========== STATE MANAGEMENT & ACCUMULATION ==========
         {
-            std::lock_guard<std::mutex> lock(mtx_);
-            State &st = states_[line];
+            auto &entry = states_.get(line, devices::of(msg), ctx);
+            State &st = entry.st;
 
             // Initialize or reset on shift change
-            if (!st.initialized || st.shift != shiftNum) {
-                st = State();
-                st.initialized = true;
-                st.shift = shiftNum;
-
+            if (states_.begin_shift(entry, shiftNum)) {
                 // Store initial values (no accumulation on first message)
-                st.last_raw_grades     = raw_grades;
-                st.last_raw_stops_q    = raw_stops_q;
-                st.last_raw_stops_t    = raw_stops_t;
-                st.last_raw_faults_q   = raw_faults_q;
-                st.last_raw_faults_t   = raw_faults_t;
-                st.last_raw_mcf_metric = raw_mcf_metric;
-                st.last_raw_for_metric = raw_for_metric;
-
-                std::cout << "[EntradaHorno] Line " << line 
-                          << " - Shift " << shiftNum 
-                          << " initialized (grades=" << raw_grades << ")" << std::endl;
+                st.c.reset(r);
+
+                LOG_INFO(Proc) << "[EntradaHorno] Line " << line
+                               << " - Shift " << shiftNum
+                               << " initialized (grades=" << raw_grades << ")";
             }
             else {
-                // Accumulate deltas
-                
-                // Grades: Production count (CICLO)
-                // Max reasonable: ~150 grades in 30s at high production
-                uint16_t delta_grades = safe_delta_u16(st.last_raw_grades,
-                                                       raw_grades,
-                                                       150);
-                st.acc_grades += delta_grades;
-                st.last_raw_grades = raw_grades;
-
-                // Stops: Quantity
-                // Max reasonable: 50 stops in 30s (unlikely but possible)
-                st.acc_stops_q += safe_delta_u16(st.last_raw_stops_q,
-                                                 raw_stops_q,
-                                                 50);
-                st.last_raw_stops_q = raw_stops_q;
-
-                // Stops: Time (seconds)
-                // Max reasonable: 30s of stop time in 30s window
-                st.acc_stops_t_s += safe_delta_u16(st.last_raw_stops_t,
-                                                   raw_stops_t,
-                                                   30);
-                st.last_raw_stops_t = raw_stops_t;
-
-                // Faults: Quantity
-                // Max reasonable: 20 faults in 30s (unlikely but possible)
-                st.acc_faults_q += safe_delta_u16(st.last_raw_faults_q,
-                                                  raw_faults_q,
-                                                  20);
-                st.last_raw_faults_q = raw_faults_q;
-
-                // Faults: Time (seconds)
-                // Max reasonable: 30s of fault time in 30s window
-                st.acc_faults_t_s += safe_delta_u16(st.last_raw_faults_t,
-                                                    raw_faults_t,
-                                                    30);
-                st.last_raw_faults_t = raw_faults_t;
-
-                // MCF Metric: Time in deciseconds (0.1s)
-                // Max reasonable: 300 deciseconds = 30s in 30s window
-                st.acc_mcf_metric_s += safe_delta_u16(st.last_raw_mcf_metric,
-                                                      raw_mcf_metric,
-                                                      300) * 0.1;
-                st.last_raw_mcf_metric = raw_mcf_metric;
-
-                // FORMADOR Metric: Time in deciseconds (0.1s)
-                // Max reasonable: 300 deciseconds = 30s in 30s window
-                st.acc_for_metric_s += safe_delta_u16(st.last_raw_for_metric,
-                                                      raw_for_metric,
-                                                      300) * 0.1;
-                st.last_raw_for_metric = raw_for_metric;
+                // Accumulate deltas, dropping unreasonable jumps (ENTRADA_HORNO_FIELDS)
+                const uint16_t delta_grades = st.c.update(r, entry.quality)[EH_GRADES];
 
                 // Debug: Log significant production changes
                 if (delta_grades > 0) {
-                    std::cout << "[EntradaHorno] Line " << line 
-                              << " - Produced " << delta_grades 
-                              << " grades (total: " << st.acc_grades << ")" << std::endl;
+                    LOG_DEBUG(Proc) << "[EntradaHorno] Line " << line
+                                    << " - Produced " << delta_grades
+                                    << " grades (total: " << st.c.count(EH_GRADES) << ")";
                 }
             }
 
-            // Copy accumulated values for output
-            out_grades       = st.acc_grades;
-            out_stops_q      = st.acc_stops_q;
-            out_faults_q     = st.acc_faults_q;
-            out_stops_t_s    = st.acc_stops_t_s;
-            out_faults_t_s   = st.acc_faults_t_s;
-            out_mcf_metric_s = st.acc_mcf_metric_s;
-            out_for_metric_s = st.acc_for_metric_s;
+            states_.save(entry, ctx);
+
+            // Copy the line's accumulated values for output
+            const Counters acc = states_.line_total(line, shiftNum).c;
+            out_grades       = acc.count(EH_GRADES);
+            out_stops_q      = acc.count(EH_STOPS_Q);
+            out_faults_q     = acc.count(EH_FAULTS_Q);
+            out_stops_t_s    = acc.count(EH_STOPS_T);
+            out_faults_t_s   = acc.count(EH_FAULTS_T);
+            out_mcf_metric_s = acc.value(EH_MCF);
+            out_for_metric_s = acc.value(EH_FOR);
         }
-
         // ========== CALCULATE VACIO HORNO (EMPTY FURNACE TIME) ==========
         // Formula: vacio = total_time - production_time - stops_time - failures_time
         // timer = D29001 (total shift time in seconds)
@@ -1326,59 +1396,56 @@ public:
         // ========== BUILD PUBLICATIONS ==========
         
         // Publication 1: Status & Alarms
-        json j_status;
-        j_status["status"]    = status;       // Status word from D29002
-        j_status["timer"]     = timer;        // 1Hz timer from D29001
-        j_status["raw_grades"] = raw_grades;  // Current raw value
-        j_status["ts"]        = iso8601_utc_now();
+        EntradaHornoStatusOut j_status{};
+        j_status.status    = status;       // Status word from D29002
+        j_status.timer     = timer;        // 1Hz timer from D29001
+        j_status.raw_grades = raw_grades;  // Current raw value
+        j_status.ts        = ctx.ts.view();
 
         // Publication 2: Production Data
-        json j_prod;
-        j_prod["maquina_id"] = 6;  // Device type (Entrada Horno)
-        j_prod["turno"]      = shiftNum;
+        EntradaHornoProdOut j_prod{};
+        j_prod.maquina_id = 6;  // Device type (Entrada Horno)
+        j_prod.turno      = shiftNum;
 
         // CRITICAL: Production count (grades/racks)
-        j_prod["cantidad_produccion"] = out_grades;
+        j_prod.cantidad_produccion = out_grades;
         
         // Stops
-        j_prod["cantidad_paradas"]    = out_stops_q;
-        j_prod["tiempo_paradas"]      = out_stops_t_s;
+        j_prod.cantidad_paradas    = out_stops_q;
+        j_prod.tiempo_paradas      = out_stops_t_s;
         
         // Faults
-        j_prod["cantidad_fallas"]     = out_faults_q;
-        j_prod["tiempo_fallas"]       = out_faults_t_s;
+        j_prod.cantidad_fallas     = out_faults_q;
+        j_prod.tiempo_fallas       = out_faults_t_s;
 
         // Optional: Metrics (for advanced analytics)
-        j_prod["tiempo_metrica_mcf"]  = (uint32_t)out_mcf_metric_s;
-        j_prod["tiempo_metrica_for"]  = (uint32_t)out_for_metric_s;
+        j_prod.tiempo_metrica_mcf  = (uint32_t)out_mcf_metric_s;
+        j_prod.tiempo_metrica_for  = (uint32_t)out_for_metric_s;
 
         // NEW: Empty furnace time in minutes
-        j_prod["vacio_horno_min"]     = vacio_horno_min;
+        j_prod.vacio_horno_min     = vacio_horno_min;
 
         // Metadata
-        j_prod["timestamp_device"]    = iso8601_utc_now();
+        j_prod.timestamp_device    = ctx.ts.view();
 
         // Build topic paths
-        auto topic_status = isa95_prefix + std::to_string(line) + "/entrada_horno/status";
-        auto topic_prod   = isa95_prefix + std::to_string(line) + "/entrada_horno/production";
+        const auto [topic_status, topic_prod] = topics_.at(isa95_prefix, line);
 
-        return { 
-            make_pub(topic_status, j_status), 
-            make_pub(topic_prod, j_prod) 
-        };
+        publish(sink, topic_status, j_status, ENTRADA_HORNO_STATUS_SCHEMA);
+        publish(sink, topic_prod, j_prod, ENTRADA_HORNO_PROD_SCHEMA);
     }
 };
 
 // Static member initialization
-std::mutex EntradaHornoProcessor::mtx_;
-std::unordered_map<int, EntradaHornoProcessor::State>
-    EntradaHornoProcessor::states_;
+thread_local LineStates<EntradaHornoProcessor::State>
+    EntradaHornoProcessor::states_{DeviceType::Entrada_horno, Counters::CHECKED_NAMES};
+thread_local topics::LineTopics<2>
+    EntradaHornoProcessor::topics_{{"/entrada_horno/status", "/entrada_horno/production"}};
 
 void EntradaHornoProcessor::reset_states()
 {
-    std::lock_guard<std::mutex> lk(mtx_);
     states_.clear();
-    std::cout << "[EntradaHornoProcessor] All states reset" << std::endl;
+    LOG_INFO(Shift) << "[EntradaHornoProcessor] All states reset";
 }
 
 // ============================================================================
@@ -1387,354 +1454,176 @@ void EntradaHornoProcessor::reset_states()
 
 class SalidaHornoProcessor : public IMessageProcessor
 {
+    using Counters = counters::Bank<SALIDA_HORNO_FIELDS>;
+
     struct State {
         bool initialized = false;
         int shift = -1;
 
-        // All 15-bit counters (MSB is bank flag)
-        uint16_t last_bancalinos0 = 0;
-        uint32_t acc_bancalinos0 = 0;
-
-        uint16_t last_bancalinos1 = 0;
-        uint32_t acc_bancalinos1 = 0;
-
-        uint16_t last_bancalinosComb1 = 0;
-        uint32_t acc_bancalinosComb1 = 0;
-
-        uint16_t last_bancalinosComb2 = 0;
-        uint32_t acc_bancalinosComb2 = 0;
-
-        uint16_t last_bancalinosTotal = 0;
-        uint32_t acc_bancalinosTotal = 0;
-
-        uint16_t last_cambioBarrera = 0;
-        uint32_t acc_cambioBarrera = 0;
-
-        uint16_t last_cambioBarreraTotal = 0;
-        uint32_t acc_cambioBarreraTotal = 0;
-
-        uint16_t last_cambioSentido = 0;
-        uint32_t acc_cambioSentido = 0;
+        // 15-bit counters (MSB is bank flag) and timer1Hz, in seconds
+        Counters c;
 
-        uint16_t last_cambioSentidoTotal = 0;
-        uint32_t acc_cambioSentidoTotal = 0;
-
-        uint16_t last_cantidad = 0;
-        uint32_t acc_cantidad = 0;
-
-        uint16_t last_cantidad_total = 0;
-        uint32_t acc_cantidad_total = 0;
-
-        uint16_t last_paradas_1 = 0;
-        uint32_t acc_paradas_1 = 0;
-
-        uint16_t last_paradas_2 = 0;
-        uint32_t acc_paradas_2 = 0;
-
-        // timer1Hz is 16-bit counter (no MSB flag)
-        uint16_t last_timer1Hz = 0;
-        uint32_t acc_timer1Hz = 0;
-
-        // tiempo_operacion in seconds
-        uint32_t acc_tiempo_operacion_s = 0;
+        void merge(const State &o) { c.merge(o.c); }
     };
 
-    static std::mutex mtx_;
-    static std::unordered_map<int, State> states_;
-
-    // MSB mask for 15-bit counters
-    static constexpr uint16_t MASK_15 = 0x7FFF;
-    static constexpr uint16_t MOD_15 = 0x8000;
-
-    static inline uint16_t clean15(int x) {
-        return static_cast<uint16_t>(x) & MASK_15;
-    }
-
-    static inline bool is_corrupted(int x) {
-        return (x & 0x8000) != 0;
-    }
-
-    static uint16_t diff15(uint16_t curr, uint16_t prev) {
-        // Calculate delta for 15-bit counter with rollover
-        if (curr >= prev) {
-            return curr - prev;
-        } else {
-            return static_cast<uint16_t>(MOD_15 + curr - prev);
-        }
-    }
-
-    static uint16_t diff16(uint16_t curr, uint16_t prev) {
-        // Calculate delta for 16-bit counter with rollover
-        if (curr >= prev) {
-            return curr - prev;
-        } else {
-            return static_cast<uint16_t>(65536 + curr - prev);
-        }
-    }
+    static thread_local LineStates<State> states_;
+    static thread_local topics::LineTopics<2> topics_;
 
 public:
     /**
-     * Reset all accumulated states across all lines
+     * Reset all accumulated states of the calling shard
      * Useful for testing or manual reset operations
      */
     static void reset_states() {
-        std::lock_guard<std::mutex> lock(mtx_);
         states_.clear();
     }
 
-    std::vector<Publication> process(const json &msg,
-                                     const std::string &isa95_prefix) override
+    template <typename Pred>
+    static void close_lines(const ShiftChange& ev, Pred applies, std::vector<DeviceSnapshot>& out) {
+        states_.retire(ev.opened_shift, applies, "salida_horno",
+                       [](const State &st) { return st.c.summary(); }, out);
+    }
+
+    void process(const Uplink &msg,
+                 const MessageContext &ctx,
+                 const std::string &isa95_prefix,
+                 PublicationSink &sink) override
     {
-        auto sh = current_shift_localtime();
-        int shiftNum = (sh == Shift::S1 ? 1 : (sh == Shift::S2 ? 2 : 3));
+        const int shiftNum = ctx.shift;
 
         // Read all raw values from PLC
-        int line = jsonu::get_opt<int>(msg, "lineID").value_or(0);
-        int alarms = jsonu::get_opt<int>(msg, "alarms").value_or(0);
-        int checksum = jsonu::get_opt<int>(msg, "checksum").value_or(0);
-        int deviceType = jsonu::get_opt<int>(msg, "deviceType").value_or(0);
-
-        int bancalinos0_raw = jsonu::get_opt<int>(msg, "bancalinos0").value_or(0);
-        int bancalinos1_raw = jsonu::get_opt<int>(msg, "bancalinos1").value_or(0);
-        int bancalinosComb1_raw = jsonu::get_opt<int>(msg, "bancalinosComb1").value_or(0);
-        int bancalinosComb2_raw = jsonu::get_opt<int>(msg, "bancalinosComb2").value_or(0);
-        int bancalinosTotal_raw = jsonu::get_opt<int>(msg, "bancalinosTotal").value_or(0);
-
-        int cambioBarrera_raw = jsonu::get_opt<int>(msg, "cambioBarrera").value_or(0);
-        int cambioBarreraTotal_raw = jsonu::get_opt<int>(msg, "cambioBarreraTotal").value_or(0);
-        int cambioSentido_raw = jsonu::get_opt<int>(msg, "cambioSentido").value_or(0);
-        int cambioSentidoTotal_raw = jsonu::get_opt<int>(msg, "cambioSentidoTotal").value_or(0);
-
-        int cantidad_raw = jsonu::get_opt<int>(msg, "cantidad").value_or(0);
-        int cantidad_total_raw = jsonu::get_opt<int>(msg, "cantidad_total").value_or(0);
-
-        int paradas_1_raw = jsonu::get_opt<int>(msg, "paradas_1").value_or(0);
-        int paradas_2_raw = jsonu::get_opt<int>(msg, "paradas_2").value_or(0);
-
-        int timer1Hz_raw = jsonu::get_opt<int>(msg, "timer1Hz").value_or(0);
-
-        // Detect corruption for all 15-bit counters
-        bool corr_bancalinos0 = is_corrupted(bancalinos0_raw);
-        bool corr_bancalinos1 = is_corrupted(bancalinos1_raw);
-        bool corr_bancalinosComb1 = is_corrupted(bancalinosComb1_raw);
-        bool corr_bancalinosComb2 = is_corrupted(bancalinosComb2_raw);
-        bool corr_bancalinosTotal = is_corrupted(bancalinosTotal_raw);
-        bool corr_cambioBarrera = is_corrupted(cambioBarrera_raw);
-        bool corr_cambioBarreraTotal = is_corrupted(cambioBarreraTotal_raw);
-        bool corr_cambioSentido = is_corrupted(cambioSentido_raw);
-        bool corr_cambioSentidoTotal = is_corrupted(cambioSentidoTotal_raw);
-        bool corr_cantidad = is_corrupted(cantidad_raw);
-        bool corr_cantidad_total = is_corrupted(cantidad_total_raw);
-        bool corr_paradas_1 = is_corrupted(paradas_1_raw);
-        bool corr_paradas_2 = is_corrupted(paradas_2_raw);
-
-        // Clean all 15-bit counters (remove MSB)
-        uint16_t bancalinos0_clean = clean15(bancalinos0_raw);
-        uint16_t bancalinos1_clean = clean15(bancalinos1_raw);
-        uint16_t bancalinosComb1_clean = clean15(bancalinosComb1_raw);
-        uint16_t bancalinosComb2_clean = clean15(bancalinosComb2_raw);
-        uint16_t bancalinosTotal_clean = clean15(bancalinosTotal_raw);
-        uint16_t cambioBarrera_clean = clean15(cambioBarrera_raw);
-        uint16_t cambioBarreraTotal_clean = clean15(cambioBarreraTotal_raw);
-        uint16_t cambioSentido_clean = clean15(cambioSentido_raw);
-        uint16_t cambioSentidoTotal_clean = clean15(cambioSentidoTotal_raw);
-        uint16_t cantidad_clean = clean15(cantidad_raw);
-        uint16_t cantidad_total_clean = clean15(cantidad_total_raw);
-        uint16_t paradas_1_clean = clean15(paradas_1_raw);
-        uint16_t paradas_2_clean = clean15(paradas_2_raw);
-
-        // timer1Hz is 16-bit (no corruption)
-        uint16_t timer1Hz_clean = static_cast<uint16_t>(timer1Hz_raw);
-
-        // Output accumulators
-        uint32_t acc_bancalinos0_out = 0;
-        uint32_t acc_bancalinos1_out = 0;
-        uint32_t acc_bancalinosComb1_out = 0;
-        uint32_t acc_bancalinosComb2_out = 0;
-        uint32_t acc_bancalinosTotal_out = 0;
-        uint32_t acc_cambioBarrera_out = 0;
-        uint32_t acc_cambioBarreraTotal_out = 0;
-        uint32_t acc_cambioSentido_out = 0;
-        uint32_t acc_cambioSentidoTotal_out = 0;
-        uint32_t acc_cantidad_out = 0;
-        uint32_t acc_cantidad_total_out = 0;
-        uint32_t acc_paradas_1_out = 0;
-        uint32_t acc_paradas_2_out = 0;
-        uint32_t acc_timer1Hz_out = 0;
-        uint32_t acc_tiempo_operacion_s_out = 0;
-
-        {
-            std::lock_guard<std::mutex> lock(mtx_);
-            State &st = states_[line];
-
-            if (!st.initialized || st.shift != shiftNum) {
-                // New shift - reset all accumulators
-                st = State();
-                st.initialized = true;
-                st.shift = shiftNum;
-
-                // Initialize last values
-                st.last_bancalinos0 = bancalinos0_clean;
-                st.last_bancalinos1 = bancalinos1_clean;
-                st.last_bancalinosComb1 = bancalinosComb1_clean;
-                st.last_bancalinosComb2 = bancalinosComb2_clean;
-                st.last_bancalinosTotal = bancalinosTotal_clean;
-                st.last_cambioBarrera = cambioBarrera_clean;
-                st.last_cambioBarreraTotal = cambioBarreraTotal_clean;
-                st.last_cambioSentido = cambioSentido_clean;
-                st.last_cambioSentidoTotal = cambioSentidoTotal_clean;
-                st.last_cantidad = cantidad_clean;
-                st.last_cantidad_total = cantidad_total_clean;
-                st.last_paradas_1 = paradas_1_clean;
-                st.last_paradas_2 = paradas_2_clean;
-                st.last_timer1Hz = timer1Hz_clean;
-            }
-            else {
-                // Accumulate deltas for all 15-bit counters
-                st.acc_bancalinos0 += diff15(bancalinos0_clean, st.last_bancalinos0);
-                st.last_bancalinos0 = bancalinos0_clean;
-
-                st.acc_bancalinos1 += diff15(bancalinos1_clean, st.last_bancalinos1);
-                st.last_bancalinos1 = bancalinos1_clean;
-
-                st.acc_bancalinosComb1 += diff15(bancalinosComb1_clean, st.last_bancalinosComb1);
-                st.last_bancalinosComb1 = bancalinosComb1_clean;
-
-                st.acc_bancalinosComb2 += diff15(bancalinosComb2_clean, st.last_bancalinosComb2);
-                st.last_bancalinosComb2 = bancalinosComb2_clean;
-
-                st.acc_bancalinosTotal += diff15(bancalinosTotal_clean, st.last_bancalinosTotal);
-                st.last_bancalinosTotal = bancalinosTotal_clean;
+        int line = msg.get_opt(UF::lineID).value_or(0);
+        int alarms = msg.get_opt(UF::alarms).value_or(0);
+        int checksum = msg.get_opt(UF::checksum).value_or(0);
+        int deviceType = msg.get_opt(UF::deviceType).value_or(0);
 
-                st.acc_cambioBarrera += diff15(cambioBarrera_clean, st.last_cambioBarrera);
-                st.last_cambioBarrera = cambioBarrera_clean;
+        int bancalinos0_raw = msg.get_opt(UF::bancalinos0).value_or(0);
+        int bancalinos1_raw = msg.get_opt(UF::bancalinos1).value_or(0);
+        int bancalinosComb1_raw = msg.get_opt(UF::bancalinosComb1).value_or(0);
+        int bancalinosComb2_raw = msg.get_opt(UF::bancalinosComb2).value_or(0);
+        int bancalinosTotal_raw = msg.get_opt(UF::bancalinosTotal).value_or(0);
 
-                st.acc_cambioBarreraTotal += diff15(cambioBarreraTotal_clean, st.last_cambioBarreraTotal);
-                st.last_cambioBarreraTotal = cambioBarreraTotal_clean;
+        int cambioBarrera_raw = msg.get_opt(UF::cambioBarrera).value_or(0);
+        int cambioBarreraTotal_raw = msg.get_opt(UF::cambioBarreraTotal).value_or(0);
+        int cambioSentido_raw = msg.get_opt(UF::cambioSentido).value_or(0);
+        int cambioSentidoTotal_raw = msg.get_opt(UF::cambioSentidoTotal).value_or(0);
 
-                st.acc_cambioSentido += diff15(cambioSentido_clean, st.last_cambioSentido);
-                st.last_cambioSentido = cambioSentido_clean;
+        int cantidad_raw = msg.get_opt(UF::cantidad).value_or(0);
+        int cantidad_total_raw = msg.get_opt(UF::cantidad_total).value_or(0);
 
-                st.acc_cambioSentidoTotal += diff15(cambioSentidoTotal_clean, st.last_cambioSentidoTotal);
-                st.last_cambioSentidoTotal = cambioSentidoTotal_clean;
+        int paradas_1_raw = msg.get_opt(UF::paradas_1).value_or(0);
+        int paradas_2_raw = msg.get_opt(UF::paradas_2).value_or(0);
 
-                st.acc_cantidad += diff15(cantidad_clean, st.last_cantidad);
-                st.last_cantidad = cantidad_clean;
+        int timer1Hz_raw = msg.get_opt(UF::timer1Hz).value_or(0);
 
-                st.acc_cantidad_total += diff15(cantidad_total_clean, st.last_cantidad_total);
-                st.last_cantidad_total = cantidad_total_clean;
+        // Clean all 15-bit counters (remove MSB) and detect corruption;
+        // timer1Hz is 16-bit (no corruption)
+        const Counters::Readings r = Counters::read({
+            bancalinos0_raw, bancalinos1_raw, bancalinosComb1_raw, bancalinosComb2_raw, bancalinosTotal_raw,
+            cambioBarrera_raw, cambioBarreraTotal_raw, cambioSentido_raw, cambioSentidoTotal_raw,
+            cantidad_raw, cantidad_total_raw, paradas_1_raw, paradas_2_raw, timer1Hz_raw});
 
-                st.acc_paradas_1 += diff15(paradas_1_clean, st.last_paradas_1);
-                st.last_paradas_1 = paradas_1_clean;
+        Counters acc;   // the line's accumulators, all devices
 
-                st.acc_paradas_2 += diff15(paradas_2_clean, st.last_paradas_2);
-                st.last_paradas_2 = paradas_2_clean;
+        {
+            auto &entry = states_.get(line, devices::of(msg), ctx);
+            State &st = entry.st;
 
-                // timer1Hz is 16-bit counter
-                uint16_t delta_timer = diff16(timer1Hz_clean, st.last_timer1Hz);
-                st.acc_timer1Hz += delta_timer;
-                st.acc_tiempo_operacion_s += delta_timer; // timer1Hz counts seconds
-                st.last_timer1Hz = timer1Hz_clean;
+            if (states_.begin_shift(entry, shiftNum)) {
+                // New shift - accumulators start from these readings
+                st.c.reset(r);
             }
+            else {
+                // Accumulate deltas for all counters
+                st.c.update(r, entry.quality);
+            }
+
+            states_.save(entry, ctx);
 
-            // Copy out accumulated values
-            acc_bancalinos0_out = st.acc_bancalinos0;
-            acc_bancalinos1_out = st.acc_bancalinos1;
-            acc_bancalinosComb1_out = st.acc_bancalinosComb1;
-            acc_bancalinosComb2_out = st.acc_bancalinosComb2;
-            acc_bancalinosTotal_out = st.acc_bancalinosTotal;
-            acc_cambioBarrera_out = st.acc_cambioBarrera;
-            acc_cambioBarreraTotal_out = st.acc_cambioBarreraTotal;
-            acc_cambioSentido_out = st.acc_cambioSentido;
-            acc_cambioSentidoTotal_out = st.acc_cambioSentidoTotal;
-            acc_cantidad_out = st.acc_cantidad;
-            acc_cantidad_total_out = st.acc_cantidad_total;
-            acc_paradas_1_out = st.acc_paradas_1;
-            acc_paradas_2_out = st.acc_paradas_2;
-            acc_timer1Hz_out = st.acc_timer1Hz;
-            acc_tiempo_operacion_s_out = st.acc_tiempo_operacion_s;
+            acc = states_.line_total(line, shiftNum).c;
         }
 
         // Build output JSON with all fields
-        json prod;
-        prod["maquina_id"] = 7;
-        prod["turno"] = shiftNum;
-        prod["deviceType"] = deviceType;
-        prod["lineID"] = line;
-        prod["checksum"] = checksum;
+        SalidaHornoProdOut prod{};
+        prod.maquina_id = 7;
+        prod.turno = shiftNum;
+        prod.deviceType = deviceType;
+        prod.lineID = line;
+        prod.checksum = checksum;
 
         // Bancalinos fields
-        prod["bancalinos0_instantaneo"] = bancalinos0_clean;
-        prod["bancalinos0_turno"] = acc_bancalinos0_out;
+        prod.bancalinos0_instantaneo = r.v[SH_BANCALINOS0];
+        prod.bancalinos0_turno = acc.count(SH_BANCALINOS0);
 
-        prod["bancalinos1_instantaneo"] = bancalinos1_clean;
-        prod["bancalinos1_turno"] = acc_bancalinos1_out;
+        prod.bancalinos1_instantaneo = r.v[SH_BANCALINOS1];
+        prod.bancalinos1_turno = acc.count(SH_BANCALINOS1);
 
-        prod["bancalinosComb1_instantaneo"] = bancalinosComb1_clean;
-        prod["bancalinosComb1_turno"] = acc_bancalinosComb1_out;
+        prod.bancalinosComb1_instantaneo = r.v[SH_BANCALINOS_COMB1];
+        prod.bancalinosComb1_turno = acc.count(SH_BANCALINOS_COMB1);
 
-        prod["bancalinosComb2_instantaneo"] = bancalinosComb2_clean;
-        prod["bancalinosComb2_turno"] = acc_bancalinosComb2_out;
+        prod.bancalinosComb2_instantaneo = r.v[SH_BANCALINOS_COMB2];
+        prod.bancalinosComb2_turno = acc.count(SH_BANCALINOS_COMB2);
 
-        prod["bancalinosTotal_raw"] = bancalinosTotal_raw;
-        prod["bancalinosTotal_turno"] = acc_bancalinosTotal_out;
-        prod["bit15_corruption_bancalinosTotal"] = corr_bancalinosTotal;
+        prod.bancalinosTotal_raw = bancalinosTotal_raw;
+        prod.bancalinosTotal_turno = acc.count(SH_BANCALINOS_TOTAL);
+        prod.bit15_corruption_bancalinosTotal = r.corrupted(SH_BANCALINOS_TOTAL);
 
         // CambioBarrera fields
-        prod["cambioBarrera_instantaneo"] = cambioBarrera_clean;
-        prod["cambioBarrera_turno"] = acc_cambioBarrera_out;
+        prod.cambioBarrera_instantaneo = r.v[SH_CAMBIO_BARRERA];
+        prod.cambioBarrera_turno = acc.count(SH_CAMBIO_BARRERA);
 
-        prod["cambioBarreraTotal_raw"] = cambioBarreraTotal_raw;
-        prod["cambioBarreraTotal_turno"] = acc_cambioBarreraTotal_out;
-        prod["bit15_corruption_cambioBarreraTotal"] = corr_cambioBarreraTotal;
+        prod.cambioBarreraTotal_raw = cambioBarreraTotal_raw;
+        prod.cambioBarreraTotal_turno = acc.count(SH_CAMBIO_BARRERA_TOTAL);
+        prod.bit15_corruption_cambioBarreraTotal = r.corrupted(SH_CAMBIO_BARRERA_TOTAL);
 
         // CambioSentido fields
-        prod["cambioSentido_instantaneo"] = cambioSentido_clean;
-        prod["cambioSentido_turno"] = acc_cambioSentido_out;
+        prod.cambioSentido_instantaneo = r.v[SH_CAMBIO_SENTIDO];
+        prod.cambioSentido_turno = acc.count(SH_CAMBIO_SENTIDO);
 
-        prod["cambioSentidoTotal_raw"] = cambioSentidoTotal_raw;
-        prod["cambioSentidoTotal_turno"] = acc_cambioSentidoTotal_out;
-        prod["bit15_corruption_cambioSentidoTotal"] = corr_cambioSentidoTotal;
+        prod.cambioSentidoTotal_raw = cambioSentidoTotal_raw;
+        prod.cambioSentidoTotal_turno = acc.count(SH_CAMBIO_SENTIDO_TOTAL);
+        prod.bit15_corruption_cambioSentidoTotal = r.corrupted(SH_CAMBIO_SENTIDO_TOTAL);
 
         // Cantidad fields
-        prod["cantidad_instantanea"] = cantidad_clean;
-        prod["cantidad_raw"] = cantidad_raw;
-        prod["cantidad_produccion_turno"] = acc_cantidad_out;
-        prod["bit15_corruption_cantidad"] = corr_cantidad;
+        prod.cantidad_instantanea = r.v[SH_CANTIDAD];
+        prod.cantidad_raw = cantidad_raw;
+        prod.cantidad_produccion_turno = acc.count(SH_CANTIDAD);
+        prod.bit15_corruption_cantidad = r.corrupted(SH_CANTIDAD);
 
-        prod["cantidad_total_raw"] = cantidad_total_raw;
-        prod["cantidad_total_turno"] = acc_cantidad_total_out;
-        prod["bit15_corruption_cantidad_total"] = corr_cantidad_total;
+        prod.cantidad_total_raw = cantidad_total_raw;
+        prod.cantidad_total_turno = acc.count(SH_CANTIDAD_TOTAL);
+        prod.bit15_corruption_cantidad_total = r.corrupted(SH_CANTIDAD_TOTAL);
 
         // Paradas fields
-        prod["paradas_1_instantaneo"] = paradas_1_clean;
-        prod["paradas_1_turno"] = acc_paradas_1_out;
+        prod.paradas_1_instantaneo = r.v[SH_PARADAS_1];
+        prod.paradas_1_turno = acc.count(SH_PARADAS_1);
 
-        prod["paradas_2_instantaneo"] = paradas_2_clean;
-        prod["paradas_2_turno"] = acc_paradas_2_out;
+        prod.paradas_2_instantaneo = r.v[SH_PARADAS_2];
+        prod.paradas_2_turno = acc.count(SH_PARADAS_2);
 
-        // Timer fields
-        prod["timer1Hz_instantaneo"] = timer1Hz_clean;
-        prod["tiempo_operacion_turno_s"] = acc_tiempo_operacion_s_out;
+        // Timer fields (timer1Hz counts seconds)
+        prod.timer1Hz_instantaneo = r.v[SH_TIMER_1HZ];
+        prod.tiempo_operacion_turno_s = acc.count(SH_TIMER_1HZ);
 
-        prod["timestamp_device"] = iso8601_utc_now();
+        prod.timestamp_device = ctx.ts.view();
 
         // Alarms
-        json qual;
-        qual["alarms"] = alarms;
-        qual["timestamp_device"] = iso8601_utc_now();
+        AlarmsOut qual{};
+        qual.alarms = alarms;
+        qual.timestamp_device = ctx.ts.view();
 
-        auto t1 = isa95_prefix + std::to_string(line) + "/salida_horno/alarms";
-        auto t2 = isa95_prefix + std::to_string(line) + "/salida_horno/production";
+        const auto [t1, t2] = topics_.at(isa95_prefix, line);
 
-        return { make_pub(t1, qual), make_pub(t2, prod) };
+        publish_alarm(sink, t1, qual, ALARMS_SCHEMA);
+        publish(sink, t2, prod, SALIDA_HORNO_PROD_SCHEMA);
     }
 };
 
 // Static definitions
-std::mutex SalidaHornoProcessor::mtx_;
-std::unordered_map<int, SalidaHornoProcessor::State>
-    SalidaHornoProcessor::states_;
+thread_local LineStates<SalidaHornoProcessor::State>
+    SalidaHornoProcessor::states_{DeviceType::Salida_horno};
+thread_local topics::LineTopics<2>
+    SalidaHornoProcessor::topics_{{"/salida_horno/alarms", "/salida_horno/production"}};
 
 
 std::unique_ptr<IMessageProcessor> createDefaultProcessor()
@@ -1747,9 +1636,9 @@ std::unique_ptr<IMessageProcessor> createProcessor(DeviceType dt)
     switch (dt)
     {
     case DeviceType::PH_1:
-        return std::make_unique<PrensaHidraulica1Processor>();
+        return std::make_unique<PrensaHidraulicaProcessor<DeviceType::PH_1>>();
     case DeviceType::PH_2:
-        return std::make_unique<PrensaHidraulica2Processor>();
+        return std::make_unique<PrensaHidraulicaProcessor<DeviceType::PH_2>>();
     case DeviceType::Calidad:
         return std::make_unique<CalidadProcessor>();
     case DeviceType::Entrada_secador:
@@ -1767,14 +1656,78 @@ std::unique_ptr<IMessageProcessor> createProcessor(DeviceType dt)
     }
 }
 
-void reset_all_processor_states()
+ProcessorTable::ProcessorTable()
+{
+    procs_[0] = createDefaultProcessor();
+    for (int i = 1; i < static_cast<int>(procs_.size()); ++i) {
+        auto dt = deviceTypeFromInt(i);
+        procs_[i] = dt ? createProcessor(*dt) : createDefaultProcessor();
+    }
+}
+
+std::vector<DeviceSnapshot> close_shift(const ShiftChange &ev)
+{
+    const ShiftConfig &cfg = shift_config();
+    // The plant boundary closes every line without its own schedule.
+    auto applies = [&](int line) { return ev.line >= 0 ? line == ev.line : !cfg.has_override(line); };
+
+    std::vector<DeviceSnapshot> snaps;
+    CalidadProcessor::close_lines(ev, applies, snaps);
+    EntradaHornoProcessor::close_lines(ev, applies, snaps);
+    EntradaSecadorProcessor::close_lines(ev, applies, snaps);
+    EsmalteProcessor::close_lines(ev, applies, snaps);
+    PrensaHidraulicaProcessor<DeviceType::PH_1>::close_lines(ev, applies, snaps);
+    PrensaHidraulicaProcessor<DeviceType::PH_2>::close_lines(ev, applies, snaps);
+    SalidaHornoProcessor::close_lines(ev, applies, snaps);
+    SalidaSecadorProcessor::close_lines(ev, applies, snaps);
+    return snaps;
+}
+
+ShiftSummaryCollector::ShiftSummaryCollector(unsigned shards)
+    : shards_(shards ? shards : 1)
+{
+}
+
+void ShiftSummaryCollector::add(const ShiftChange &ev, std::vector<DeviceSnapshot> snaps,
+                                const std::string &isa95_prefix, PublicationSink &out)
 {
-    PrensaHidraulica1Processor::reset_states();
-    PrensaHidraulica2Processor::reset_states();
-    SalidaSecadorProcessor::reset_states();
-    EntradaSecadorProcessor::reset_states();
-    EsmalteProcessor::reset_states();
-    EntradaHornoProcessor::reset_states();
-    SalidaHornoProcessor::reset_states();
-    CalidadProcessor::reset_states();   // si lo tienes
+    std::vector<DeviceSnapshot> all;
+    {
+        std::lock_guard<std::mutex> lk(mu_);
+        Pending &p = pending_[{ev.at, ev.line}];
+        p.snaps.insert(p.snaps.end(), std::make_move_iterator(snaps.begin()),
+                       std::make_move_iterator(snaps.end()));
+        if (++p.reported < shards_) return;
+        all = std::move(p.snaps);
+        pending_.erase({ev.at, ev.line});
+    }
+
+    // One message per line, devices in key order.
+    std::sort(all.begin(), all.end(), [](const DeviceSnapshot &a, const DeviceSnapshot &b) {
+        return a.line != b.line ? a.line < b.line : a.device < b.device;
+    });
+
+    const IsoTimestamp closed_at = iso8601_utc(std::chrono::system_clock::from_time_t(ev.at));
+    for (std::size_t i = 0; i < all.size();) {
+        const int line = all[i].line;
+        const auto topic = topics::intern(isa95_prefix + std::to_string(line) + "/shift_summary");
+        out.emit(topic, [&](jsonw::Writer &w) {
+            w.raw(std::string_view("{\"closed_at\":"));
+            w.value(closed_at.view());
+            w.raw(std::string_view(",\"devices\":{"));
+            for (bool first = true; i < all.size() && all[i].line == line; ++i, first = false) {
+                if (!first) w.raw(',');
+                w.value(all[i].device);
+                w.raw(':');
+                w.raw(all[i].json);
+            }
+            w.raw(std::string_view("},\"lineID\":"));
+            w.value(line);
+            w.raw(std::string_view(",\"next_turno\":"));
+            w.value(ev.opened_shift);
+            w.raw(std::string_view(",\"turno\":"));
+            w.value(ev.closed_shift);
+            w.raw('}');
+        });
+    }
 }
@@ -0,0 +1,165 @@
+#include "Metrics.hpp"
+#include <utility>
+#include "DeviceTypes.hpp"
+#include "Logger.hpp"
+#include "TimeUtils.hpp"
+
+namespace metrics {
+
+Registry& registry() {
+    static Registry r;
+    return r;
+}
+
+// ---------------------------------------------------------------------------
+// Histogram
+
+unsigned Histogram::index(uint64_t v) {
+    if (v < SUB) return static_cast<unsigned>(v);
+    const unsigned msb = 63u - static_cast<unsigned>(__builtin_clzll(v));
+    if (msb > MAX_MSB) return BUCKETS - 1;
+    const unsigned shift = msb - SUB_BITS;
+    return (shift + 1) * SUB + static_cast<unsigned>((v >> shift) - SUB);
+}
+
+uint64_t Histogram::upper_bound(unsigned idx) {
+    if (idx < SUB) return idx;
+    const unsigned shift = idx / SUB - 1;
+    const uint64_t lower = static_cast<uint64_t>(SUB + idx % SUB) << shift;
+    return lower + (uint64_t{1} << shift) - 1;
+}
+
+Histogram::Snapshot Histogram::snapshot() const {
+    Snapshot s;
+    for (unsigned i = 0; i < BUCKETS; ++i) {
+        s.buckets[i] = buckets_[i].load(std::memory_order_relaxed);
+        s.count += s.buckets[i];
+    }
+    s.sum = sum_.load(std::memory_order_relaxed);
+    return s;
+}
+
+Histogram::Snapshot Histogram::Snapshot::operator-(const Snapshot& older) const {
+    Snapshot d;
+    for (unsigned i = 0; i < BUCKETS; ++i) d.buckets[i] = buckets[i] - older.buckets[i];
+    d.count = count - older.count;
+    d.sum   = sum - older.sum;
+    return d;
+}
+
+uint64_t Histogram::Snapshot::quantile(double q) const {
+    if (count == 0) return 0;
+    // Rank of the quantile, 1-based: the first bucket reaching it holds it.
+    uint64_t rank = static_cast<uint64_t>(q * static_cast<double>(count) + 0.5);
+    if (rank < 1) rank = 1;
+    if (rank > count) rank = count;
+    uint64_t seen = 0;
+    for (unsigned i = 0; i < BUCKETS; ++i) {
+        seen += buckets[i];
+        if (seen >= rank) return upper_bound(i);
+    }
+    return upper_bound(BUCKETS - 1);
+}
+
+uint64_t Histogram::Snapshot::max() const {
+    for (unsigned i = BUCKETS; i-- > 0;)
+        if (buckets[i]) return upper_bound(i);
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+// Reporter
+
+Reporter::Reporter(ReporterOptions opts, Extend extend, Sink sink)
+    : opts_(opts)
+    , extend_(std::move(extend))
+    , sink_(std::move(sink))
+{
+}
+
+Reporter::~Reporter() {
+    stop();
+}
+
+void Reporter::start() {
+    if (opts_.interval_s == 0) return;
+    {
+        std::lock_guard<std::mutex> lk(mu_);
+        if (running_) return;
+        running_ = true;
+    }
+    thread_ = std::thread(&Reporter::run, this);
+    LOG_INFO(Pub) << "[METRICS] Reporting every " << opts_.interval_s << " s";
+}
+
+void Reporter::stop() {
+    {
+        std::lock_guard<std::mutex> lk(mu_);
+        if (!running_) return;
+        running_ = false;
+    }
+    cv_.notify_all();
+    if (thread_.joinable()) thread_.join();
+}
+
+void Reporter::run() {
+    std::unique_lock<std::mutex> lk(mu_);
+    while (running_) {
+        if (cv_.wait_for(lk, std::chrono::seconds(opts_.interval_s), [this] { return !running_; }))
+            break;
+        lk.unlock();
+        try {
+            sink_(render());
+        } catch (const std::exception& e) {
+            LOG_WARN(Pub) << "[METRICS] Report failed: " << e.what();
+        }
+        lk.lock();
+    }
+}
+
+static nlohmann::json interval_json(const Histogram::Snapshot& d) {
+    return nlohmann::json{
+        {"count", d.count},
+        {"max",   d.max()},
+        {"p50",   d.quantile(0.50)},
+        {"p90",   d.quantile(0.90)},
+        {"p99",   d.quantile(0.99)},
+    };
+}
+
+// Reports the interval since the previous call and makes `now` the new base.
+static nlohmann::json advance(const Histogram& h, Histogram::Snapshot& prev) {
+    Histogram::Snapshot now = h.snapshot();
+    nlohmann::json j = interval_json(now - prev);
+    prev = now;
+    return j;
+}
+
+std::string Reporter::render() {
+    Registry& r = registry();
+    nlohmann::json j;
+    {
+        std::lock_guard<std::mutex> lk(render_mu_);
+        j["counters"] = {
+            {"bit15_corruption",    r.bit15_corruption.value()},
+            {"invalid_json",        r.invalid_json.value()},
+            {"messages",            r.messages.value()},
+            {"safe_delta_rejected", r.safe_delta_rejected.value()},
+        };
+
+        nlohmann::json& lat = j["latency_ns"];
+        lat["parse"]     = advance(r.parse, prev_parse_);
+        lat["serialize"] = advance(r.serialize, prev_serialize_);
+        lat["publish"]   = advance(r.publish, prev_publish_);
+        nlohmann::json& proc = lat["process"];
+        for (std::size_t i = 0; i < r.process.size(); ++i) {
+            auto dt = deviceTypeFromInt(static_cast<int>(i));
+            proc[dt ? deviceTypeName(*dt) : "Unknown"] = advance(r.process[i], prev_process_[i]);
+        }
+    }
+    j["ts"] = std::string(iso8601_utc().view());
+    if (extend_) extend_(j);
+    return j.dump();
+}
+
+} // namespace metrics
@@ -1,13 +1,14 @@
 #include "MqttApp.hpp"
-#include "JsonUtils.hpp"
+#include "Uplink.hpp"
 #include "MessageProcessor.hpp"
 #include "DeviceTypes.hpp"
-#include <iostream>
+#include "DataQuality.hpp"
+#include "Logger.hpp"
+#include "StateStore.hpp"
 #include <thread>
 #include <chrono>
 #include <mqtt/async_client.h>
 #include <vector>
-#include <Shift.hpp>
 
 
 using namespace std::chrono_literals;
@@ -20,14 +21,71 @@ static const std::vector<std::string> TOPICS = {
 };
 static const std::vector<int> QOS = {1,1,1,1};
 
-MqttApp::MqttApp(std::string broker_uri, std::string client_id, std::string isa95_prefix)
+// Publications of the item a worker is handling. Reused across items, so
+// once its buffers have grown, processing a message allocates nothing.
+static thread_local PublicationSink t_pubs;
+
+// Shift boundaries reach the processors' (thread_local) state as control
+// items on the worker shards. Inline processing has no shard the scheduler
+// can wake, so an idle plant would never roll over: always run a worker.
+static IngestOptions with_worker_shards(IngestOptions opts) {
+    if (opts.workers == 0) {
+        LOG_WARN(Ingest) << "Ignoring INGEST_WORKERS=0: shift boundaries need a worker shard (using 1)";
+        opts.workers = 1;
+    }
+    return opts;
+}
+
+// Let Paho queue publishes while disconnected, up to the window's buffer.
+static mqtt::create_options make_create_options(const PublishOptions& opts) {
+    mqtt::create_options copts(MQTTVERSION_DEFAULT, static_cast<int>(opts.max_buffered));
+    copts.set_send_while_disconnected(true);
+    copts.set_delete_oldest_messages(false);
+    return copts;
+}
+
+MqttApp::MqttApp(std::string broker_uri, std::string client_id, std::string isa95_prefix,
+                 IngestOptions ingest, JournalOptions journal, CoalesceOptions coalesce,
+                 PublishOptions publish, SpoolOptions spool, metrics::ReporterOptions metrics)
     : broker_(std::move(broker_uri))
     , client_id_(std::move(client_id))
     , isa95_prefix_(std::move(isa95_prefix))
-    , cli_(broker_, client_id_)
+    , window_(publish)
+    , cli_(broker_, client_id_, make_create_options(publish))
+    , pipeline_(with_worker_shards(ingest), [this](IngestItem& item) { handle_ingest(item); })
+    , summaries_(pipeline_.options().workers)
+    , shifts_(shift_config(), [this](const ShiftChange& ev) {
+        IngestItem item;
+        item.kind         = IngestItem::Kind::ShiftChange;
+        item.received     = std::chrono::system_clock::from_time_t(ev.at);
+        item.shift_change = ev;
+        pipeline_.post(item);
+    })
+    , meta_prefix_(isa95_prefix_ + (!isa95_prefix_.empty() && isa95_prefix_.back() == '/' ? "" : "/") +
+                   "_meta/")
+    , metrics_(metrics, [this](nlohmann::json& report) { add_stats(report); },
+               [this](const std::string& payload) {
+                   publish_qos1(meta_prefix_ + "metrics", payload);
+                   publish_qos1(meta_prefix_ + "data_quality", dq::render());
+               })
 {
+    if (!journal.dir.empty())
+        journal_ = std::make_unique<Journal>(std::move(journal));
+    if (coalesce.flush_ms > 0)
+        coalescer_ = std::make_unique<PublishCoalescer>(coalesce, [this](std::string_view topic,
+                                                                         const std::string& payload) {
+            publish_qos1(topic, payload);
+        });
+    if (!spool.dir.empty())
+        spool_ = std::make_unique<PublishSpool>(std::move(spool), [this](const std::string& topic,
+                                                                         const std::string& payload) {
+            // Not sent (offline, or no room in the window): the record stays spooled.
+            return window_.connected() && send_qos1(topic, payload);
+        });
+
     connopts_.set_clean_session(false);
     connopts_.set_automatic_reconnect(true);
+    connopts_.set_max_inflight(static_cast<int>(publish.max_inflight));
     cli_.set_callback(*this);
 }
 
@@ -37,13 +95,33 @@ MqttApp::~MqttApp() {
 
 void MqttApp::start() {
     running_ = true;
+    if (journal_) {
+        std::string err;
+        if (!journal_->start(err)) {
+            LOG_ERROR(Ingest) << "[JOURNAL] Disabled: " << err;
+            journal_.reset();
+        }
+    }
+    if (spool_) {
+        std::string err;
+        if (!spool_->open(err)) {
+            LOG_ERROR(Pub) << "[SPOOL] Disabled: " << err;
+            spool_.reset();
+        }
+    }
+    if (coalescer_) coalescer_->start();
+    pipeline_.start();
+    shifts_.start();
+    metrics_.start();
     try {
-        std::cout << "[MQTT] Connecting to " << broker_ << " as " << client_id_ << "...\n";
+        LOG_INFO(MQTT) << "[MQTT] Connecting to " << broker_ << " as " << client_id_ << "...";
         cli_.connect(connopts_)->wait();
-        std::cout << "[MQTT] Connected.\n";
+        window_.set_connected(true);
+        LOG_INFO(MQTT) << "[MQTT] Connected.";
         subscribe_topics();
+        if (spool_) spool_->request_drain();
     } catch (const mqtt::exception& e) {
-        std::cerr << "[MQTT] Connect failed: " << e.what() << "\n";
+        LOG_ERROR(MQTT) << "[MQTT] Connect failed: " << e.what();
         throw;
     }
 }
@@ -56,12 +134,29 @@ void MqttApp::stop() {
 
         mqtt::properties props; // explicit, to satisfy some overload sets
         cli_.unsubscribe(topic_filters, props)->wait();
+    } catch (const mqtt::exception& e) {
+        LOG_WARN(MQTT) << "[MQTT] Unsubscribe error: " << e.what();
+    }
+
+    // Drain queued uplinks while we can still publish their results.
+    metrics_.stop();
+    shifts_.stop();
+    pipeline_.stop();
+    if (coalescer_) coalescer_->stop();
+    if (spool_) spool_->stop();
+    if (journal_) journal_->stop();
 
+    try {
         cli_.disconnect()->wait();
-        std::cout << "[MQTT] Disconnected.\n";
+        LOG_INFO(MQTT) << "[MQTT] Disconnected.";
     } catch (const mqtt::exception& e) {
-        std::cout << "[MQTT] Stop error: " << e.what() << "\n";
+        LOG_WARN(MQTT) << "[MQTT] Disconnect error: " << e.what();
     }
+    window_.set_connected(false);
+    auto ps = window_.stats();
+    LOG_INFO(Pub) << "[PUB] published=" << ps.published << " acked=" << ps.acked
+                  << " failed=" << ps.failed << " dropped=" << ps.dropped
+                  << " unacknowledged=" << ps.inflight + ps.buffered;
 }
 
 
@@ -74,21 +169,29 @@ void MqttApp::subscribe_topics() {
 
         cli_.subscribe(topic_filters, qos_vals, sub_opts);
 
-        std::cout << "[MQTT] Trying subscription to topics (QoS1):";
-        for (auto& t : TOPICS) std::cout << " " << t;
-        std::cout << "\n";
+        if (logx::should_log(logx::Level::Info, logx::Cat::MQTT)) {
+            logx::Line line(logx::Level::Info, logx::Cat::MQTT);
+            line << "[MQTT] Trying subscription to topics (QoS1):";
+            for (auto& t : TOPICS) line << " " << t;
+        }
     } catch (const mqtt::exception& e) {
-        std::cout << "[MQTT] Subscribe failed: " << e.what() << "\n";
+        LOG_ERROR(MQTT) << "[MQTT] Subscribe failed: " << e.what();
     }
 }
 
 void MqttApp::connected(const std::string& cause) {
-    std::cout << "[MQTT] Connected callback. Cause: " << cause << "\n";
+    LOG_INFO(MQTT) << "[MQTT] Connected callback. Cause: " << cause;
+    window_.set_connected(true);
     subscribe_topics();
+    if (spool_) spool_->request_drain();
 }
 
 void MqttApp::connection_lost(const std::string& cause) {
-    std::cout << "[MQTT] Connection lost: " << cause << "\n";
+    window_.set_connected(false);
+    auto ps = window_.stats();
+    LOG_WARN(MQTT) << "[MQTT] Connection lost: " << cause << " (" << ps.buffered
+                   << " publication(s) buffered until reconnect"
+                   << (spool_ ? ", new ones spooled to disk)" : ")");
 }
 
 void MqttApp::message_arrived(mqtt::const_message_ptr msg) {
@@ -97,71 +200,197 @@ void MqttApp::message_arrived(mqtt::const_message_ptr msg) {
         const auto& payload = msg->to_string();
 
         if (topic == "celima/data") {
-            std::cout << "[celima/data] " << payload << "\n";
-            handle_celima_data(payload);
+            // Route by the decoded (deviceType, lineID) so each line stays on one worker shard.
+            IngestItem item{topic, payload};
+            item.received   = std::chrono::system_clock::now();
+            const UplinkRoute route = route_uplink(item.payload);
+            item.deviceType = route.deviceType;
+            item.lineID     = route.lineID;
+            if (journal_) journal_->append(item.received, item.payload);
+            pipeline_.submit(std::move(item));
         } else if (topic == "celima/error") {
-            std::cerr << "[celima/error] " << payload << "\n";
+            LOG_WARN(Data) << "[celima/error] " << payload;
         } else if (topic == "celima/join") {
-            std::cout << "[celima/join] " << payload << "\n";
+            LOG_INFO(Data) << "[celima/join] " << payload;
         } else if (topic == "celima/ACK") {
-            std::cout << "[celima/ACK] " << payload << "\n";
+            LOG_INFO(Data) << "[celima/ACK] " << payload;
         } else {
-            std::cout << "[MQTT] Message on " << topic << " (ignored)\n";
+            LOG_DEBUG(MQTT) << "[MQTT] Message on " << topic << " (ignored)";
         }
     } catch (const std::exception& e) {
-        std::cout << "[MQTT] message_arrived error: " << e.what() << "\n";
+        LOG_ERROR(MQTT) << "[MQTT] message_arrived error: " << e.what();
     }
 }
 
 void MqttApp::delivery_complete(mqtt::delivery_token_ptr tok) {
-    if (tok && tok->get_message_id() != 0)
-        std::cout << "[MQTT] Delivery complete. MID=" << tok->get_message_id() << "\n";
+    window_.complete(true);
+    if (tok && tok->get_message_id() != 0) {
+        LOG_DEBUG(Pub) << "[MQTT] Delivery complete. MID=" << tok->get_message_id();
+    }
 }
 
 void MqttApp::on_success(const mqtt::token& tok) {
     (void)tok;
 }
 
+// Only publishes use this listener.
 void MqttApp::on_failure(const mqtt::token& tok) {
-    std::cout << "[MQTT] Action failed. Token: " << tok.get_message_id() << "\n";
+    window_.complete(false);
+    LOG_WARN(Pub) << "[MQTT] Publish failed. MID=" << tok.get_message_id();
 }
 
-void MqttApp::handle_celima_data(const std::string& payload) {
+// Runs on an IngestPipeline worker thread.
+void MqttApp::handle_ingest(IngestItem& item) {
+    if (item.kind == IngestItem::Kind::ShiftChange) {
+        handle_shift_change(item.shift_change);
+        return;
+    }
+    LOG_DEBUG(Data) << "[celima/data] " << item.payload;
+    handle_celima_data(item.payload, item.received);
+}
+
+void MqttApp::handle_celima_data(const std::string& payload, std::chrono::system_clock::time_point received) {
+    auto& m = metrics::registry();
+    m.messages.add();
+
     std::string err;
-    auto jopt = jsonu::parse(payload, err);
-    if (!jopt) {
-        std::cout << "[celima/data] Invalid JSON: " << err << " | payload=" << payload << "\n";
+    Uplink up;
+    bool decoded;
+    {
+        metrics::Timer t(m.parse);
+        decoded = decode_uplink(payload, up, err);
+    }
+    if (!decoded) {
+        m.invalid_json.add();
+        LOG_WARN(Data) << "[celima/data] Invalid JSON: " << err << " | payload=" << payload;
         return;
     }
-    auto& j = *jopt;
 
-    int devTypeInt = j.value("deviceType", 0);
-    auto dt = deviceTypeFromInt(devTypeInt);
-    std::unique_ptr<IMessageProcessor> proc = dt ? createProcessor(*dt)
-                                                 : createDefaultProcessor();
+    int devTypeInt = up.value(UF::deviceType, 0);
+    IMessageProcessor& proc = processors_.get(devTypeInt);
+    // The shift comes from the line the processor keys its state by.
+    const MessageContext ctx = make_message_context(received, up.value(UF::lineID, 0));
 
-    Shift sh  = current_shift_localtime();
-    int shiftNum = static_cast<int>(sh);
+    PublicationSink& pubs = t_pubs;
+    pubs.clear();
+    {
+        metrics::Timer t(metrics::process_histogram(devTypeInt));
+        proc.process(up, ctx, isa95_prefix_, pubs);
+    }
+    for (const Publication& p : pubs) {
+        if (coalescer_)
+            coalescer_->submit(p);
+        else
+            publish_qos1(p.topic, p.payload);
+    }
+}
 
-    if (detect_global_shift_change(shiftNum)) {
-        std::cout << "[SHIFT] Cambio de turno detectado. Reset global." << std::endl;
-        reset_all_processor_states();
+void MqttApp::handle_shift_change(const ShiftChange& ev) {
+    PublicationSink& pubs = t_pubs;
+    pubs.clear();
+    summaries_.add(ev, close_shift(ev), isa95_prefix_, pubs);
+    if (!pubs.empty()) {
+        LOG_INFO(Shift) << "[SHIFT] Turno " << ev.closed_shift << " cerrado: "
+                        << pubs.size() << " resumen(es) de linea";
+    }
+    // Each summary is a record of its own: spooled apart from earlier shifts' ones.
+    const std::string shift_record = std::to_string(ev.at);
+    for (const Publication& p : pubs) {
+        publish_qos1(p.topic, p.payload, shift_record);
     }
+    // Good moment to push the new shift's state to disk.
+    if (!pubs.empty()) pstore::sync();
+}
 
-    auto pubs = proc->process(j, isa95_prefix_);
-    for (auto& p : pubs) {
-        publish_qos1(p.topic, p.payload);
+void MqttApp::publish_qos1(std::string_view topic, std::string_view payload, std::string_view record) {
+    metrics::Timer t(metrics::registry().publish);
+    if (spool_) {
+        if (!window_.connected()) {
+            spool_->append(std::string(topic), std::string(payload), record);
+            return;
+        }
+        // Newer than anything spooled for this topic: never replay the older one after it.
+        if (record.empty() && !spool_->empty()) spool_->supersede(std::string(topic));
     }
+    if (send_qos1(topic, payload) || !spool_) return;
+    // The window stayed full (or Paho refused it): a shift summary in particular
+    // is never republished, so keep it for the drainer instead of losing it.
+    spool_->append(std::string(topic), std::string(payload), record);
+    spool_->request_drain();
 }
 
-void MqttApp::publish_qos1(const std::string& topic, const std::string& payload) {
-    auto msg = mqtt::make_message(topic, payload);
+bool MqttApp::send_qos1(std::string_view topic, std::string_view payload) {
+    // Waits (bounded) while the window is full; that is the ingest throttle.
+    if (!window_.acquire()) return false;
+
+    // Paho copies topic and payload into its own message (and the C client
+    // again into its command queue), so the views are not retained.
+    auto msg = mqtt::make_message(std::string(topic), payload.data(), payload.size());
     msg->set_qos(1);
     try {
-        cli_.publish(msg);
-        // fire-and-forget; Paho retains the token internally with QoS1
-        std::cout << "[PUB QoS1] " << topic << " <- " << payload << "\n";
+        // Completion comes back through delivery_complete() or on_failure().
+        cli_.publish(msg, nullptr, *this);
+        LOG_DEBUG(Pub) << "[PUB QoS1] " << topic << " <- " << payload;
+        return true;
     } catch (const mqtt::exception& e) {
-        std::cout << "[MQTT] Publish failed: " << e.what() << "\n";
+        window_.abandon();
+        LOG_ERROR(Pub) << "[MQTT] Publish failed: " << e.what();
+        return false;
+    }
+}
+
+void MqttApp::add_stats(nlohmann::json& report) const {
+    auto is = pipeline_.stats();
+    report["ingest"] = {
+        {"depth",          is.depth},
+        {"dropped_newest", is.dropped_newest},
+        {"dropped_oldest", is.dropped_oldest},
+        {"enqueued",       is.enqueued},
+        {"max_depth",      is.max_depth},
+        {"processed",      is.processed},
+    };
+    auto ps = window_.stats();
+    report["publish"] = {
+        {"acked",     ps.acked},
+        {"buffered",  ps.buffered},
+        {"connected", window_.connected()},
+        {"dropped",   ps.dropped},
+        {"failed",    ps.failed},
+        {"inflight",  ps.inflight},
+        {"published", ps.published},
+    };
+    if (coalescer_) {
+        auto cs = coalescer_->stats();
+        report["coalesce"] = {
+            {"coalesced",  cs.coalesced},
+            {"flushes",    cs.flushes},
+            {"published",  cs.published},
+            {"submitted",  cs.submitted},
+            {"suppressed", cs.suppressed},
+        };
+    }
+    if (journal_) {
+        auto js = journal_->stats();
+        report["journal"] = {
+            {"blocks",     js.blocks},
+            {"disk_bytes", js.disk_bytes},
+            {"dropped",    js.dropped},
+            {"errors",     js.errors},
+            {"pruned",     js.pruned},
+            {"raw_bytes",  js.raw_bytes},
+            {"records",    js.records},
+        };
+    }
+    if (spool_) {
+        auto ss = spool_->stats();
+        report["spool"] = {
+            {"bytes",       ss.bytes},
+            {"compactions", ss.compactions},
+            {"drained",     ss.drained},
+            {"dropped",     ss.dropped},
+            {"spooled",     ss.spooled},
+            {"superseded",  ss.superseded},
+            {"topics",      ss.topics},
+        };
     }
 }
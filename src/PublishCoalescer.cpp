@@ -0,0 +1,116 @@
+#include "PublishCoalescer.hpp"
+#include <utility>
+#include "Logger.hpp"
+
+PublishCoalescer::PublishCoalescer(CoalesceOptions opts, Sink sink)
+    : opts_(opts)
+    , sink_(std::move(sink))
+{
+}
+
+PublishCoalescer::~PublishCoalescer() {
+    stop();
+}
+
+void PublishCoalescer::start() {
+    {
+        std::lock_guard<std::mutex> lk(mu_);
+        if (running_) return;
+        running_ = true;
+    }
+    thread_ = std::thread(&PublishCoalescer::run, this);
+    LOG_INFO(Pub) << "[COALESCE] Flushing every " << opts_.flush_ms << " ms or at " << opts_.max_dirty
+                  << " pending topics; unchanged alarms republished after "
+                  << opts_.alarm_max_stale.count() << " s";
+}
+
+void PublishCoalescer::stop() {
+    {
+        std::lock_guard<std::mutex> lk(mu_);
+        if (!running_) return;
+        running_ = false;
+    }
+    cv_.notify_all();
+    if (thread_.joinable()) thread_.join();
+
+    auto s = stats();
+    LOG_INFO(Pub) << "[COALESCE] Stopped. submitted=" << s.submitted << " published=" << s.published
+                  << " coalesced=" << s.coalesced << " suppressed=" << s.suppressed
+                  << " flushes=" << s.flushes;
+}
+
+void PublishCoalescer::submit(const Publication& pub) {
+    submitted_.fetch_add(1, std::memory_order_relaxed);
+
+    bool flush_now = false;
+    {
+        std::lock_guard<std::mutex> lk(mu_);
+        auto [it, inserted] = topics_.try_emplace(pub.topic);
+        Entry& e = it->second;
+
+        if (e.dirty) {
+            // Not yet flushed: the newer payload replaces it.
+            coalesced_.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            if (pub.state && e.published_state == pub.state && opts_.alarm_max_stale.count() > 0 &&
+                Clock::now() - e.published_at < opts_.alarm_max_stale) {
+                suppressed_.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            e.dirty = true;
+            dirty_.push_back(&*it);
+            flush_now = dirty_.size() >= opts_.max_dirty;
+        }
+        e.payload.assign(pub.payload);
+        e.state   = pub.state;
+    }
+    if (flush_now) cv_.notify_one();
+}
+
+CoalesceStats PublishCoalescer::stats() const {
+    CoalesceStats s;
+    s.submitted  = submitted_.load(std::memory_order_relaxed);
+    s.published  = published_.load(std::memory_order_relaxed);
+    s.coalesced  = coalesced_.load(std::memory_order_relaxed);
+    s.suppressed = suppressed_.load(std::memory_order_relaxed);
+    s.flushes    = flushes_.load(std::memory_order_relaxed);
+    return s;
+}
+
+void PublishCoalescer::run() {
+    std::unique_lock<std::mutex> lk(mu_);
+    for (;;) {
+        cv_.wait_for(lk, std::chrono::milliseconds(opts_.flush_ms),
+                     [this] { return !running_ || dirty_.size() >= opts_.max_dirty; });
+        const bool stopping = !running_;
+        flush(lk);
+        if (stopping) break;
+    }
+}
+
+// Called with lk held; publishes with it released.
+void PublishCoalescer::flush(std::unique_lock<std::mutex>& lk) {
+    if (dirty_.empty()) return;
+
+    // Swap payloads into the batch: both sides keep their capacity.
+    if (batch_.size() < dirty_.size()) batch_.resize(dirty_.size());
+    const std::size_t n = dirty_.size();
+    const auto now = Clock::now();
+    for (std::size_t i = 0; i < n; ++i) {
+        auto* kv = dirty_[i];
+        Entry& e = kv->second;
+        e.dirty = false;
+        e.published_state = e.state;
+        e.published_at = now;
+        batch_[i].first = kv->first;
+        batch_[i].second.swap(e.payload);
+    }
+    dirty_.clear();
+
+    lk.unlock();
+    for (std::size_t i = 0; i < n; ++i) sink_(batch_[i].first, batch_[i].second);
+    lk.lock();
+
+    published_.fetch_add(n, std::memory_order_relaxed);
+    flushes_.fetch_add(1, std::memory_order_relaxed);
+}
@@ -0,0 +1,473 @@
+#include "PublishSpool.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <vector>
+#include <zlib.h>
+#include "Logger.hpp"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr std::size_t RECORD_HEADER = 3 * sizeof(uint32_t);
+// payload_len of a record that cancels the earlier ones of its topic
+constexpr uint32_t TOMBSTONE = 0xffffffffu;
+// pause before resuming a drain the sink interrupted
+constexpr auto DRAIN_RETRY = std::chrono::seconds(5);
+
+uint32_t record_crc(const char* topic, uint32_t topic_len, const char* payload, uint32_t payload_len) {
+    uLong crc = crc32(0L, reinterpret_cast<const Bytef*>(topic), topic_len);
+    // crc32() with a null buffer returns the initial value, not `crc`.
+    if (payload_len > 0) crc = crc32(crc, reinterpret_cast<const Bytef*>(payload), payload_len);
+    return static_cast<uint32_t>(crc);
+}
+
+bool write_all(int fd, const char* p, std::size_t n) {
+    while (n > 0) {
+        const ssize_t w = ::write(fd, p, n);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        p += w;
+        n -= static_cast<std::size_t>(w);
+    }
+    return true;
+}
+
+bool pread_all(int fd, char* p, std::size_t n, uint64_t off) {
+    while (n > 0) {
+        const ssize_t r = ::pread(fd, p, n, static_cast<off_t>(off));
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) return false;
+        p += r;
+        n -= static_cast<std::size_t>(r);
+        off += static_cast<uint64_t>(r);
+    }
+    return true;
+}
+
+} // namespace
+
+PublishSpool::PublishSpool(SpoolOptions opts, Sink sink)
+    : opts_(std::move(opts))
+    , sink_(std::move(sink))
+{
+}
+
+PublishSpool::~PublishSpool() {
+    stop();
+}
+
+std::string PublishSpool::segment_path(uint32_t id) const {
+    char name[32];
+    std::snprintf(name, sizeof(name), "spool-%010u.dat", id);
+    return (fs::path(opts_.dir) / name).string();
+}
+
+bool PublishSpool::open(std::string& err) {
+    std::error_code ec;
+    fs::create_directories(opts_.dir, ec);
+    if (ec) {
+        err = "create " + opts_.dir + ": " + ec.message();
+        return false;
+    }
+
+    std::vector<std::pair<uint32_t, std::string>> found;
+    for (const auto& e : fs::directory_iterator(opts_.dir, ec)) {
+        unsigned id = 0;
+        const std::string name = e.path().filename().string();
+        if (e.is_regular_file() && std::sscanf(name.c_str(), "spool-%u.dat", &id) == 1 && id > 0)
+            found.emplace_back(id, e.path().string());
+    }
+    if (ec) {
+        err = "read " + opts_.dir + ": " + ec.message();
+        return false;
+    }
+    std::sort(found.begin(), found.end());
+
+    {
+        std::lock_guard<std::mutex> lk(mu_);
+        for (const auto& [id, path] : found) {
+            load(path, id);
+            next_segment_ = std::max(next_segment_, id + 1);
+        }
+        trim();
+
+        pending_.store(index_.size(), std::memory_order_relaxed);
+        running_ = true;
+    }
+    thread_ = std::thread(&PublishSpool::run, this);
+
+    auto s = stats();
+    LOG_INFO(Pub) << "[SPOOL] " << opts_.dir << ": " << s.topics << " pending publication(s), "
+                  << s.bytes << " bytes (limit " << (opts_.max_bytes >> 20) << " MiB, drain "
+                  << opts_.drain_rate << "/s)";
+    return true;
+}
+
+void PublishSpool::load(const std::string& path, uint32_t id) {
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat st{};
+    if (fd < 0 || ::fstat(fd, &st) != 0) {
+        LOG_WARN(Pub) << "[SPOOL] Cannot read " << path << ": " << std::strerror(errno);
+        if (fd >= 0) ::close(fd);
+        return;
+    }
+    std::string data(static_cast<std::size_t>(st.st_size), '\0');
+    if (!pread_all(fd, data.data(), data.size(), 0)) data.clear();
+
+    Segment& seg = segments_[id];
+    seg.fd = fd;
+    seg.bytes = data.size();
+    bytes_ += seg.bytes;
+
+    std::size_t off = 0;
+    while (off + RECORD_HEADER <= data.size()) {
+        uint32_t h[3];
+        std::memcpy(h, data.data() + off, sizeof(h));
+        const uint32_t tlen = h[1];
+        const uint32_t plen = h[2] == TOMBSTONE ? 0 : h[2];
+        if (tlen > data.size() - off - RECORD_HEADER || plen > data.size() - off - RECORD_HEADER - tlen) break;
+        const char* topic = data.data() + off + RECORD_HEADER;
+        if (record_crc(topic, tlen, topic + tlen, plen) != h[0]) break;
+
+        std::string key(topic, tlen);
+        auto it = index_.find(key);
+        if (it != index_.end()) --segments_[it->second.segment].live;
+        if (h[2] == TOMBSTONE) {
+            if (it != index_.end()) index_.erase(it);
+        } else {
+            const Loc loc{next_seq_++, id, off, tlen, plen};
+            if (it != index_.end())
+                it->second = loc;
+            else
+                index_.emplace(std::move(key), loc);
+            ++seg.live;
+        }
+        off += RECORD_HEADER + tlen + plen;
+    }
+    if (off < data.size()) {
+        LOG_WARN(Pub) << "[SPOOL] " << path << ": damaged record at offset " << off
+                      << ", ignoring the rest of the segment";
+    }
+}
+
+void PublishSpool::stop() {
+    {
+        std::lock_guard<std::mutex> lk(mu_);
+        if (!running_) return;
+        running_ = false;
+    }
+    cv_.notify_all();
+    if (thread_.joinable()) thread_.join();
+
+    std::lock_guard<std::mutex> lk(mu_);
+    for (auto& [id, seg] : segments_) {
+        if (id == active_) ::fdatasync(seg.fd);
+        ::close(seg.fd);
+    }
+    segments_.clear();
+    LOG_INFO(Pub) << "[SPOOL] Stopped. pending=" << index_.size() << " spooled=" << spooled_.load()
+                  << " drained=" << drained_.load() << " superseded=" << superseded_.load()
+                  << " dropped=" << dropped_.load() << " compactions=" << compactions_.load();
+}
+
+void PublishSpool::append(const std::string& topic, const std::string& payload, std::string_view record) {
+    std::string key = topic;
+    if (!record.empty()) key.append(1, '\0').append(record);
+
+    std::lock_guard<std::mutex> lk(mu_);
+    if (!running_) return;
+
+    Loc loc{};
+    if (!write_record(key, payload.data(), static_cast<uint32_t>(payload.size()), loc)) {
+        LOG_ERROR(Pub) << "[SPOOL] Write failed: " << std::strerror(errno) << "; dropped publication on " << topic;
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    auto [it, inserted] = index_.try_emplace(std::move(key), loc);
+    if (!inserted) {
+        unlink_entry(it->second);
+        it->second = loc;
+        superseded_.fetch_add(1, std::memory_order_relaxed);
+    }
+    ++segments_[loc.segment].live;
+    spooled_.fetch_add(1, std::memory_order_relaxed);
+    pending_.store(index_.size(), std::memory_order_relaxed);
+
+    if (bytes_ > opts_.max_bytes) compact();
+}
+
+void PublishSpool::supersede(const std::string& topic) {
+    std::unique_lock<std::mutex> lk(mu_);
+    // The drainer is handing this topic's older state to the sink: let it
+    // reach Paho first, so the caller's newer one is published after it.
+    sink_done_.wait(lk, [&] { return draining_ != topic; });
+    auto it = index_.find(topic);
+    if (it == index_.end()) return;
+    unlink_entry(it->second);
+    index_.erase(it);
+    write_tombstone(topic);
+    superseded_.fetch_add(1, std::memory_order_relaxed);
+    pending_.store(index_.size(), std::memory_order_relaxed);
+}
+
+void PublishSpool::request_drain() {
+    {
+        std::lock_guard<std::mutex> lk(mu_);
+        if (index_.empty()) return;
+        drain_requested_ = true;
+    }
+    cv_.notify_all();
+}
+
+SpoolStats PublishSpool::stats() const {
+    SpoolStats s;
+    {
+        std::lock_guard<std::mutex> lk(mu_);
+        s.topics = index_.size();
+        s.bytes  = bytes_;
+    }
+    s.spooled     = spooled_.load(std::memory_order_relaxed);
+    s.drained     = drained_.load(std::memory_order_relaxed);
+    s.superseded  = superseded_.load(std::memory_order_relaxed);
+    s.dropped     = dropped_.load(std::memory_order_relaxed);
+    s.compactions = compactions_.load(std::memory_order_relaxed);
+    return s;
+}
+
+void PublishSpool::run() {
+    std::unique_lock<std::mutex> lk(mu_);
+    bool retry = false;   // the last pass was interrupted by the sink
+    for (;;) {
+        const auto woken = [this] { return !running_ || drain_requested_; };
+        if (retry)
+            cv_.wait_for(lk, DRAIN_RETRY, woken);
+        else
+            cv_.wait(lk, woken);
+        if (!running_) break;
+        if (drain_requested_ || !retry) {
+            LOG_INFO(Pub) << "[SPOOL] Draining " << index_.size() << " publication(s) at "
+                          << opts_.drain_rate << "/s";
+        }
+        drain_requested_ = false;
+
+        lk.unlock();
+        const bool done = drain_pass();
+        lk.lock();
+        retry = !done && running_ && !index_.empty();
+
+        if (done && index_.empty()) {
+            std::vector<uint32_t> ids;
+            for (const auto& [id, seg] : segments_) ids.push_back(id);
+            for (uint32_t id : ids) remove_segment(id);
+            active_ = 0;
+            LOG_INFO(Pub) << "[SPOOL] Drained.";
+        }
+    }
+}
+
+// Oldest first; false if interrupted (sink refused or stopping).
+bool PublishSpool::drain_pass() {
+    std::vector<std::pair<uint64_t, std::string>> order;
+    {
+        std::lock_guard<std::mutex> lk(mu_);
+        order.reserve(index_.size());
+        for (const auto& [topic, loc] : index_) order.emplace_back(loc.seq, topic);
+    }
+    std::sort(order.begin(), order.end());
+
+    using Clock = std::chrono::steady_clock;
+    const auto interval = opts_.drain_rate
+        ? std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / opts_.drain_rate))
+        : Clock::duration::zero();
+    auto next = Clock::now();
+
+    std::string payload;
+    for (const auto& [seq, key] : order) {
+        const std::string topic = key.substr(0, key.find('\0'));
+        {
+            std::lock_guard<std::mutex> lk(mu_);
+            if (!running_) return false;
+            auto it = index_.find(key);
+            if (it == index_.end() || it->second.seq != seq) continue;   // superseded meanwhile
+            if (!read_payload(it->second, payload)) {
+                LOG_WARN(Pub) << "[SPOOL] Unreadable record for " << topic << ", dropped";
+                unlink_entry(it->second);
+                index_.erase(it);
+                dropped_.fetch_add(1, std::memory_order_relaxed);
+                pending_.store(index_.size(), std::memory_order_relaxed);
+                continue;
+            }
+            // Still the latest: supersede() of this key now waits for the sink.
+            draining_ = key;
+        }
+
+        const bool sent = sink_(topic, payload);
+
+        std::unique_lock<std::mutex> lk(mu_);
+        draining_.clear();
+        sink_done_.notify_all();
+        if (!sent) return false;
+        auto it = index_.find(key);
+        if (it != index_.end() && it->second.seq == seq) {
+            unlink_entry(it->second);
+            index_.erase(it);
+            write_tombstone(key);
+            drained_.fetch_add(1, std::memory_order_relaxed);
+            pending_.store(index_.size(), std::memory_order_relaxed);
+        }
+        next += interval;
+        if (cv_.wait_until(lk, next, [this] { return !running_; })) return false;
+    }
+    return true;
+}
+
+bool PublishSpool::roll(std::string& err) {
+    const uint32_t id = next_segment_++;
+    const std::string path = segment_path(id);
+    const int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        err = "open " + path + ": " + std::strerror(errno);
+        return false;
+    }
+    if (active_ != 0) ::fdatasync(segments_[active_].fd);
+    const int dfd = ::open(opts_.dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dfd >= 0) {
+        ::fsync(dfd);
+        ::close(dfd);
+    }
+
+    segments_[id].fd = fd;
+    active_ = id;
+    // The previous active segment may already be all dead space.
+    trim();
+    return true;
+}
+
+// payload == nullptr writes a tombstone.
+bool PublishSpool::write_record(const std::string& topic, const char* payload, uint32_t payload_len, Loc& loc) {
+    std::string err;
+    if ((active_ == 0 || segments_[active_].bytes >= opts_.segment_bytes) && !roll(err)) {
+        LOG_ERROR(Pub) << "[SPOOL] " << err;
+        return false;
+    }
+
+    const auto tlen = static_cast<uint32_t>(topic.size());
+    if (!payload) payload_len = 0;
+    const uint32_t h[3] = {record_crc(topic.data(), tlen, payload, payload_len), tlen,
+                           payload ? payload_len : TOMBSTONE};
+
+    std::string rec;
+    rec.reserve(RECORD_HEADER + tlen + payload_len);
+    rec.append(reinterpret_cast<const char*>(h), sizeof(h));
+    rec.append(topic);
+    if (payload) rec.append(payload, payload_len);
+
+    Segment& seg = segments_[active_];
+    if (!write_all(seg.fd, rec.data(), rec.size())) {
+        // Whatever part made it is a torn record: start clean in a new segment.
+        roll(err);
+        return false;
+    }
+    loc = Loc{next_seq_++, active_, seg.bytes, tlen, payload_len};
+    seg.bytes += rec.size();
+    bytes_ += rec.size();
+    return true;
+}
+
+bool PublishSpool::read_payload(const Loc& loc, std::string& payload) const {
+    auto it = segments_.find(loc.segment);
+    if (it == segments_.end()) return false;
+    payload.resize(loc.payload_len);
+    return pread_all(it->second.fd, payload.data(), payload.size(),
+                     loc.offset + RECORD_HEADER + loc.topic_len);
+}
+
+void PublishSpool::write_tombstone(const std::string& topic) {
+    Loc loc{};
+    write_record(topic, nullptr, 0, loc);
+}
+
+void PublishSpool::unlink_entry(const Loc& loc) {
+    auto it = segments_.find(loc.segment);
+    if (it == segments_.end()) return;
+    if (--it->second.live == 0) trim();
+}
+
+// Segments go from the oldest end only, so a tombstone is never deleted
+// while an older record it cancels is still on disk.
+void PublishSpool::trim() {
+    while (!segments_.empty()) {
+        auto it = segments_.begin();
+        if (it->first == active_ || it->second.live > 0) break;
+        remove_segment(it->first);
+    }
+}
+
+void PublishSpool::remove_segment(uint32_t id) {
+    auto it = segments_.find(id);
+    if (it == segments_.end()) return;
+    ::close(it->second.fd);
+    ::unlink(segment_path(id).c_str());
+    bytes_ -= it->second.bytes;
+    segments_.erase(it);
+}
+
+void PublishSpool::compact() {
+    std::vector<std::pair<uint64_t, std::string>> order;
+    std::size_t live_bytes = 0;
+    for (const auto& [topic, loc] : index_) {
+        order.emplace_back(loc.seq, topic);
+        live_bytes += RECORD_HEADER + loc.topic_len + loc.payload_len;
+    }
+    std::sort(order.begin(), order.end());
+
+    // Evict the topics spooled longest ago until the rest fits comfortably.
+    const std::size_t budget = opts_.max_bytes / 4 * 3;
+    std::size_t first = 0;
+    for (; first < order.size() && live_bytes > budget; ++first) {
+        auto it = index_.find(order[first].second);
+        live_bytes -= RECORD_HEADER + it->second.topic_len + it->second.payload_len;
+        unlink_entry(it->second);
+        index_.erase(it);
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Copy the survivors, oldest first, into fresh segments and drop the old files.
+    std::vector<uint32_t> old;
+    for (const auto& [id, seg] : segments_) old.push_back(id);
+    active_ = 0;
+
+    std::string payload;
+    for (std::size_t i = first; i < order.size(); ++i) {
+        auto it = index_.find(order[i].second);
+        Loc loc{};
+        const bool ok = read_payload(it->second, payload) &&
+                        write_record(it->first, payload.data(), static_cast<uint32_t>(payload.size()), loc);
+        if (!ok) {
+            index_.erase(it);
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+        it->second = loc;
+        ++segments_[loc.segment].live;
+    }
+    for (uint32_t id : old) remove_segment(id);
+    if (active_ != 0) ::fdatasync(segments_[active_].fd);
+
+    pending_.store(index_.size(), std::memory_order_relaxed);
+    const uint64_t n = compactions_.fetch_add(1, std::memory_order_relaxed) + 1;
+    LOG_WARN(Pub) << "[SPOOL] Over " << (opts_.max_bytes >> 20) << " MiB: compacted to " << index_.size()
+                  << " topic(s), " << bytes_ << " bytes (" << dropped_.load() << " dropped so far, compaction #" << n << ")";
+}
@@ -0,0 +1,85 @@
+#include "PublishWindow.hpp"
+#include <algorithm>
+#include <chrono>
+#include "Logger.hpp"
+
+PublishWindow::PublishWindow(PublishOptions opts)
+    : opts_(opts)
+{
+}
+
+bool PublishWindow::acquire() {
+    const uint64_t limit = static_cast<uint64_t>(opts_.max_inflight) + opts_.max_buffered;
+    std::unique_lock<std::mutex> lk(mu_);
+    if (outstanding_ >= limit) {
+        if (!throttled_) {
+            throttled_ = true;
+            LOG_WARN(Pub) << "[PUB] Publish window full (" << outstanding_ << " unacknowledged, "
+                          << (connected_ ? "connected" : "disconnected") << "): throttling ingest";
+        }
+        if (!cv_.wait_for(lk, std::chrono::milliseconds(opts_.block_ms),
+                          [&] { return outstanding_ < limit; })) {
+            const uint64_t n = dropped_.fetch_add(1, std::memory_order_relaxed) + 1;
+            // Log on 1, 2, 4, 8, ... drops so a long outage does not flood stdout.
+            if ((n & (n - 1)) == 0) {
+                LOG_WARN(Pub) << "[PUB] No room in the publish window after " << opts_.block_ms
+                              << " ms: dropped " << n << " publication(s) so far";
+            }
+            return false;
+        }
+    }
+    ++outstanding_;
+    published_.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+void PublishWindow::complete(bool acked) {
+    (acked ? acked_ : failed_).fetch_add(1, std::memory_order_relaxed);
+    release();
+}
+
+void PublishWindow::abandon() {
+    published_.fetch_sub(1, std::memory_order_relaxed);
+    dropped_.fetch_add(1, std::memory_order_relaxed);
+    release();
+}
+
+void PublishWindow::set_connected(bool connected) {
+    connected_.store(connected, std::memory_order_relaxed);
+}
+
+void PublishWindow::release() {
+    const uint64_t limit = static_cast<uint64_t>(opts_.max_inflight) + opts_.max_buffered;
+    bool resumed = false;
+    {
+        std::lock_guard<std::mutex> lk(mu_);
+        if (outstanding_ > 0) --outstanding_;
+        // Hysteresis: report recovery once the window is half empty.
+        if (throttled_ && outstanding_ <= limit / 2) {
+            throttled_ = false;
+            resumed = true;
+        }
+    }
+    cv_.notify_one();
+    if (resumed) {
+        LOG_INFO(Pub) << "[PUB] Publish window drained; ingest resumed";
+    }
+}
+
+PublishStats PublishWindow::stats() const {
+    PublishStats s;
+    uint64_t outstanding;
+    {
+        std::lock_guard<std::mutex> lk(mu_);
+        outstanding = outstanding_;
+    }
+    // Paho keeps at most max_inflight on the wire; the rest waits in its queue.
+    s.inflight  = connected_.load(std::memory_order_relaxed)
+                      ? std::min<uint64_t>(outstanding, opts_.max_inflight) : 0;
+    s.buffered  = outstanding - s.inflight;
+    s.published = published_.load(std::memory_order_relaxed);
+    s.acked     = acked_.load(std::memory_order_relaxed);
+    s.failed    = failed_.load(std::memory_order_relaxed);
+    s.dropped   = dropped_.load(std::memory_order_relaxed);
+    return s;
+}
@@ -0,0 +1,93 @@
+#include "Replay.hpp"
+#include <vector>
+#include "Journal.hpp"
+#include "Logger.hpp"
+#include "Shift.hpp"
+
+namespace {
+
+// Fires the boundaries ShiftScheduler would have fired live.
+class BoundaryReplayer {
+public:
+    BoundaryReplayer() {
+        const ShiftConfig& cfg = shift_config();
+        entries_.push_back({-1, ShiftCalendar(cfg.plant)});
+        for (const auto& [line, b] : cfg.line_boundaries)
+            entries_.push_back({line, ShiftCalendar(cfg.for_line(line))});
+    }
+
+    // Call with non-decreasing t; `fire` runs for every boundary in (last t, t].
+    template <typename F>
+    void advance(std::time_t t, F&& fire) {
+        for (auto& e : entries_) {
+            if (!started_) {
+                e.cal.at(t);
+                continue;
+            }
+            while (t >= e.cal.next_boundary()) {
+                ShiftChange ev;
+                ev.line         = e.line;
+                ev.at           = e.cal.next_boundary();
+                ev.closed_shift = e.cal.current();
+                ev.opened_shift = e.cal.at(ev.at);
+                fire(ev);
+            }
+        }
+        started_ = true;
+    }
+
+private:
+    struct Entry {
+        int line;
+        ShiftCalendar cal;
+    };
+    std::vector<Entry> entries_;
+    bool started_ = false;
+};
+
+} // namespace
+
+bool replay_journal(const std::string& dir, const std::string& isa95_prefix,
+                    const std::function<void(const Publication&)>& sink,
+                    ReplayStats& stats, std::string& err) {
+    ProcessorTable processors;
+    ShiftSummaryCollector summaries(1);
+    BoundaryReplayer boundaries;
+    PublicationSink pubs;
+
+    const auto t0 = std::chrono::steady_clock::now();
+    const bool ok = Journal::read(dir, [&](std::chrono::system_clock::time_point received,
+                                           std::string_view payload) {
+        boundaries.advance(std::chrono::system_clock::to_time_t(received), [&](const ShiftChange& ev) {
+            ++stats.shift_closes;
+            pubs.clear();
+            summaries.add(ev, close_shift(ev), isa95_prefix, pubs);
+            for (const Publication& p : pubs) {
+                ++stats.publications;
+                sink(p);
+            }
+        });
+
+        ++stats.messages;
+        std::string decode_err;
+        Uplink up;
+        if (!decode_uplink(payload, up, decode_err)) {
+            ++stats.invalid;
+            return;
+        }
+        try {
+            pubs.clear();
+            processors.get(up.value(UF::deviceType, 0))
+                .process(up, make_message_context(received, up.value(UF::lineID, 0)), isa95_prefix, pubs);
+            for (const Publication& p : pubs) {
+                ++stats.publications;
+                sink(p);
+            }
+        } catch (const std::exception& e) {
+            ++stats.invalid;
+            LOG_WARN(Data) << "[REPLAY] Processor error: " << e.what();
+        }
+    }, err);
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    return ok;
+}
@@ -0,0 +1,271 @@
+#include "Shift.hpp"
+#include <algorithm>
+#include <charconv>
+#include <unordered_map>
+
+namespace {
+
+// Holidays can chain (e.g. a plant shutdown week); look this far for a boundary.
+constexpr int MAX_SCAN_DAYS = 400;
+
+ShiftConfig g_config;
+
+// Local `day` shifted by day_offset days, at `minute` minutes after midnight.
+// tm_isdst = -1 lets mktime pick the DST offset in effect at that instant.
+// If `date` is given it receives the normalized calendar date as YYYYMMDD.
+std::time_t local_instant(const std::tm& day, int day_offset, int minute, int* date = nullptr) {
+    std::tm x{};
+    x.tm_year  = day.tm_year;
+    x.tm_mon   = day.tm_mon;
+    x.tm_mday  = day.tm_mday + day_offset;
+    x.tm_hour  = minute / 60;
+    x.tm_min   = minute % 60;
+    x.tm_isdst = -1;
+    const std::time_t t = std::mktime(&x);
+    if (date) *date = (x.tm_year + 1900) * 10000 + (x.tm_mon + 1) * 100 + x.tm_mday;
+    return t;
+}
+
+std::string_view trim(std::string_view s) {
+    while (!s.empty() && (s.front() == ' ' || s.front() == '\t')) s.remove_prefix(1);
+    while (!s.empty() && (s.back() == ' ' || s.back() == '\t')) s.remove_suffix(1);
+    return s;
+}
+
+template <typename F>
+bool split(std::string_view s, char sep, F&& each) {
+    while (true) {
+        const std::size_t pos = s.find(sep);
+        if (!each(trim(s.substr(0, pos)))) return false;
+        if (pos == std::string_view::npos) return true;
+        s.remove_prefix(pos + 1);
+    }
+}
+
+bool parse_uint(std::string_view s, int& out) {
+    if (s.empty()) return false;
+    auto r = std::from_chars(s.data(), s.data() + s.size(), out);
+    return r.ec == std::errc() && r.ptr == s.data() + s.size() && out >= 0;
+}
+
+// "HH:MM" -> minutes after midnight
+bool parse_hhmm(std::string_view s, int& minute) {
+    int h = 0, m = 0;
+    if (s.size() != 5 || s[2] != ':' || !parse_uint(s.substr(0, 2), h) || !parse_uint(s.substr(3, 2), m))
+        return false;
+    if (h > 23 || m > 59) return false;
+    minute = h * 60 + m;
+    return true;
+}
+
+// "YYYY-MM-DD" -> YYYYMMDD
+bool parse_date(std::string_view s, int& date) {
+    int y = 0, m = 0, d = 0;
+    if (s.size() != 10 || s[4] != '-' || s[7] != '-' || !parse_uint(s.substr(0, 4), y) ||
+        !parse_uint(s.substr(5, 2), m) || !parse_uint(s.substr(8, 2), d))
+        return false;
+    if (m < 1 || m > 12 || d < 1 || d > 31) return false;
+    date = y * 10000 + m * 100 + d;
+    return true;
+}
+
+bool parse_boundaries(std::string_view s, std::vector<int>& out, std::string& err) {
+    std::vector<int> b;
+    const bool ok = split(s, ',', [&](std::string_view item) {
+        int minute = 0;
+        if (!parse_hhmm(item, minute)) {
+            err = "invalid shift boundary '" + std::string(item) + "' (use HH:MM)";
+            return false;
+        }
+        b.push_back(minute);
+        return true;
+    });
+    if (!ok) return false;
+    if (b.size() < 2) {
+        err = "need at least two shift boundaries";
+        return false;
+    }
+    if (!std::is_sorted(b.begin(), b.end()) || std::adjacent_find(b.begin(), b.end()) != b.end()) {
+        err = "shift boundaries must be strictly ascending";
+        return false;
+    }
+    out = std::move(b);
+    return true;
+}
+
+std::string hhmm(int minute) {
+    const char s[] = {char('0' + minute / 600), char('0' + minute / 60 % 10), ':',
+                      char('0' + minute % 60 / 10), char('0' + minute % 10)};
+    return std::string(s, sizeof(s));
+}
+
+std::string join_boundaries(const std::vector<int>& b) {
+    std::string s;
+    for (int m : b) {
+        if (!s.empty()) s += ',';
+        s += hhmm(m);
+    }
+    return s;
+}
+
+} // namespace
+
+bool ShiftSchedule::is_holiday(int yyyymmdd) const {
+    return std::binary_search(holidays.begin(), holidays.end(), yyyymmdd);
+}
+
+ShiftSchedule ShiftConfig::for_line(int line) const {
+    ShiftSchedule s = plant;
+    auto it = line_boundaries.find(line);
+    if (it != line_boundaries.end()) s.boundaries = it->second;
+    return s;
+}
+
+bool parse_shift_config(std::string_view boundaries, std::string_view holidays,
+                        std::string_view line_overrides, ShiftConfig& out, std::string& err) {
+    ShiftConfig cfg;
+
+    if (!trim(boundaries).empty() && !parse_boundaries(trim(boundaries), cfg.plant.boundaries, err))
+        return false;
+
+    if (!trim(holidays).empty()) {
+        const bool ok = split(trim(holidays), ',', [&](std::string_view item) {
+            int date = 0;
+            if (!parse_date(item, date)) {
+                err = "invalid holiday '" + std::string(item) + "' (use YYYY-MM-DD)";
+                return false;
+            }
+            cfg.plant.holidays.push_back(date);
+            return true;
+        });
+        if (!ok) return false;
+        auto& h = cfg.plant.holidays;
+        std::sort(h.begin(), h.end());
+        h.erase(std::unique(h.begin(), h.end()), h.end());
+    }
+
+    if (!trim(line_overrides).empty()) {
+        const bool ok = split(trim(line_overrides), ';', [&](std::string_view item) {
+            const std::size_t eq = item.find('=');
+            int line = 0;
+            if (eq == std::string_view::npos || !parse_uint(trim(item.substr(0, eq)), line)) {
+                err = "invalid line override '" + std::string(item) + "' (use LINE=HH:MM,HH:MM,...)";
+                return false;
+            }
+            std::vector<int> b;
+            if (!parse_boundaries(trim(item.substr(eq + 1)), b, err)) {
+                err = "line " + std::to_string(line) + ": " + err;
+                return false;
+            }
+            cfg.line_boundaries[line] = std::move(b);
+            return true;
+        });
+        if (!ok) return false;
+    }
+
+    out = std::move(cfg);
+    return true;
+}
+
+std::string describe(const ShiftConfig& cfg) {
+    std::string s = "boundaries " + join_boundaries(cfg.plant.boundaries) + ", " +
+                    std::to_string(cfg.plant.holidays.size()) + " holiday(s)";
+    for (const auto& [line, b] : cfg.line_boundaries)
+        s += ", line " + std::to_string(line) + ": " + join_boundaries(b);
+    return s;
+}
+
+void set_shift_config(ShiftConfig cfg) {
+    g_config = std::move(cfg);
+}
+
+const ShiftConfig& shift_config() {
+    return g_config;
+}
+
+void ShiftCalendar::recompute(std::time_t t) {
+    std::tm lt{};
+#if defined(_WIN32)
+    localtime_s(&lt, &t);
+#else
+    localtime_r(&t, &lt);
+#endif
+
+    const auto& b = sched_.boundaries;
+    const int n = static_cast<int>(b.size());
+
+    // Latest working-day boundary at or before t.
+    bool have_start = false;
+    for (int d = 0; d >= -MAX_SCAN_DAYS && !have_start; --d) {
+        int date = 0;
+        local_instant(lt, d, 12 * 60, &date);
+        if (sched_.is_holiday(date)) continue;
+        for (int k = n - 1; k >= 0; --k) {
+            const std::time_t at = local_instant(lt, d, b[k]);
+            if (at <= t) {
+                start_     = at;
+                current_   = k + 1;
+                have_start = true;
+                break;
+            }
+        }
+    }
+
+    // Earliest working-day boundary after t.
+    bool have_next = false;
+    for (int d = 0; d <= MAX_SCAN_DAYS && !have_next; ++d) {
+        int date = 0;
+        local_instant(lt, d, 12 * 60, &date);
+        if (sched_.is_holiday(date)) continue;
+        for (int k = 0; k < n; ++k) {
+            const std::time_t at = local_instant(lt, d, b[k]);
+            if (at > t) {
+                next_     = at;
+                have_next = true;
+                break;
+            }
+        }
+    }
+
+    // Everything in range is a holiday: stay on the last shift and look
+    // again in a second.
+    if (!have_start) {
+        start_   = 0;
+        current_ = n;
+    }
+    if (!have_next) next_ = t + 1;
+}
+
+namespace {
+
+// The calling thread's calendars: the plant one and one per override.
+ShiftCalendar& calendar_for(int line) {
+    struct Calendars {
+        ShiftCalendar plant{shift_config().plant};
+        std::unordered_map<int, ShiftCalendar> lines;
+
+        Calendars() {
+            for (const auto& [l, b] : shift_config().line_boundaries)
+                lines.emplace(l, ShiftCalendar(shift_config().for_line(l)));
+        }
+    };
+    thread_local Calendars cal;
+
+    if (!cal.lines.empty()) {
+        auto it = cal.lines.find(line);
+        if (it != cal.lines.end()) return it->second;
+    }
+    return cal.plant;
+}
+
+} // namespace
+
+int shift_at(std::time_t t, int line) {
+    return calendar_for(line).at(t);
+}
+
+std::time_t shift_start_at(std::time_t t, int line) {
+    ShiftCalendar& cal = calendar_for(line);
+    cal.at(t);
+    return cal.shift_start();
+}
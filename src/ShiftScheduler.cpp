@@ -0,0 +1,93 @@
+#include "ShiftScheduler.hpp"
+#include <algorithm>
+#include <chrono>
+#include <vector>
+#include "Logger.hpp"
+
+ShiftScheduler::ShiftScheduler(ShiftConfig cfg, Handler handler)
+    : cfg_(std::move(cfg))
+    , handler_(std::move(handler))
+{
+}
+
+ShiftScheduler::~ShiftScheduler() {
+    stop();
+}
+
+void ShiftScheduler::start() {
+    {
+        std::lock_guard<std::mutex> lk(mu_);
+        if (running_) return;
+        running_ = true;
+    }
+    thread_ = std::thread(&ShiftScheduler::run, this);
+}
+
+void ShiftScheduler::stop() {
+    {
+        std::lock_guard<std::mutex> lk(mu_);
+        if (!running_) return;
+        running_ = false;
+    }
+    cv_.notify_all();
+    if (thread_.joinable()) thread_.join();
+}
+
+void ShiftScheduler::run() {
+    struct Entry {
+        int line;            // -1 = plant schedule
+        ShiftCalendar cal;
+    };
+    std::vector<Entry> entries;
+    entries.push_back({-1, ShiftCalendar(cfg_.plant)});
+    for (const auto& [line, b] : cfg_.line_boundaries)
+        entries.push_back({line, ShiftCalendar(cfg_.for_line(line))});
+
+    const std::time_t now0 = std::time(nullptr);
+    for (auto& e : entries) e.cal.at(now0);
+
+    LOG_INFO(Shift) << "[SHIFT] Scheduler started: " << describe(cfg_);
+
+    std::unique_lock<std::mutex> lk(mu_);
+    while (running_) {
+        std::time_t next = entries.front().cal.next_boundary();
+        for (const auto& e : entries) next = std::min(next, e.cal.next_boundary());
+
+        cv_.wait_until(lk, std::chrono::system_clock::from_time_t(next), [this] { return !running_; });
+        if (!running_) break;
+
+        const std::time_t now = std::time(nullptr);
+        if (now < next) continue; // woke early (clock set back): re-arm
+
+        lk.unlock();
+        for (auto& e : entries) {
+            // One ShiftChange per boundary, as BoundaryReplayer does: a clock
+            // step or a suspend may have crossed several since the last wake-up.
+            int crossed = 0;
+            while (now >= e.cal.next_boundary()) {
+                ShiftChange ev;
+                ev.line         = e.line;
+                ev.at           = e.cal.next_boundary();
+                ev.closed_shift = e.cal.current();
+                const std::time_t prev_start = e.cal.shift_start();
+                ev.opened_shift = e.cal.at(ev.at);
+                if (e.cal.next_boundary() <= ev.at) break;       // calendar did not advance
+                if (e.cal.shift_start() == prev_start) continue; // no boundary actually crossed
+
+                if (++crossed == 2) {
+                    LOG_WARN(Shift) << "[SHIFT] Several boundaries passed since the last wake-up "
+                                    << "(clock step or suspend): closing each shift in turn";
+                }
+                LOG_INFO(Shift) << "[SHIFT] Boundary"
+                                << (ev.line < 0 ? std::string() : " (line " + std::to_string(ev.line) + ")")
+                                << ": turno " << ev.closed_shift << " -> " << ev.opened_shift;
+                try {
+                    handler_(ev);
+                } catch (const std::exception& ex) {
+                    LOG_ERROR(Shift) << "[SHIFT] Boundary handler error: " << ex.what();
+                }
+            }
+        }
+        lk.lock();
+    }
+}
@@ -0,0 +1,227 @@
+#include "StateStore.hpp"
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <tuple>
+#include "Logger.hpp"
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace pstore {
+
+namespace {
+
+constexpr char MAGIC[8] = {'C', 'E', 'L', 'S', 'T', 'A', 'T', 'E'};
+
+struct alignas(64) Header {
+    char     magic[8];
+    uint32_t version;
+    uint32_t slot_size;
+    uint32_t capacity;
+    uint32_t checksum;   // of the fields above
+    uint32_t used;       // claimed slots
+};
+
+} // namespace
+
+struct alignas(64) Slot {
+    uint32_t seq;        // odd while save() is writing
+    int32_t  kind;       // 0 = free
+    int32_t  line;
+    uint64_t device;     // devEUI, 0 = none
+    uint32_t size;
+    int64_t  shift_start;
+    uint32_t checksum;   // of kind, line, device, size, shift_start and payload[0..size)
+    unsigned char payload[SLOT_PAYLOAD];
+};
+
+namespace {
+
+Header*     g_header = nullptr;
+Slot*       g_slots  = nullptr;
+std::size_t g_bytes  = 0;
+
+// (kind, line, device) -> slot index. Only touched when a shard meets a
+// device for the first time, so a mutex is fine.
+using Key = std::tuple<int32_t, int32_t, uint64_t>;
+std::mutex g_index_mu;
+std::map<Key, uint32_t> g_index;
+
+// FNV-1a
+uint32_t fnv1a(const void* p, std::size_t n, uint32_t h = 2166136261u) {
+    const auto* b = static_cast<const unsigned char*>(p);
+    for (std::size_t i = 0; i < n; ++i) {
+        h ^= b[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+uint32_t header_checksum(const Header& h) {
+    return fnv1a(&h, offsetof(Header, checksum));
+}
+
+uint32_t slot_checksum(const Slot& s) {
+    uint32_t h = fnv1a(&s.kind, sizeof(s.kind));
+    h = fnv1a(&s.line, sizeof(s.line), h);
+    h = fnv1a(&s.device, sizeof(s.device), h);
+    h = fnv1a(&s.size, sizeof(s.size), h);
+    h = fnv1a(&s.shift_start, sizeof(s.shift_start), h);
+    return fnv1a(s.payload, s.size <= SLOT_PAYLOAD ? s.size : 0, h);
+}
+
+bool header_ok(const Header& h, std::size_t capacity) {
+    return std::memcmp(h.magic, MAGIC, sizeof(MAGIC)) == 0 && h.version == FORMAT_VERSION &&
+           h.slot_size == sizeof(Slot) && h.capacity == capacity && h.used <= capacity &&
+           h.checksum == header_checksum(h);
+}
+
+} // namespace
+
+bool open(const std::string& path, std::size_t capacity, std::string& err) {
+#if defined(_WIN32)
+    (void)path; (void)capacity;
+    err = "state file not supported on this platform";
+    return false;
+#else
+    close();
+    if (capacity == 0 || capacity > UINT32_MAX) {
+        err = "invalid slot count";
+        return false;
+    }
+
+    const std::size_t bytes = sizeof(Header) + capacity * sizeof(Slot);
+    const int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        err = "open " + path + ": " + std::strerror(errno);
+        return false;
+    }
+
+    struct stat st{};
+    const bool sized = ::fstat(fd, &st) == 0 && static_cast<std::size_t>(st.st_size) == bytes;
+    if (!sized && ::ftruncate(fd, static_cast<off_t>(bytes)) != 0) {
+        err = "resize " + path + ": " + std::strerror(errno);
+        ::close(fd);
+        return false;
+    }
+
+    void* p = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED) {
+        err = "mmap " + path + ": " + std::strerror(errno);
+        return false;
+    }
+
+    auto* header = static_cast<Header*>(p);
+    auto* slots  = reinterpret_cast<Slot*>(static_cast<char*>(p) + sizeof(Header));
+
+    if (!sized || !header_ok(*header, capacity)) {
+        if (sized) {
+            LOG_WARN(Proc) << "[STATE] " << path << " has another format or size; starting empty";
+        }
+        std::memset(p, 0, bytes);
+        std::memcpy(header->magic, MAGIC, sizeof(MAGIC));
+        header->version   = FORMAT_VERSION;
+        header->slot_size = sizeof(Slot);
+        header->capacity  = static_cast<uint32_t>(capacity);
+        header->checksum  = header_checksum(*header);
+        header->used      = 0;
+        ::msync(p, bytes, MS_SYNC);
+    }
+
+    std::lock_guard<std::mutex> lk(g_index_mu);
+    g_index.clear();
+    for (uint32_t i = 0; i < header->used; ++i) {
+        if (slots[i].kind != 0) g_index.emplace(Key{slots[i].kind, slots[i].line, slots[i].device}, i);
+    }
+
+    g_header = header;
+    g_slots  = slots;
+    g_bytes  = bytes;
+    LOG_INFO(Proc) << "[STATE] " << path << ": " << header->used << "/" << capacity << " slot(s) in use";
+    return true;
+#endif
+}
+
+void close() {
+#if !defined(_WIN32)
+    if (!g_header) return;
+    ::msync(g_header, g_bytes, MS_SYNC);
+    ::munmap(g_header, g_bytes);
+#endif
+    g_header = nullptr;
+    g_slots  = nullptr;
+    g_bytes  = 0;
+    std::lock_guard<std::mutex> lk(g_index_mu);
+    g_index.clear();
+}
+
+bool enabled() {
+    return g_header != nullptr;
+}
+
+Slot* slot(int kind, int line, uint64_t device) {
+    if (!g_header) return nullptr;
+
+    std::lock_guard<std::mutex> lk(g_index_mu);
+    auto it = g_index.find(Key{kind, line, device});
+    if (it != g_index.end()) return &g_slots[it->second];
+
+    if (g_header->used >= g_header->capacity) {
+        static bool warned = false;
+        if (!warned) {
+            warned = true;
+            LOG_WARN(Proc) << "[STATE] State file full (" << g_header->capacity
+                           << " slots); further lines are not persisted";
+        }
+        return nullptr;
+    }
+    const uint32_t i = g_header->used;
+    Slot& s = g_slots[i];
+    s.kind = kind;
+    s.line = line;
+    s.device = device;
+    g_header->used = i + 1;   // claim after the slot is labelled
+    g_index.emplace(Key{kind, line, device}, i);
+    return &s;
+}
+
+bool load(const Slot* s, void* out, std::size_t size, std::time_t shift_start) {
+    if (!s) return false;
+    if ((s->seq & 1) != 0 || s->size != size || size > SLOT_PAYLOAD ||
+        s->shift_start != static_cast<int64_t>(shift_start) || s->checksum != slot_checksum(*s))
+        return false;
+    std::memcpy(out, s->payload, size);
+    return true;
+}
+
+void save(Slot* s, const void* state, std::size_t size, std::time_t shift_start) {
+    if (!s || size > SLOT_PAYLOAD) return;
+    std::atomic_ref<uint32_t> seq(s->seq);
+    const uint32_t v = seq.load(std::memory_order_relaxed);
+    seq.store(v | 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    s->size        = static_cast<uint32_t>(size);
+    s->shift_start = static_cast<int64_t>(shift_start);
+    std::memcpy(s->payload, state, size);
+    s->checksum    = slot_checksum(*s);
+
+    seq.store((v | 1) + 1, std::memory_order_release);
+}
+
+void sync() {
+#if !defined(_WIN32)
+    if (g_header) ::msync(g_header, g_bytes, MS_ASYNC);
+#endif
+}
+
+} // namespace pstore
@@ -0,0 +1,41 @@
+#include "TopicRegistry.hpp"
+#include <functional>
+#include <mutex>
+#include <unordered_set>
+
+namespace topics {
+
+namespace {
+
+// Transparent, so a lookup by string_view does not build a std::string.
+struct Hash {
+    using is_transparent = void;
+    std::size_t operator()(std::string_view s) const { return std::hash<std::string_view>{}(s); }
+};
+
+struct Registry {
+    std::mutex mu;
+    std::unordered_set<std::string, Hash, std::equal_to<>> strings;   // nodes never move: views stay valid
+};
+
+Registry& registry() {
+    static Registry r;
+    return r;
+}
+
+} // namespace
+
+std::string_view intern(std::string_view topic) {
+    Registry& r = registry();
+    std::lock_guard<std::mutex> lk(r.mu);
+    if (auto it = r.strings.find(topic); it != r.strings.end()) return *it;
+    return *r.strings.emplace(topic).first;
+}
+
+std::size_t count() {
+    Registry& r = registry();
+    std::lock_guard<std::mutex> lk(r.mu);
+    return r.strings.size();
+}
+
+} // namespace topics
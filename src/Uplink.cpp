@@ -0,0 +1,428 @@
+#include "Uplink.hpp"
+#include <charconv>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+
+constexpr std::string_view FIELD_NAMES[] = {
+#define CELIMA_UF_NAME(name) #name,
+    CELIMA_UPLINK_FIELDS(CELIMA_UF_NAME)
+#undef CELIMA_UF_NAME
+};
+
+// ---- Compile-time field lookup table (FNV-1a, open addressing) ----
+
+constexpr std::size_t TABLE_SIZE = 128;            // power of two, > 2 * UF_COUNT
+constexpr uint8_t EMPTY = 0xFF;
+
+constexpr uint32_t fnv1a(std::string_view s) {
+    uint32_t h = 2166136261u;
+    for (char c : s) {
+        h ^= static_cast<uint8_t>(c);
+        h *= 16777619u;
+    }
+    return h;
+}
+
+constexpr std::array<uint8_t, TABLE_SIZE> build_table() {
+    std::array<uint8_t, TABLE_SIZE> t{};
+    for (auto& e : t) e = EMPTY;
+    for (std::size_t f = 0; f < UF_COUNT; ++f) {
+        std::size_t slot = fnv1a(FIELD_NAMES[f]) & (TABLE_SIZE - 1);
+        while (t[slot] != EMPTY) slot = (slot + 1) & (TABLE_SIZE - 1);
+        t[slot] = static_cast<uint8_t>(f);
+    }
+    return t;
+}
+
+constexpr auto FIELD_TABLE = build_table();
+
+static_assert(UF_COUNT * 2 < TABLE_SIZE, "grow TABLE_SIZE");
+
+int lookup_field(std::string_view key) {
+    std::size_t slot = fnv1a(key) & (TABLE_SIZE - 1);
+    while (FIELD_TABLE[slot] != EMPTY) {
+        if (FIELD_NAMES[FIELD_TABLE[slot]] == key) return FIELD_TABLE[slot];
+        slot = (slot + 1) & (TABLE_SIZE - 1);
+    }
+    return -1;
+}
+
+const char* kind_name(Uplink::Kind k) {
+    switch (k) {
+        case Uplink::Kind::Missing:  return "missing";
+        case Uplink::Kind::Integer:
+        case Uplink::Kind::Unsigned:
+        case Uplink::Kind::Float:    return "number";
+        case Uplink::Kind::Boolean:  return "boolean";
+        case Uplink::Kind::Null:     return "null";
+        case Uplink::Kind::String:   return "string";
+        case Uplink::Kind::Object:   return "object";
+        case Uplink::Kind::Array:    return "array";
+    }
+    return "unknown";
+}
+
+// ---- Validating scanner ----
+
+constexpr int MAX_DEPTH = 64;
+constexpr std::size_t MAX_KEY = 64;   // longer keys cannot be known fields
+
+class Scanner {
+public:
+    Scanner(std::string_view s, Uplink& out) : p_(s.data()), end_(s.data() + s.size()), out_(out) {}
+
+    bool run(std::string& err) {
+        ws();
+        if (p_ == end_ || *p_ != '{') return fail(err, "top-level value must be an object");
+        if (!object(0, true)) return fail(err, error_);
+        ws();
+        if (p_ != end_) return fail(err, "unexpected trailing characters");
+        return true;
+    }
+
+private:
+    const char* p_;
+    const char* end_;
+    Uplink& out_;
+    const char* error_ = "syntax error";
+    const char* start_ = p_;
+
+    bool fail(std::string& err, const char* what) {
+        err = std::string("uplink parse error at byte ") +
+              std::to_string(p_ - start_) + ": " + what;
+        return false;
+    }
+
+    bool error(const char* what) {
+        error_ = what;
+        return false;
+    }
+
+    void ws() {
+        while (p_ != end_ && (*p_ == ' ' || *p_ == '\t' || *p_ == '\n' || *p_ == '\r')) ++p_;
+    }
+
+    bool literal(const char* lit, std::size_t n) {
+        if (static_cast<std::size_t>(end_ - p_) < n || std::memcmp(p_, lit, n) != 0)
+            return error("invalid literal");
+        p_ += n;
+        return true;
+    }
+
+    static int hex(char c) {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return -1;
+    }
+
+    bool hex4(uint32_t& cp) {
+        if (end_ - p_ < 4) return error("truncated \\u escape");
+        cp = 0;
+        for (int i = 0; i < 4; ++i) {
+            const int h = hex(p_[i]);
+            if (h < 0) return error("invalid \\u escape");
+            cp = (cp << 4) | static_cast<uint32_t>(h);
+        }
+        p_ += 4;
+        return true;
+    }
+
+    // Appends the UTF-8 encoding of cp to key (if there is room).
+    static void put_utf8(char* key, std::size_t& n, uint32_t cp) {
+        char tmp[4];
+        std::size_t k = 0;
+        if (cp < 0x80) {
+            tmp[k++] = static_cast<char>(cp);
+        } else if (cp < 0x800) {
+            tmp[k++] = static_cast<char>(0xC0 | (cp >> 6));
+            tmp[k++] = static_cast<char>(0x80 | (cp & 0x3F));
+        } else if (cp < 0x10000) {
+            tmp[k++] = static_cast<char>(0xE0 | (cp >> 12));
+            tmp[k++] = static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+            tmp[k++] = static_cast<char>(0x80 | (cp & 0x3F));
+        } else {
+            tmp[k++] = static_cast<char>(0xF0 | (cp >> 18));
+            tmp[k++] = static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+            tmp[k++] = static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+            tmp[k++] = static_cast<char>(0x80 | (cp & 0x3F));
+        }
+        for (std::size_t i = 0; i < k; ++i) {
+            if (n < MAX_KEY) key[n] = tmp[i];
+            ++n;
+        }
+    }
+
+    // Validates a string (p_ at the opening quote). If key != nullptr the
+    // unescaped bytes are copied there (up to MAX_KEY) and the full length
+    // is returned through key_len.
+    bool string(char* key, std::size_t* key_len) {
+        ++p_; // opening quote
+        std::size_t n = 0;
+        for (;;) {
+            if (p_ == end_) return error("unterminated string");
+            const auto c = static_cast<unsigned char>(*p_);
+
+            if (c == '"') {
+                ++p_;
+                if (key_len) *key_len = n;
+                return true;
+            }
+            if (c < 0x20) return error("control character in string");
+
+            if (c == '\\') {
+                if (++p_ == end_) return error("unterminated string");
+                const char e = *p_++;
+                uint32_t cp = 0;
+                switch (e) {
+                    case '"':  cp = '"';  break;
+                    case '\\': cp = '\\'; break;
+                    case '/':  cp = '/';  break;
+                    case 'b':  cp = '\b'; break;
+                    case 'f':  cp = '\f'; break;
+                    case 'n':  cp = '\n'; break;
+                    case 'r':  cp = '\r'; break;
+                    case 't':  cp = '\t'; break;
+                    case 'u': {
+                        if (!hex4(cp)) return false;
+                        if (cp >= 0xD800 && cp <= 0xDBFF) {
+                            uint32_t lo = 0;
+                            if (end_ - p_ < 2 || p_[0] != '\\' || p_[1] != 'u')
+                                return error("unpaired surrogate");
+                            p_ += 2;
+                            if (!hex4(lo)) return false;
+                            if (lo < 0xDC00 || lo > 0xDFFF) return error("invalid surrogate pair");
+                            cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+                        } else if (cp >= 0xDC00 && cp <= 0xDFFF) {
+                            return error("unpaired surrogate");
+                        }
+                        break;
+                    }
+                    default:
+                        return error("invalid escape");
+                }
+                if (key) put_utf8(key, n, cp);
+                continue;
+            }
+
+            // UTF-8 sequence validation (RFC 3629)
+            std::size_t len = 1;
+            if (c >= 0x80) {
+                uint32_t lo = 0x80, hi = 0xBF;
+                if (c >= 0xC2 && c <= 0xDF)      len = 2;
+                else if (c == 0xE0)              { len = 3; lo = 0xA0; }
+                else if (c >= 0xE1 && c <= 0xEC) len = 3;
+                else if (c == 0xED)              { len = 3; hi = 0x9F; }
+                else if (c >= 0xEE && c <= 0xEF) len = 3;
+                else if (c == 0xF0)              { len = 4; lo = 0x90; }
+                else if (c >= 0xF1 && c <= 0xF3) len = 4;
+                else if (c == 0xF4)              { len = 4; hi = 0x8F; }
+                else return error("invalid UTF-8");
+
+                if (static_cast<std::size_t>(end_ - p_) < len) return error("invalid UTF-8");
+                for (std::size_t i = 1; i < len; ++i) {
+                    const auto cc = static_cast<unsigned char>(p_[i]);
+                    const uint32_t l = (i == 1) ? lo : 0x80;
+                    const uint32_t h = (i == 1) ? hi : 0xBF;
+                    if (cc < l || cc > h) return error("invalid UTF-8");
+                }
+            }
+            if (key) {
+                for (std::size_t i = 0; i < len; ++i) {
+                    if (n < MAX_KEY) key[n] = p_[i];
+                    ++n;
+                }
+            }
+            p_ += len;
+        }
+    }
+
+    // Number grammar per RFC 8259. Integers that fit int64/uint64 keep their
+    // integer type; anything else becomes a double (as nlohmann does).
+    bool number(Uplink::Value* v) {
+        const char* b = p_;
+        bool is_float = false;
+        if (p_ != end_ && *p_ == '-') ++p_;
+        if (p_ == end_) return error("invalid number");
+        if (*p_ == '0') {
+            ++p_;
+        } else if (*p_ >= '1' && *p_ <= '9') {
+            while (p_ != end_ && *p_ >= '0' && *p_ <= '9') ++p_;
+        } else {
+            return error("invalid number");
+        }
+        if (p_ != end_ && *p_ == '.') {
+            is_float = true;
+            ++p_;
+            if (p_ == end_ || *p_ < '0' || *p_ > '9') return error("invalid number");
+            while (p_ != end_ && *p_ >= '0' && *p_ <= '9') ++p_;
+        }
+        if (p_ != end_ && (*p_ == 'e' || *p_ == 'E')) {
+            is_float = true;
+            ++p_;
+            if (p_ != end_ && (*p_ == '+' || *p_ == '-')) ++p_;
+            if (p_ == end_ || *p_ < '0' || *p_ > '9') return error("invalid number");
+            while (p_ != end_ && *p_ >= '0' && *p_ <= '9') ++p_;
+        }
+        if (!v) return true;
+
+        if (!is_float) {
+            if (*b == '-') {
+                int64_t i = 0;
+                auto r = std::from_chars(b, p_, i);
+                if (r.ec == std::errc() && r.ptr == p_) {
+                    v->kind = Uplink::Kind::Integer;
+                    v->i = i;
+                    return true;
+                }
+            } else {
+                uint64_t u = 0;
+                auto r = std::from_chars(b, p_, u);
+                if (r.ec == std::errc() && r.ptr == p_) {
+                    if (u <= static_cast<uint64_t>(INT64_MAX)) {
+                        v->kind = Uplink::Kind::Integer;
+                        v->i = static_cast<int64_t>(u);
+                    } else {
+                        v->kind = Uplink::Kind::Unsigned;
+                        v->u = u;
+                    }
+                    return true;
+                }
+            }
+        }
+        double d = 0.0;
+        auto r = std::from_chars(b, p_, d);
+        if (r.ptr != p_) return error("invalid number");
+        if (r.ec == std::errc::result_out_of_range) {
+            // from_chars reports both overflow and underflow; only overflow
+            // (non-finite result) is an error, as in nlohmann.
+            char buf[128];
+            const auto n = static_cast<std::size_t>(p_ - b);
+            if (n >= sizeof(buf)) return error("number overflow");
+            std::memcpy(buf, b, n);
+            buf[n] = '\0';
+            d = std::strtod(buf, nullptr);
+            if (!std::isfinite(d)) return error("number overflow");
+        }
+        v->kind = Uplink::Kind::Float;
+        v->d = d;
+        return true;
+    }
+
+    // v == nullptr: validate and skip.
+    bool value(int depth, Uplink::Value* v) {
+        if (p_ == end_) return error("unexpected end of input");
+        switch (*p_) {
+            case '{':
+                if (v) v->kind = Uplink::Kind::Object;
+                return object(depth + 1, false);
+            case '[':
+                if (v) v->kind = Uplink::Kind::Array;
+                return array(depth + 1);
+            case '"': {
+                const char* b = p_ + 1;
+                if (!string(nullptr, nullptr)) return false;
+                if (v) {
+                    v->kind = Uplink::Kind::String;
+                    v->s = {static_cast<uint32_t>(b - start_), static_cast<uint32_t>(p_ - 1 - b)};
+                }
+                return true;
+            }
+            case 't':
+                if (v) { v->kind = Uplink::Kind::Boolean; v->i = 1; }
+                return literal("true", 4);
+            case 'f':
+                if (v) { v->kind = Uplink::Kind::Boolean; v->i = 0; }
+                return literal("false", 5);
+            case 'n':
+                if (v) v->kind = Uplink::Kind::Null;
+                return literal("null", 4);
+            default:
+                return number(v);
+        }
+    }
+
+    bool object(int depth, bool top) {
+        if (depth > MAX_DEPTH) return error("nesting too deep");
+        ++p_; // '{'
+        ws();
+        if (p_ != end_ && *p_ == '}') { ++p_; return true; }
+
+        for (;;) {
+            if (p_ == end_ || *p_ != '"') return error("expected object key");
+            char key[MAX_KEY];
+            std::size_t key_len = 0;
+            if (!string(top ? key : nullptr, top ? &key_len : nullptr)) return false;
+
+            ws();
+            if (p_ == end_ || *p_ != ':') return error("expected ':'");
+            ++p_;
+            ws();
+
+            Uplink::Value* slot = nullptr;
+            if (top && key_len <= MAX_KEY) {
+                const int f = lookup_field(std::string_view(key, key_len));
+                if (f >= 0) {
+                    slot = &out_.fields[static_cast<std::size_t>(f)];
+                    *slot = Uplink::Value();   // duplicate keys: last one wins
+                }
+            }
+            if (!value(depth, slot)) return false;
+
+            ws();
+            if (p_ == end_) return error("unterminated object");
+            if (*p_ == ',') { ++p_; ws(); continue; }
+            if (*p_ == '}') { ++p_; return true; }
+            return error("expected ',' or '}'");
+        }
+    }
+
+    bool array(int depth) {
+        if (depth > MAX_DEPTH) return error("nesting too deep");
+        ++p_; // '['
+        ws();
+        if (p_ != end_ && *p_ == ']') { ++p_; return true; }
+
+        for (;;) {
+            if (!value(depth, nullptr)) return false;
+            ws();
+            if (p_ == end_) return error("unterminated array");
+            if (*p_ == ',') { ++p_; ws(); continue; }
+            if (*p_ == ']') { ++p_; return true; }
+            return error("expected ',' or ']'");
+        }
+    }
+};
+
+} // namespace
+
+const char* upFieldName(UF f) {
+    const auto i = static_cast<std::size_t>(f);
+    return i < UF_COUNT ? FIELD_NAMES[i].data() : "unknown";
+}
+
+UplinkRoute route_uplink(std::string_view payload) {
+    Uplink up;
+    std::string err;
+    UplinkRoute r;
+    if (!decode_uplink(payload, up, err)) return r;
+    r.deviceType = up.get_opt(UF::deviceType).value_or(0);
+    r.lineID     = up.get_opt(UF::lineID).value_or(0);
+    return r;
+}
+
+void Uplink::throw_type_error(UF f) const {
+    throw std::invalid_argument(std::string("[uplink] ") + upFieldName(f) +
+                                ": type must be number, but is " + kind_name(at(f).kind));
+}
+
+bool decode_uplink(std::string_view payload, Uplink& out, std::string& err) {
+    out = Uplink();
+    out.raw = payload;
+    Scanner sc(payload, out);
+    return sc.run(err);
+}
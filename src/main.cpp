@@ -1,7 +1,16 @@
 #include "MqttApp.hpp"
+#include "Logger.hpp"
+#include "Replay.hpp"
+#include "StateStore.hpp"
+#include <algorithm>
+#include <charconv>
 #include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
 #include <string>
+#include <thread>
 #include <csignal>
 
 static volatile std::sig_atomic_t g_stop = 0;
@@ -12,21 +21,166 @@ static std::string env_or(const char* key, const char* defv) {
     return v ? std::string(v) : std::string(defv);
 }
 
+// Non-negative integer in [0, max]; a larger one is capped at max, anything
+// else (sign, spaces, junk, out of range) is ignored in favour of defv.
+static unsigned long env_ulong_or(const char* key, unsigned long defv, unsigned long max) {
+    const char* v = std::getenv(key);
+    if (!v || !*v) return defv;
+    const char* end = v + std::strlen(v);
+    unsigned long n = 0;
+    const auto [ptr, ec] = std::from_chars(v, end, n);
+    if (*v < '0' || *v > '9' || ptr != end || (ec != std::errc() && ec != std::errc::result_out_of_range)) {
+        LOG_WARN(MQTT) << "Ignoring invalid " << key << "=" << v;
+        return defv;
+    }
+    if (ec == std::errc::result_out_of_range || n > max) {
+        LOG_WARN(MQTT) << key << "=" << v << " is too large; using " << max;
+        return max;
+    }
+    return n;
+}
+
+// --replay <dir> [out]: run a journal through the processors offline and
+// write every publication as "<topic> <payload>" lines to `out` ("-" = stdout).
+static int run_replay(const std::string& dir, const std::string& out_path, const std::string& isa95) {
+    std::ofstream file;
+    std::ostream* out = nullptr;
+    if (out_path == "-") {
+        out = &std::cout;
+    } else if (!out_path.empty()) {
+        file.open(out_path, std::ios::binary | std::ios::trunc);
+        if (!file) {
+            LOG_ERROR(Data) << "[REPLAY] Cannot write " << out_path;
+            return 1;
+        }
+        out = &file;
+    }
+
+    ReplayStats stats;
+    std::string err;
+    const bool ok = replay_journal(dir, isa95, [&](const Publication& p) {
+        if (out) *out << p.topic << ' ' << p.payload << '\n';
+    }, stats, err);
+    if (out) out->flush();
+    if (!ok) {
+        LOG_ERROR(Data) << "[REPLAY] " << err;
+        return 1;
+    }
+    LOG_INFO(Data) << "[REPLAY] " << stats.messages << " message(s) (" << stats.invalid << " invalid), "
+                   << stats.shift_closes << " shift boundar(ies), " << stats.publications
+                   << " publication(s) in " << stats.seconds << " s ("
+                   << (stats.seconds > 0 ? static_cast<uint64_t>(stats.messages / stats.seconds) : 0)
+                   << " msg/s)";
+    return 0;
+}
+
 int main(int argc, char** argv) {
     std::signal(SIGINT, handle_sigint);
     std::signal(SIGTERM, handle_sigint);
 
+    // LOG_LEVEL / LOG_RATE_LIMIT; starts the background log writer.
+    logx::init_from_env();
+
     //Default values when no arguments 
     std::string broker = env_or("MQTT_BROKER", "tcp://localhost:1883");
     std::string client = env_or("MQTT_CLIENT_ID", "celima-integration");
     std::string isa95  = env_or("ISA95_PREFIX", "celima/punta_hermosa/planta/linea/");
 
-    if (argc > 1) broker = argv[1];
-    if (argc > 2) client = argv[2];
-    if (argc > 3) isa95  = argv[3];
+    std::string replay_dir, replay_out;
+    if (argc > 2 && std::strcmp(argv[1], "--replay") == 0) {
+        replay_dir = argv[2];
+        if (argc > 3) replay_out = argv[3];
+    } else {
+        if (argc > 1) broker = argv[1];
+        if (argc > 2) client = argv[2];
+        if (argc > 3) isa95  = argv[3];
+    }
+
+    IngestOptions ingest;
+    ingest.capacity = env_ulong_or("INGEST_QUEUE_CAPACITY", ingest.capacity, 1u << 20);
+    // More shards than a few per core only add queues and threads.
+    const unsigned long max_workers = std::max(1u, std::thread::hardware_concurrency()) * 4ul;
+    ingest.workers  = static_cast<unsigned>(env_ulong_or("INGEST_WORKERS", ingest.workers, max_workers));
+    std::string overflow = env_or("INGEST_OVERFLOW", overflowPolicyName(ingest.overflow));
+    if (auto p = overflowPolicyFromString(overflow)) {
+        ingest.overflow = *p;
+    } else {
+        LOG_WARN(Ingest) << "Ignoring invalid INGEST_OVERFLOW=" << overflow
+                         << " (use block | drop-oldest | drop-newest)";
+    }
+
+    // Shift calendar; must be set before the app starts its workers.
+    ShiftConfig shifts;
+    std::string shift_err;
+    if (parse_shift_config(env_or("SHIFT_BOUNDARIES", ""), env_or("SHIFT_HOLIDAYS", ""),
+                           env_or("SHIFT_LINE_OVERRIDES", ""), shifts, shift_err)) {
+        set_shift_config(std::move(shifts));
+    } else {
+        LOG_WARN(Shift) << "Ignoring invalid shift config: " << shift_err
+                        << " (using default 06:00,14:00,22:00)";
+    }
+    LOG_INFO(Shift) << "[SHIFT] Calendar: " << describe(shift_config());
+
+    // Persistent line state; empty STATE_FILE keeps it in memory only.
+    const std::string state_file = env_or("STATE_FILE", "");
+    if (!replay_dir.empty() && !state_file.empty()) {
+        // Replay rebuilds the state from the journal alone: totals already in
+        // the file (e.g. the live one) would be restored and counted again.
+        std::error_code ec;
+        const auto size = std::filesystem::file_size(state_file, ec);
+        if (!ec && size > 0) {
+            LOG_ERROR(Data) << "[REPLAY] STATE_FILE " << state_file << " already exists; replay rebuilds "
+                            << "state from the journal alone, so point STATE_FILE at a new file or unset it";
+            logx::shutdown();
+            return 1;
+        }
+    }
+    if (!state_file.empty()) {
+        std::string state_err;
+        if (!pstore::open(state_file, env_ulong_or("STATE_SLOTS", 1024, 1u << 20), state_err)) {
+            LOG_WARN(Proc) << "State persistence disabled: " << state_err;
+        }
+    }
+
+    if (!replay_dir.empty()) {
+        const int rc = run_replay(replay_dir, replay_out, isa95);
+        pstore::close();
+        logx::shutdown();
+        return rc;
+    }
+
+    JournalOptions journal;
+    journal.dir           = env_or("JOURNAL_DIR", "");
+    journal.segment_bytes = env_ulong_or("JOURNAL_SEGMENT_MB", journal.segment_bytes >> 20, 4096) << 20;
+    journal.flush_ms      = static_cast<unsigned>(env_ulong_or("JOURNAL_FLUSH_MS", journal.flush_ms, 60000));
+    journal.max_bytes     = env_ulong_or("JOURNAL_MAX_MB", journal.max_bytes >> 20, 1ul << 24) << 20;
+    journal.max_age_h     = static_cast<unsigned>(env_ulong_or("JOURNAL_MAX_AGE_H", journal.max_age_h, 24 * 366 * 10));
+
+    CoalesceOptions coalesce;
+    coalesce.flush_ms        = static_cast<unsigned>(env_ulong_or("PUBLISH_COALESCE_MS", coalesce.flush_ms, 60000));
+    coalesce.max_dirty       = env_ulong_or("PUBLISH_COALESCE_MAX_DIRTY", coalesce.max_dirty, 1u << 20);
+    coalesce.alarm_max_stale = std::chrono::seconds(
+        env_ulong_or("PUBLISH_ALARM_MAX_STALE_S", coalesce.alarm_max_stale.count(), 7 * 86400));
+
+    PublishOptions publish;
+    publish.max_inflight = static_cast<unsigned>(env_ulong_or("PUBLISH_MAX_INFLIGHT", publish.max_inflight, 65535));
+    publish.max_buffered = static_cast<unsigned>(env_ulong_or("PUBLISH_MAX_BUFFERED", publish.max_buffered, 10000000));
+    publish.block_ms     = static_cast<unsigned>(env_ulong_or("PUBLISH_BLOCK_MS", publish.block_ms, 600000));
+    if (publish.max_inflight == 0) {
+        LOG_WARN(Pub) << "Ignoring PUBLISH_MAX_INFLIGHT=0 (using 1)";
+        publish.max_inflight = 1;
+    }
+
+    SpoolOptions spool;
+    spool.dir        = env_or("SPOOL_DIR", "");
+    spool.max_bytes  = env_ulong_or("SPOOL_MAX_MB", spool.max_bytes >> 20, 1ul << 24) << 20;
+    spool.drain_rate = static_cast<unsigned>(env_ulong_or("SPOOL_DRAIN_RATE", spool.drain_rate, 100000));
+
+    metrics::ReporterOptions metrics;
+    metrics.interval_s = static_cast<unsigned>(env_ulong_or("METRICS_INTERVAL_S", metrics.interval_s, 86400));
 
     try {
-        MqttApp app(broker, client, isa95);
+        MqttApp app(broker, client, isa95, ingest, journal, coalesce, publish, spool, metrics);
         app.start();
 
         while (!g_stop) {
@@ -34,8 +188,12 @@ int main(int argc, char** argv) {
         }
         app.stop();
     } catch (const std::exception& e) {
-        std::cerr << "Fatal error: " << e.what() << "\n";
+        LOG_ERROR(MQTT) << "Fatal error: " << e.what();
+        pstore::close();
+        logx::shutdown();
         return 1;
     }
+    pstore::close();
+    logx::shutdown();
     return 0;
 }
@@ -0,0 +1,213 @@
+// Golden test: every processor's publications, byte for byte.
+//
+// Replays bench/corpus/celima_data.jsonl (all eight device types) and then
+// tests/golden/edge_cases.jsonl (unknown types, bit 15, rollovers, jumps,
+// several devices on a line, invalid payloads) through decode_uplink ->
+// ProcessorTable -> process(), one uplink every 30 s from a fixed instant
+// in UTC, so timestamps and shifts are the same on every run. The plant's
+// shift boundaries fire between messages as ShiftScheduler would fire them
+// (close_shift -> ShiftSummaryCollector). Each publication, shift
+// summaries included, is written as "<topic> <payload>"; the data-quality
+// report (its ts blanked) and the bit 15 / rejected-delta counters follow.
+// All of it is compared with tests/golden/processors.txt. Every payload
+// must also be exactly what nlohmann::json::dump() makes of it, which is
+// what the processors published before they serialized through jsonw
+// schemas.
+//
+// The replay then runs again with every ShiftChange delivered LATE
+// messages after its boundary, as happens live when uplinks received after
+// the boundary are handled before the scheduler's control item: the shift
+// summaries and all other publications must come out the same.
+//
+//   golden_processors            compare (exit 1 and show the first diffs)
+//   golden_processors --update   rewrite the expected file
+//
+// Run from the repository root (make test does).
+#include "DataQuality.hpp"
+#include "Logger.hpp"
+#include "MessageProcessor.hpp"
+#include "Metrics.hpp"
+#include "Shift.hpp"
+#include "Uplink.hpp"
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+static const char* const INPUTS[] = {"bench/corpus/celima_data.jsonl", "tests/golden/edge_cases.jsonl"};
+static const char* const EXPECTED = "tests/golden/processors.txt";
+static const char* const ACTUAL   = "bin/tests/processors.actual";
+static const char* const PREFIX   = "celima/punta_hermosa/planta/linea/";
+
+static constexpr std::time_t START = 1767585600;   // 2026-01-05T04:00:00Z, crosses the 06:00 boundary
+static constexpr int STEP_S = 30;
+static constexpr int LATE = 16;   // half the corpus' devices roll over before the ShiftChange
+
+static int g_not_dump = 0;   // payloads that differ from their dump()
+
+static void check_dump(const Publication& p) {
+    const auto j = nlohmann::json::parse(p.payload, nullptr, false);
+    if (!j.is_discarded() && j.dump() == p.payload) return;
+    if (++g_not_dump <= 5)
+        std::fprintf(stderr, "not dump(): %.*s %.*s\n", static_cast<int>(p.topic.size()), p.topic.data(),
+                     static_cast<int>(p.payload.size()), p.payload.data());
+}
+
+// Publications of one replay, ShiftChanges run `late` messages after their boundary.
+static std::string run(int late) {
+    std::ostringstream out;
+    ProcessorTable processors;
+    ShiftSummaryCollector summaries(1);
+    ShiftCalendar plant(shift_config().plant);
+    PublicationSink pubs;
+    std::time_t t = START;
+    plant.at(t);
+
+    auto emit = [&] {
+        for (const Publication& p : pubs) {
+            check_dump(p);
+            out << p.topic << ' ' << p.payload << '\n';
+        }
+    };
+    std::vector<std::pair<ShiftChange, int>> due;   // boundary, messages still to handle before it
+    auto close_due = [&] {
+        while (!due.empty() && due.front().second <= 0) {
+            pubs.clear();
+            summaries.add(due.front().first, close_shift(due.front().first), PREFIX, pubs);
+            emit();
+            due.erase(due.begin());
+        }
+    };
+
+    for (const char* path : INPUTS) {
+        std::ifstream in(path);
+        if (!in) {
+            std::fprintf(stderr, "cannot open %s\n", path);
+            std::exit(2);
+        }
+        for (std::string payload; std::getline(in, payload); t += STEP_S) {
+            if (payload.empty()) continue;
+            while (t >= plant.next_boundary()) {
+                ShiftChange ev;
+                ev.at           = plant.next_boundary();
+                ev.closed_shift = plant.current();
+                ev.opened_shift = plant.at(ev.at);
+                due.emplace_back(ev, late);
+            }
+            close_due();
+            for (auto& d : due) --d.second;
+            std::string err;
+            Uplink up;
+            if (!decode_uplink(payload, up, err)) {
+                out << "! invalid: " << err << '\n';
+                continue;
+            }
+            const MessageContext ctx =
+                make_message_context(std::chrono::system_clock::from_time_t(t), up.value(UF::lineID, 0));
+            pubs.clear();
+            processors.get(up.value(UF::deviceType, 0)).process(up, ctx, PREFIX, pubs);
+            emit();
+        }
+    }
+    for (auto& d : due) d.second = 0;
+    close_due();
+    return out.str();
+}
+
+// Data-quality report (ts blanked) and counters, after run().
+static std::string report() {
+    std::ostringstream out;
+    std::string report = dq::render();
+    const std::size_t ts = report.find("\"ts\":\"");
+    if (ts != std::string::npos) report.replace(ts + 6, report.find('"', ts + 6) - (ts + 6), "");
+    out << PREFIX << "_meta/data_quality " << report << '\n';
+    out << "# bit15_corruption=" << metrics::registry().bit15_corruption.value()
+        << " safe_delta_rejected=" << metrics::registry().safe_delta_rejected.value() << '\n';
+    return out.str();
+}
+
+static std::vector<std::string> split_lines(const std::string& s) {
+    std::vector<std::string> v;
+    std::istringstream in(s);
+    for (std::string l; std::getline(in, l);) v.push_back(l);
+    return v;
+}
+
+// Shift summaries and the other publications, each in order.
+static std::pair<std::vector<std::string>, std::vector<std::string>> split_summaries(const std::string& s) {
+    std::pair<std::vector<std::string>, std::vector<std::string>> r;
+    for (std::string& l : split_lines(s))
+        (l.find("/shift_summary ") != std::string::npos ? r.first : r.second).push_back(std::move(l));
+    return r;
+}
+
+int main(int argc, char** argv) {
+    // Shifts follow local time: pin it.
+    setenv("TZ", "UTC", 1);
+    tzset();
+    logx::set_level(logx::Level::Warn);
+
+    const std::string published = run(0);
+    const std::string actual = published + report();
+
+    // Line state is thread_local: a fresh thread replays from empty state.
+    std::string delayed;
+    std::thread([&] { delayed = run(LATE); }).join();
+    const auto [sum0, pubs0] = split_summaries(published);
+    const auto [sum1, pubs1] = split_summaries(delayed);
+    if (sum0 != sum1 || pubs0 != pubs1) {
+        std::fprintf(stderr, "golden_processors: ShiftChanges %d messages late change the output (%zu vs %zu "
+                     "summaries)\n", LATE, sum1.size(), sum0.size());
+        for (std::size_t i = 0; i < std::min(sum0.size(), sum1.size()); ++i) {
+            if (sum0[i] == sum1[i]) continue;
+            std::fprintf(stderr, "  on time: %s\n  late:    %s\n", sum0[i].c_str(), sum1[i].c_str());
+            break;
+        }
+        return 1;
+    }
+    if (g_not_dump) {
+        std::fprintf(stderr, "golden_processors: %d payload(s) differ from nlohmann::json::dump()\n", g_not_dump);
+        return 1;
+    }
+
+    if (argc > 1 && std::strcmp(argv[1], "--update") == 0) {
+        std::ofstream(EXPECTED, std::ios::binary | std::ios::trunc) << actual;
+        std::printf("wrote %s\n", EXPECTED);
+        return 0;
+    }
+
+    std::ifstream in(EXPECTED, std::ios::binary);
+    if (!in) {
+        std::fprintf(stderr, "cannot open %s (run with --update to create it)\n", EXPECTED);
+        return 2;
+    }
+    const std::string expected((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    if (actual == expected) {
+        std::printf("golden_processors: %zu publication line(s) match\n", split_lines(actual).size());
+        return 0;
+    }
+
+    std::ofstream(ACTUAL, std::ios::binary | std::ios::trunc) << actual;
+    const auto a = split_lines(actual), e = split_lines(expected);
+    int shown = 0;
+    for (std::size_t i = 0; i < std::max(a.size(), e.size()) && shown < 5; ++i) {
+        const std::string* x = i < e.size() ? &e[i] : nullptr;
+        const std::string* y = i < a.size() ? &a[i] : nullptr;
+        if (x && y && *x == *y) continue;
+        std::fprintf(stderr, "line %zu\n  expected: %s\n  actual:   %s\n", i + 1, x ? x->c_str() : "(none)",
+                     y ? y->c_str() : "(none)");
+        ++shown;
+    }
+    std::fprintf(stderr, "golden_processors: output differs from %s (full output in %s)\n", EXPECTED, ACTUAL);
+    return 1;
+}
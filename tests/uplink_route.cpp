@@ -0,0 +1,68 @@
+// Shard routing must agree with what the processors decode.
+//
+// MqttApp routes each celima/data payload to a worker shard by
+// route_uplink(); the processors key line state by decode_uplink()'s
+// deviceType and lineID. Nested members, duplicate keys, escaped key names
+// and non-integer values must give both the same (type, line), or one line's
+// state splits across two shards.
+#include "Uplink.hpp"
+#include <cstdio>
+#include <iterator>
+#include <string>
+
+struct Case {
+    const char* payload;
+    int deviceType;
+    int lineID;
+};
+
+static const Case CASES[] = {
+    // plain
+    {R"({"deviceType":1,"lineID":3})", 1, 3},
+    // a nested lineID / deviceType is not the uplink's
+    {R"({"meta":{"lineID":9,"deviceType":7},"deviceType":1,"lineID":3})", 1, 3},
+    {R"({"deviceType":1,"rx":[{"lineID":9}],"lineID":3})", 1, 3},
+    {R"({"deviceType":1,"meta":{"lineID":9}})", 1, 0},
+    // the key inside a string value
+    {R"({"note":"\"lineID\":9","deviceType":2,"lineID":4})", 2, 4},
+    // duplicate keys: the last one wins
+    {R"({"lineID":3,"deviceType":1,"lineID":5})", 1, 5},
+    {R"({"deviceType":4,"deviceType":6,"lineID":2})", 6, 2},
+    // escaped key names decode to the field
+    {R"({"deviceType":1,"line\u0049D":8})", 1, 8},
+    // value conversions of Uplink::get_opt()
+    {R"({"deviceType":true,"lineID":3.0})", 1, 3},
+    {R"({"deviceType":false,"lineID":3.9})", 0, 3},
+    {R"({"deviceType":1,"lineID":-2})", 1, -2},
+    {R"({"deviceType":1,"lineID":3e0})", 1, 3},
+    // not numbers, or an invalid payload: 0
+    {R"({"deviceType":"1","lineID":null})", 0, 0},
+    {R"({"deviceType":1,"lineID":3)", 0, 0},
+};
+
+int main() {
+    int failed = 0;
+    for (const Case& c : CASES) {
+        const UplinkRoute r = route_uplink(c.payload);
+
+        Uplink up;
+        std::string err;
+        int type = 0, line = 0;
+        if (decode_uplink(c.payload, up, err)) {
+            type = up.get_opt(UF::deviceType).value_or(0);
+            line = up.get_opt(UF::lineID).value_or(0);
+        }
+
+        if (r.deviceType != c.deviceType || r.lineID != c.lineID || r.deviceType != type || r.lineID != line) {
+            std::fprintf(stderr, "%s\n  expected (%d, %d), routed (%d, %d), decoded (%d, %d)\n", c.payload,
+                         c.deviceType, c.lineID, r.deviceType, r.lineID, type, line);
+            ++failed;
+        }
+    }
+    if (failed) {
+        std::fprintf(stderr, "uplink_route: %d of %zu case(s) failed\n", failed, std::size(CASES));
+        return 1;
+    }
+    std::printf("uplink_route: %zu case(s) route as decoded\n", std::size(CASES));
+    return 0;
+}